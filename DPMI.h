@@ -27,7 +27,7 @@
 
 #include <stdint.h>
 
-#pragma pack(push,1);
+#pragma pack(push,1)
 /* SuperVGA information block */
 typedef struct
 {
@@ -91,7 +91,7 @@ typedef struct {
     short   flags;
     short   es,ds,fs,gs,ip,cs,sp,ss;
 } RMREGS;
-#pragma pack(pop);
+#pragma pack(pop)
 
 extern VbeInfoBlock *DPMI_VbeInfo;
 extern RMREGS rmregs;
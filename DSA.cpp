@@ -30,6 +30,7 @@
 #include "SYSTEM.h"
 #include "ERROR.h"
 #include "DSA.h"
+#include "DSAHOST.h"
 #include <string.h>
 #include <conio.h>
 #include "LBM.h"
@@ -123,6 +124,17 @@ VBEModeConfig VBEModeConfigData[11] =
     {0,    0,    0, 0,     0, 0},
 };
 
+/* Registers of the unchained modes, the index in the low byte and the value in the high byte. Mode 13h is unchained
+   by turning off chain 4 and the doubleword and word addressing of the CRTC; 360x240 also needs the 28 MHz dot
+   clock and its own timing. */
+static const unsigned short DSA_ModeXSequencer[] = { 0x0604 };
+static const unsigned short DSA_ModeXCRTC[] = { 0x0014, 0xE317 };
+static const unsigned short DSA_ModeX360x240CRTC[] =
+{
+    0x6B00, 0x5901, 0x5A02, 0x8E03, 0x5E04, 0x8A05, 0x0D06, 0x3E07, 0x4109,
+    0xEA10, 0xAC11, 0xDF12, 0x2D13, 0x0014, 0xE715, 0x0616, 0xE317
+};
+
 DSA_GlobalParamStruct DSA_globalParams;
 DSA_GlobalParamStruct* DSA_ptrGlobalParams;
 
@@ -146,6 +158,9 @@ VBEModeInfoBlock* DSA_VgaInfoBlock;
 DPMI_CALLREGS DSA_DpmiCallRegs;
 unsigned short DSA_WinAttrib_Status;
 unsigned short DSA_currentBank;
+/* The VESA window presents write through: window A or B, and the steps it moves in */
+unsigned short DSA_WindowNumber;
+unsigned int DSA_WindowGranularity;
 unsigned int DSA_MaxSupportedScreenSize;
 
 unsigned int DSA_MouseUpdateFlag;
@@ -155,6 +170,12 @@ OPM_Struct bmouseoldback;
 OPM_Struct mouseback[4];
 OPM_Struct mouseoldback[4];
 
+/* The current mouse cursor compiled into runs, the cursor it was made from and a copy of that cursor's size,
+   transparent color and body data, since a cursor can be changed in place. */
+static OPM_GfxStruct DSA_MouseCursorGfx;
+static SYSTEM_MouseCursorStruct *DSA_MouseCursorGfxSource;
+static SYSTEM_MouseCursorStruct DSA_MouseCursorGfxCopy;
+
 unsigned int DSA_ErrorFlags;
 
 char *DSA_ScreenBuffer[4];
@@ -165,8 +186,22 @@ int max_4_word_77E00;
 int bank;
 int winSizeInBytes;
 
+/* For every bank, what changed in the frames that were presented to other banks since it was last presented to. These
+   are plain OPMs created with OPM_New on the buffer of the main OPM; they are never drawn into, only their dirty
+   rectangle lists are used. */
+static OPM_Struct DSA_BankDirtyRects[4];
+
 void DSA_CloseScreen(void);
 static void DSA_PrintData(char *buffer, DSA_ErrorStruct *data);
+static int DSA_UpdateMouseCursorGfx(void);
+static int DSA_GetNumberOfBanks(void);
+static void DSA_UpdateBankDirtyRects(OPM_Struct *pixel_map, int full);
+static void DSA_ShowBank(int bank_index);
+static void DSA_SelectWindow(void);
+static void DSA_SetWindow(unsigned short position);
+static void DSA_SetModeX(int width);
+static void DSA_WriteRegisters(int port, const unsigned short *registers, int count);
+static void DSA_SetPlaneMask(int mask);
 
 int DSA_Init(void)
 {
@@ -216,12 +251,11 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
     unsigned char bank_index;
     void far *ptr_dpmi_callregs;
     unsigned int DSA_windowsSegmentAddress;
-    unsigned int irgendwas_mit_bank_dword_77988;
 
     DSA_globalParams.method_flags = method;
     DSA_VideoMode = 0;
 
-    for (index = 0; VBEModeConfigData[index].width != 0; index++)
+    for (index = 0; !(DSA_globalParams.method_flags & DSA_METHOD_HOST) && VBEModeConfigData[index].width != 0; index++)
     {
         if (VBEModeConfigData[index].width != pixel_map->width || VBEModeConfigData[index].height != pixel_map->height || VBEModeConfigData[index].bytes_per_pixel != pixel_map->bytes_per_pixel)
         {
@@ -245,7 +279,7 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
           continue;
         }
 
-        if (!(DSA_globalParams.method_flags & 0x10000))
+        if (!(DSA_globalParams.method_flags & DSA_METHOD_PAGE_FLIP))
         {
             DSA_VideoMode = VBEModeConfigData[index].vesa_mode_number;
             DSA_InternalMode = VBEModeConfigData[index].mode_number_internal;
@@ -259,6 +293,12 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
             break;
         }
     }
+    if (DSA_globalParams.method_flags & DSA_METHOD_HOST)
+    {
+        /* Any size will do; there is no BIOS mode, the number only tells that a mode was found */
+        DSA_VideoMode = 1;
+        DSA_InternalMode = 3;
+    }
 
     if(DSA_VideoMode != 0)
     {
@@ -289,6 +329,10 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
         DSA_Screen_Stride = pixel_map->stride;
         DSA_Screen_Height = pixel_map->height;
 
+        /* the new video mode starts with an empty screen, so the first present has to upload all of it */
+        OPM_ClearDirtyRects(pixel_map);
+        OPM_AddDirtyRect(pixel_map, 0, 0, pixel_map->width, pixel_map->height);
+
         if(DSA_InternalMode == 1)
         {
             /* Get current video mode */
@@ -318,19 +362,25 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
             /* Set video mode */
             inregs.w.ax = DSA_VideoMode;
             int386(0x10, &inregs, &inregs);
+            DSA_SetModeX(pixel_map->width);
 
+            /* Each plane holds every fourth pixel, so a page takes a quarter of the screen size in every plane */
             winSizeInBytes = DSA_Screen_Size / 4;
-            /* FIXME: Missing function; not implemented yet */
-            if(DSA_globalParams.method_flags & 0x10000)
+            DSA_Screen_Stride = pixel_map->width / 4;
+            if(DSA_globalParams.method_flags & DSA_METHOD_PAGE_FLIP)
             {
                 for(bank_index = 0; bank_index < 4; bank_index++)
                 {
-                    DSA_ScreenBuffer[bank_index] = (char*)(0xA0000L + winSizeInBytes + bank_index);
+                    DSA_ScreenBuffer[bank_index] = (char*)(0xA0000L + winSizeInBytes * bank_index);
                     DSA_ScanlineStart[bank_index] = 0;
                 }
-                max_4_word_77E00 = 2;
-                bank = 1;
-                /* FIXME: Missing function; not implemented yet */
+                /* As many pages as fit into the 64 KB of each plane */
+                max_4_word_77E00 = DSA_GetNumberOfBanks();
+                while (max_4_word_77E00 > 1 && max_4_word_77E00 * winSizeInBytes > 0x10000)
+                {
+                    max_4_word_77E00--;
+                }
+                bank = max_4_word_77E00 > 1 ? 1 : 0;
             }
             else
             {
@@ -339,11 +389,73 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
                 {
                     DSA_ScreenBuffer[bank_index] = (char*)0xA0000L;
                     DSA_ScanlineStart[bank_index] = 0;
-                    max_4_word_77E00 = 1;
-                    bank = 0;
-                    /* FIXME: Missing function; not implemented yet */
+                }
+                max_4_word_77E00 = 1;
+                bank = 0;
+            }
+            retVal = 1;
+        }
+        else if (DSA_InternalMode == 3)
+        {
+            max_4_word_77E00 = DSA_GetNumberOfBanks();
+            if (!DSAHOST_Open(pixel_map->width, pixel_map->height, max_4_word_77E00))
+            {
+                DSA_globalParams.flags = 0;
+                DSA_globalParams.method_flags = 0;
+                return 0;
+            }
+            if (DSA_globalParams.method_flags & DSA_METHOD_PLANAR)
+            {
+                /* Like the unchained VGA modes: four planes of 64 KB, a page takes a quarter of the screen size in each */
+                DSA_Screen_Stride = pixel_map->width / 4;
+                winSizeInBytes = DSA_Screen_Size / 4;
+                if ((pixel_map->width & 3) || pixel_map->bytes_per_pixel != 1 || winSizeInBytes > 0x10000 || !DSAHOST_OpenPlanes())
+                {
+                    DSAHOST_Close();
+                    DSA_globalParams.flags = 0;
+                    DSA_globalParams.method_flags = 0;
+                    return 0;
+                }
+                while (max_4_word_77E00 > 1 && max_4_word_77E00 * winSizeInBytes > 0x10000)
+                {
+                    max_4_word_77E00--;
+                }
+                for(bank_index = 0; bank_index < 4; bank_index++)
+                {
+                    DSA_ScreenBuffer[bank_index] = (char*)DSAHOST_Window + winSizeInBytes * (bank_index < max_4_word_77E00 ? bank_index : 0);
+                    DSA_ScanlineStart[bank_index] = 0;
+                }
+            }
+            else if (DSA_globalParams.method_flags & DSA_METHOD_BANKED)
+            {
+                /* Like a VESA card: rows padded to a multiple of 256 bytes and a 64 KB window that moves in 4 KB steps */
+                DSA_Screen_Stride = (pixel_map->stride + 255) & ~255;
+                winSizeInBytes = 0x10000;
+                DSA_WindowGranularity = 0x1000;
+                DSA_currentBank = -1;
+                if (!DSAHOST_OpenWindow(max_4_word_77E00 * pixel_map->height * DSA_Screen_Stride, DSA_WindowGranularity, winSizeInBytes))
+                {
+                    DSAHOST_Close();
+                    DSA_globalParams.flags = 0;
+                    DSA_globalParams.method_flags = 0;
+                    return 0;
+                }
+                for(bank_index = 0; bank_index < 4; bank_index++)
+                {
+                    DSA_ScreenBuffer[bank_index] = (char*)DSAHOST_Window;
+                    DSA_ScanlineStart[bank_index] = pixel_map->height * bank_index;
+                }
+            }
+            else
+            {
+                /* Set screen buffer address for all four banks; flipping points the host framebuffer at another one */
+                for(bank_index = 0; bank_index < 4; bank_index++)
+                {
+                    DSA_ScreenBuffer[bank_index] = (char*)DSAHOST_Banks[bank_index < max_4_word_77E00 ? bank_index : 0];
+                    DSA_ScanlineStart[bank_index] = 0;
                 }
             }
+            bank = max_4_word_77E00 > 1 ? 1 : 0;
             retVal = 1;
         }
         else
@@ -357,8 +469,8 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
             ptr_dpmi_callregs = (void far *)&DSA_DpmiCallRegs;
             BASEMEM_FillMemByte(&DSA_DpmiCallRegs, sizeof(DSA_DpmiCallRegs), 0);
             DSA_DpmiCallRegs.eax = 0x4F00;
-            DSA_DpmiCallRegs.es = (unsigned int)DSA_VbeHardWare >> 4;
-            DSA_DpmiCallRegs.edi = (unsigned int)DSA_VbeHardWare & 0x0F;
+            DSA_DpmiCallRegs.es = (uintptr_t)DSA_VbeHardWare >> 4;
+            DSA_DpmiCallRegs.edi = (uintptr_t)DSA_VbeHardWare & 0x0F;
             DSA_DpmiCallRegs.ss = 0;
             DSA_DpmiCallRegs.sp = 0;
             sregs.es = FP_SEG(&DSA_DpmiCallRegs);
@@ -367,16 +479,16 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
             inregs.w.bx = 0x10;
             inregs.w.cx = 0;
             int386x(0x31, &inregs, &inregs, &sregs);
-            if(DSA_DpmiCallRegs.eax != 0x4f)
+            if((DSA_DpmiCallRegs.eax & 0xFFFF) == 0x4F)
             {
                 /* Get SVGA mode information */
                 DSA_VgaInfoBlock = (VBEModeInfoBlock *)BASEMEM_Alloc(256u, 0x102u);
                 ptr_dpmi_callregs = (void far *)&DSA_DpmiCallRegs;
                 BASEMEM_FillMemByte(&DSA_DpmiCallRegs, sizeof(DSA_DpmiCallRegs), 0);
                 DSA_DpmiCallRegs.eax = 0x4F01;
-                DSA_DpmiCallRegs.ecx = *(unsigned int *)((char *)&DSA_VgaInfoBlock + 2) >> 16;
-                DSA_DpmiCallRegs.es = (unsigned int)DSA_VgaInfoBlock >> 4;
-                DSA_DpmiCallRegs.edi = 0; /* TODO: Verify proper functionality (unsigned int)DSA_VgaInfoBlock & 0x0F; */
+                DSA_DpmiCallRegs.ecx = DSA_VideoMode;
+                DSA_DpmiCallRegs.es = (uintptr_t)DSA_VgaInfoBlock >> 4;
+                DSA_DpmiCallRegs.edi = (uintptr_t)DSA_VgaInfoBlock & 0x0F;
                 DSA_DpmiCallRegs.ss = 0;
                 DSA_DpmiCallRegs.sp = 0;
                 sregs.es = FP_SEG(&DSA_DpmiCallRegs);
@@ -385,7 +497,7 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
                 inregs.w.bx = 0x10;
                 inregs.w.cx = 0;
                 int386x(0x31, &inregs, &inregs, &sregs);
-                if(DSA_DpmiCallRegs.eax != 0x4f)
+                if((DSA_DpmiCallRegs.eax & 0xFFFF) == 0x4F)
                 {
                     if((DSA_VgaInfoBlock->WinAAttributes & 2) && (DSA_VgaInfoBlock->WinAAttributes & 4))
                     {
@@ -416,7 +528,7 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
                     else
                     {
                         DSA_currentBank = -1;
-                        if(DSA_globalParams.method_flags & 0x10000)
+                        if(DSA_globalParams.method_flags & DSA_METHOD_PAGE_FLIP)
                         {
                             /* Set logical scan line length */
                             inregs.w.ax = 0x4F06;
@@ -437,7 +549,8 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
                                 return 0;
                             }
                             DSA_MaxSupportedScreenSize = inregs.w.dx * inregs.w.bx; /* Max number of scanlines * bytes per scan line */
-                            if(2* DSA_Screen_Size > DSA_MaxSupportedScreenSize)
+                            DSA_Screen_Stride = inregs.w.bx;
+                            if(DSA_GetNumberOfBanks() * pixel_map->height * DSA_Screen_Stride > DSA_MaxSupportedScreenSize)
                             {
                                 BASEMEM_Free(DSA_VbeHardWare);
                                 BASEMEM_Free(DSA_VgaInfoBlock);
@@ -451,16 +564,15 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
                                 DSA_globalParams.method_flags = 0;
                                 return 0;
                             }
-                            max_4_word_77E00 = 2;
+                            max_4_word_77E00 = DSA_GetNumberOfBanks();
                             bank = 1;
-                            DSA_windowsSegmentAddress = 16 * DSA_VgaInfoBlock->WinASegment;
+                            DSA_SelectWindow();
+                            DSA_windowsSegmentAddress = 16 * (DSA_WindowNumber ? DSA_VgaInfoBlock->WinBSegment : DSA_VgaInfoBlock->WinASegment);
                             for(bank_index = 0; bank_index < 4; bank_index++)
                             {
-                                DSA_ScreenBuffer[bank_index] = (char*)&DSA_windowsSegmentAddress;
+                                DSA_ScreenBuffer[bank_index] = (char*)(uintptr_t)DSA_windowsSegmentAddress;
                                 DSA_ScanlineStart[bank_index] = pixel_map->height * bank_index;
                             }
-                            winSizeInBytes = DSA_VgaInfoBlock->WinSize * 1024;
-                            irgendwas_mit_bank_dword_77988 = DSA_VgaInfoBlock->WinSize / DSA_VgaInfoBlock->WinGranularity;
                             /* Get/Set display start */
                             inregs.w.ax = 0x4F07;
                             inregs.w.bx = 0;
@@ -481,22 +593,23 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
                                 DSA_globalParams.method_flags = 0;
                                 return 0;
                             }
+                            retVal = 1;
                         }
                         else
                         {
                             max_4_word_77E00 = 1;
                             bank = 0;
-                            DSA_windowsSegmentAddress = 16 * DSA_VgaInfoBlock->WinASegment;
+                            DSA_SelectWindow();
+                            DSA_windowsSegmentAddress = 16 * (DSA_WindowNumber ? DSA_VgaInfoBlock->WinBSegment : DSA_VgaInfoBlock->WinASegment);
                             for(bank_index = 0; bank_index < 4; bank_index++)
                             {
-                                DSA_ScreenBuffer[bank_index] = (char*)&DSA_windowsSegmentAddress;
+                                DSA_ScreenBuffer[bank_index] = (char*)(uintptr_t)DSA_windowsSegmentAddress;
                                 DSA_ScanlineStart[bank_index] = 0;
                             }
-                            winSizeInBytes = DSA_VgaInfoBlock->WinSize * 1024;
-                            irgendwas_mit_bank_dword_77988 = DSA_VgaInfoBlock->WinSize / DSA_VgaInfoBlock->WinGranularity;
                             if(DSA_VgaInfoBlock->BytesPerScanLine != pixel_map->stride)
                             {
-                                pixel_map->stride = DSA_VgaInfoBlock->BytesPerScanLine;
+                                /* the rows on the card are longer than those of the main OPM */
+                                DSA_Screen_Stride = DSA_VgaInfoBlock->BytesPerScanLine;
                                 word_77DF6 = 1;
                             }
                             retVal = 1;
@@ -536,18 +649,35 @@ unsigned int DSA_OpenScreen(OPM_Struct *pixel_map, int method)
         retVal = 0;
     }
 
+    if (retVal)
+    {
+        /* Every bank starts out empty, so each has all of the screen to catch up on */
+        for (bank_index = 0; bank_index < max_4_word_77E00; bank_index++)
+        {
+            OPM_New(pixel_map->width, pixel_map->height, pixel_map->bytes_per_pixel, &DSA_BankDirtyRects[bank_index], pixel_map->buffer);
+        }
+    }
     return retVal;
 }
 
 void DSA_CloseScreen(void)
 {
     union REGS inregs;
+    int bank_index;
 
     if(DSA_globalParams.flags & 1)
     {
         SYSTEM_DrawMousePtr();
         DSA_globalParams.flags = 0;
 
+        for (bank_index = 0; bank_index < 4; bank_index++)
+        {
+            OPM_Del(&DSA_BankDirtyRects[bank_index]);
+        }
+
+        OPM_DelGFX(&DSA_MouseCursorGfx);
+        DSA_MouseCursorGfxSource = 0;
+
         if(DSA_VbeHardWare != 0)
         {
             BASEMEM_Free(DSA_VbeHardWare);
@@ -558,9 +688,16 @@ void DSA_CloseScreen(void)
             BASEMEM_Free(DSA_VgaInfoBlock);
             DSA_VgaInfoBlock = 0;
         }
-        /* Set video mode */
-        inregs.w.ax = DSA_PreviousVideoMode;
-        int386(0x10, &inregs, &inregs);
+        if (DSA_InternalMode == 3)
+        {
+            DSAHOST_Close();
+        }
+        else
+        {
+            /* Set video mode */
+            inregs.w.ax = DSA_PreviousVideoMode;
+            int386(0x10, &inregs, &inregs);
+        }
         DSA_VideoMode = -1;
     }
 
@@ -571,6 +708,201 @@ void VGA_CopyScreenBuffer(void *dest, const void *src)
     memcpy(dest, src, DSA_Screen_Size);
 }
 
+/* Copy only the dirty rectangles of 'src_pixel_map' to the screen. */
+void VGA_CopyScreenRects(char *screenBuffer, OPM_Struct *src_pixel_map)
+{
+    OPM_RectStruct *rect;
+    unsigned char *src;
+    char *dst;
+    int width, height;
+    int i;
+
+    for (i = 0; i < src_pixel_map->number_of_dirty_rects; i++)
+    {
+        rect = &src_pixel_map->dirty_rects[i];
+        width = rect->x1 - rect->x0;
+        height = rect->y1 - rect->y0;
+        src = &src_pixel_map->buffer[rect->y0 * src_pixel_map->stride + rect->x0];
+        dst = &screenBuffer[rect->y0 * (int)DSA_Screen_Stride + rect->x0];
+
+        if (width == src_pixel_map->stride && width == (int)DSA_Screen_Stride)
+        {
+            /* full rows are one contiguous block */
+            memcpy(dst, src, width * height);
+            continue;
+        }
+
+        for (; height > 0; height--)
+        {
+            memcpy(dst, src, width);
+            src += src_pixel_map->stride;
+            dst += DSA_Screen_Stride;
+        }
+    }
+}
+
+/* Copy the dirty rectangles of 'src_pixel_map', or all of it with 'full', to video memory from scanline
+   'first_scanline' on, through the window at DSA_ScreenBuffer[bank]. The rows are copied from top to bottom and the
+   rectangles in each row from left to right, leaving out what a rectangle further left already copied, so video memory
+   is written in increasing order. The window therefore only moves forward, to the granule of the first byte that is
+   not in it, and never more often than there are granules to write; a row that runs past the end of the window is
+   split. */
+void VGA_CopyScreenRectsBanked(OPM_Struct *src_pixel_map, unsigned int first_scanline, int full)
+{
+    OPM_RectStruct full_rect;
+    OPM_RectStruct *rects;
+    OPM_RectStruct *rect;
+    unsigned char *src;
+    unsigned int window_start;
+    unsigned int offset;
+    int order[OPM_MAX_DIRTY_RECTS];
+    int number_of_rects;
+    int x0;
+    int x1;
+    int length;
+    int count;
+    int y0;
+    int y1;
+    int y;
+    int i;
+    int j;
+
+    rects = src_pixel_map->dirty_rects;
+    number_of_rects = src_pixel_map->number_of_dirty_rects;
+    if (full)
+    {
+        full_rect.x0 = 0;
+        full_rect.y0 = 0;
+        full_rect.x1 = src_pixel_map->width;
+        full_rect.y1 = src_pixel_map->height;
+        rects = &full_rect;
+        number_of_rects = 1;
+    }
+    if (number_of_rects <= 0)
+    {
+        return;
+    }
+
+    /* Rectangles sorted by their left edge, and the rows they cover together */
+    y0 = rects[0].y0;
+    y1 = rects[0].y1;
+    for (i = 0; i < number_of_rects; i++)
+    {
+        for (j = i; j > 0 && rects[order[j - 1]].x0 > rects[i].x0; j--)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+        if (rects[i].y0 < y0)
+        {
+            y0 = rects[i].y0;
+        }
+        if (rects[i].y1 > y1)
+        {
+            y1 = rects[i].y1;
+        }
+    }
+
+    for (y = y0; y < y1; y++)
+    {
+        x1 = 0;
+        for (i = 0; i < number_of_rects; i++)
+        {
+            rect = &rects[order[i]];
+            if (y < rect->y0 || y >= rect->y1 || rect->x1 <= x1)
+            {
+                continue;
+            }
+            x0 = rect->x0 > x1 ? rect->x0 : x1;
+            x1 = rect->x1;
+            src = &src_pixel_map->buffer[y * src_pixel_map->stride + x0 * src_pixel_map->bytes_per_pixel];
+            offset = (first_scanline + y) * DSA_Screen_Stride + x0 * src_pixel_map->bytes_per_pixel;
+            length = (x1 - x0) * src_pixel_map->bytes_per_pixel;
+            while (length > 0)
+            {
+                window_start = DSA_currentBank * DSA_WindowGranularity;
+                if (DSA_currentBank == 0xFFFF || offset < window_start || offset >= window_start + winSizeInBytes)
+                {
+                    DSA_SetWindow(offset / DSA_WindowGranularity);
+                    window_start = DSA_currentBank * DSA_WindowGranularity;
+                }
+                count = window_start + winSizeInBytes - offset;
+                if (count > length)
+                {
+                    count = length;
+                }
+                memcpy(&DSA_ScreenBuffer[bank][offset - window_start], src, count);
+                src += count;
+                offset += count;
+                length -= count;
+            }
+        }
+    }
+}
+
+/* Copy the dirty rectangles of 'src_pixel_map', or all of it with 'full', to the page of an unchained mode at
+   'screenBuffer'. The rectangles are widened to whole groups of four pixels. Each plane is selected once per
+   rectangle and gets every fourth pixel of it: sixteen pixels are read as four words and the bytes of the plane are
+   gathered into one word, which is written at once. */
+void VGA_CopyScreenRectsPlanar(char *screenBuffer, OPM_Struct *src_pixel_map, int full)
+{
+    OPM_RectStruct full_rect;
+    OPM_RectStruct *rects;
+    unsigned int pixels[4];
+    unsigned int value;
+    unsigned char *src;
+    unsigned char *dst;
+    int number_of_rects;
+    int x0, x1;
+    int shift;
+    int plane;
+    int count;
+    int y;
+    int i;
+
+    rects = src_pixel_map->dirty_rects;
+    number_of_rects = src_pixel_map->number_of_dirty_rects;
+    if (full)
+    {
+        full_rect.x0 = 0;
+        full_rect.y0 = 0;
+        full_rect.x1 = src_pixel_map->width;
+        full_rect.y1 = src_pixel_map->height;
+        rects = &full_rect;
+        number_of_rects = 1;
+    }
+
+    for (i = 0; i < number_of_rects; i++)
+    {
+        x0 = rects[i].x0 & ~3;
+        x1 = (rects[i].x1 + 3) & ~3;
+        if (x1 > src_pixel_map->width)
+        {
+            x1 = src_pixel_map->width & ~3;
+        }
+        for (plane = 0; plane < 4; plane++)
+        {
+            DSA_SetPlaneMask(1 << plane);
+            shift = plane * 8;
+            for (y = rects[i].y0; y < rects[i].y1; y++)
+            {
+                src = &src_pixel_map->buffer[y * src_pixel_map->stride + x0];
+                dst = (unsigned char *)&screenBuffer[y * DSA_Screen_Stride + x0 / 4];
+                for (count = (x1 - x0) / 4; count >= 4; count -= 4, src += 16, dst += 4)
+                {
+                    memcpy(pixels, src, 16);
+                    value = ((pixels[0] >> shift) & 0xFF) | (((pixels[1] >> shift) & 0xFF) << 8) | (((pixels[2] >> shift) & 0xFF) << 16) | ((pixels[3] >> shift) << 24);
+                    memcpy(dst, &value, 4);
+                }
+                for (; count > 0; count--, src += 4, dst++)
+                {
+                    *dst = src[plane];
+                }
+            }
+        }
+    }
+}
+
 void VGA_CopyMouseCursor(char *screenBuffer, unsigned char *opmBuffer, int stride, int x, int y, unsigned int opmWidth, unsigned int opmHeight)
 {
     /* TODO: Implementation not verified yet */
@@ -618,27 +950,16 @@ void VGA_CopyScreenSectionToBuffer(unsigned char *opmBuffer, char *screenBuffer,
 void ASM_copyMouseCursorWithTransparency(char transparent_color, int count, unsigned char *mouse_body, unsigned char *buffer1, unsigned char *buffer2)
 {
     /* TODO: Implementation not verified yet */
-    char value;
-    do
-    {
-        value = *buffer2;
-        if (*mouse_body != transparent_color)
-        {
-            *buffer2 = *mouse_body;
-        }
-        *buffer1 = value;
-        ++buffer2;
-        ++buffer1;
-        ++mouse_body;
-        count--;
-    }
-    while (count > 0);
+    ASM_CopyCursorWithTransparency(buffer1, buffer2, mouse_body, (unsigned char)transparent_color, count);
 }
 
+/* Present the main OPM. Only its dirty rectangles are uploaded, unless 'flag' is set: that forces the whole frame
+   and is meant for the screen having been changed behind our back, e.g. by a video mode change. */
 void DSA_CopyMainOPMToScreen(unsigned short flag)
 {
     int v2;
     OPM_Struct *src_pixel_map;
+    OPM_Struct screen_pixel_map;
     unsigned short old_mouse_position_x;
     unsigned short old_mouse_position_y;
     unsigned short new_mouse_position_x;
@@ -650,8 +971,11 @@ void DSA_CopyMainOPMToScreen(unsigned short flag)
 
         if((src_pixel_map->flags & BBOPM_MODIFIED) || flag)
         {
+            DSA_UpdateBankDirtyRects(src_pixel_map, flag);
+
+            /* The cursor and the areas saved under it are 8 bit, so it is only drawn into an 8 bit main OPM */
             v2 = 0;
-            if ( DSA_MouseUpdateFlag && !(DSA_globalParams.method_flags & 0x10000) )
+            if ( DSA_MouseUpdateFlag && src_pixel_map->bytes_per_pixel == 1 )
             {
                 DSA_MouseUpdateFlag = 0;
                 old_mouse_position_x = DSA_MouseValue_X_Current;
@@ -660,36 +984,20 @@ void DSA_CopyMainOPMToScreen(unsigned short flag)
                 new_mouse_position_x = SYSTEM_MouseCursorPtr->position_x + DSA_MouseValue_X_Current;
                 new_mouse_position_y = SYSTEM_MouseCursorPtr->position_y + DSA_MouseValue_Y_Current;
 
-                switch (DSA_InternalMode)
+                /* The main OPM holds a single page in every mode */
+                OPM_CopyOPMOPM(src_pixel_map, (OPM_Struct *)&bmouseback,
+                               new_mouse_position_x, new_mouse_position_y,
+                               SYSTEM_MouseCursorPtr->width, SYSTEM_MouseCursorPtr->height, 0, 0);
+                if (DSA_UpdateMouseCursorGfx())
                 {
-                    case 0:
-                    {
-                        OPM_CopyOPMOPM(src_pixel_map, (OPM_Struct *)&bmouseback,
-                                       new_mouse_position_x, DSA_ScanlineStart[bank] + new_mouse_position_y,
-                                       SYSTEM_MouseCursorPtr->width, SYSTEM_MouseCursorPtr->height, 0, 0);
-                        break;
-                    }
-                    case 1:
-                    {
-                        OPM_CopyOPMOPM(src_pixel_map, (OPM_Struct *)&bmouseback,
-                                       new_mouse_position_x, new_mouse_position_y,
-                                       SYSTEM_MouseCursorPtr->width, SYSTEM_MouseCursorPtr->height, 0, 0);
-                        break;
-                    }
-                    case 2:
-                    {
-                        OPM_CopyOPMOPM(src_pixel_map, (OPM_Struct *)&bmouseback,
-                                       new_mouse_position_x, new_mouse_position_y,
-                                       SYSTEM_MouseCursorPtr->width, SYSTEM_MouseCursorPtr->height, 0, 0);
-                        break;
-                    }
-                    default:
-                    {
-                        break;
-                    }
+                    memcpy(bmouseoldback.buffer, bmouseback.buffer, SYSTEM_MouseCursorSize);
+                    OPM_CopyGFXOPM(&DSA_MouseCursorGfx, &bmouseback, 0, 0);
+                }
+                else
+                {
+                    ASM_copyMouseCursorWithTransparency(SYSTEM_MouseCursorPtr->transparent_color, SYSTEM_MouseCursorSize,
+                                                        SYSTEM_MouseCursorPtr->body_data, bmouseoldback.buffer, bmouseback.buffer);
                 }
-                ASM_copyMouseCursorWithTransparency(SYSTEM_MouseCursorPtr->transparent_color, SYSTEM_MouseCursorSize,
-                                                    SYSTEM_MouseCursorPtr->body_data, bmouseoldback.buffer, bmouseback.buffer);
                 OPM_CopyOPMOPM(&bmouseback, src_pixel_map, 0, 0,
                                 SYSTEM_MouseCursorPtr->width, SYSTEM_MouseCursorPtr->height,
                                 new_mouse_position_x, new_mouse_position_y);
@@ -699,27 +1007,51 @@ void DSA_CopyMainOPMToScreen(unsigned short flag)
             {
                 case 0:
                 {
-                    if(word_77DF6)
-                    {
-                        /* FIXME: Missing function; not implemented yet */
-                    }
-                    else if(bank == 1)
+                    VGA_CopyScreenRectsBanked(src_pixel_map, DSA_ScanlineStart[bank], flag);
+                    break;
+                }
+                case 1:
+                {
+                    if (flag)
                     {
-                        /* FIXME: Missing function; not implemented yet */
+                        VGA_CopyScreenBuffer((void *)DSA_ScreenBuffer[bank], src_pixel_map->buffer);
                     }
                     else
                     {
-                        /* FIXME: Missing function; not implemented yet */
+                        VGA_CopyScreenRects(DSA_ScreenBuffer[bank], src_pixel_map);
                     }
+                    break;
                 }
-                case 1:
+                case 2:
                 {
-                    VGA_CopyScreenBuffer((void *)DSA_ScreenBuffer[bank], src_pixel_map->buffer);
+                    VGA_CopyScreenRectsPlanar(DSA_ScreenBuffer[bank], src_pixel_map, flag);
                     break;
                 }
-                case 2:
+                case 3:
                 {
-                    /* FIXME: Missing function; not implemented yet */
+                    if (DSA_globalParams.method_flags & DSA_METHOD_PLANAR)
+                    {
+                        /* through the emulated planes, and from there to the framebuffer */
+                        VGA_CopyScreenRectsPlanar(DSA_ScreenBuffer[bank], src_pixel_map, flag);
+                        DSAHOST_FlushWindow();
+                        DSAHOST_PresentPlanar(src_pixel_map, (unsigned char *)DSA_ScreenBuffer[bank] - DSAHOST_Window, flag, bank);
+                    }
+                    else if (DSA_globalParams.method_flags & DSA_METHOD_BANKED)
+                    {
+                        /* through the emulated window into video memory, and from there to the framebuffer */
+                        VGA_CopyScreenRectsBanked(src_pixel_map, DSA_ScanlineStart[bank], flag);
+                        DSAHOST_FlushWindow();
+                        OPM_New(src_pixel_map->width, src_pixel_map->height, 1, &screen_pixel_map, DSAHOST_VideoMemory + DSA_ScanlineStart[bank] * DSA_Screen_Stride);
+                        screen_pixel_map.stride = DSA_Screen_Stride;
+                        screen_pixel_map.number_of_dirty_rects = src_pixel_map->number_of_dirty_rects;
+                        memcpy(screen_pixel_map.dirty_rects, src_pixel_map->dirty_rects, sizeof(screen_pixel_map.dirty_rects));
+                        DSAHOST_Present(&screen_pixel_map, flag, bank);
+                        OPM_Del(&screen_pixel_map);
+                    }
+                    else
+                    {
+                        DSAHOST_Present(src_pixel_map, flag, bank);
+                    }
                     break;
                 }
                 default:
@@ -739,8 +1071,15 @@ void DSA_CopyMainOPMToScreen(unsigned short flag)
                     SYSTEM_RefreshMousePtr();
                 }
                 DSA_MouseUpdateFlag = 1;
+
+                /* The bank shows the cursor but the main OPM does not, so it is drawn over at the bank's next present */
+                OPM_AddDirtyRect(&DSA_BankDirtyRects[bank], new_mouse_position_x, new_mouse_position_y, SYSTEM_MouseCursorPtr->width, SYSTEM_MouseCursorPtr->height);
             }
+            OPM_ClearDirtyRects(src_pixel_map);
             src_pixel_map->flags &= 0xFDu;
+
+            DSA_ShowBank(bank);
+            bank = (bank + 1) % max_4_word_77E00;
         }
     }
 }
@@ -757,6 +1096,7 @@ void DSA_LoadPal(LBM_LogPalette* src_pal, unsigned int src_offset, unsigned shor
             dest_pal->pal_entry[dest_offset+i].peGreen = src_pal->pal_entry[src_offset+i].peGreen;
             dest_pal->pal_entry[dest_offset+i].peBlue = src_pal->pal_entry[src_offset+i].peBlue;
             dest_pal->pal_entry[dest_offset+i].peFlags = src_pal->pal_entry[src_offset+i].peFlags;
+            OPM_SetPaletteEntry(dest_offset+i, dest_pal->pal_entry[dest_offset+i].peRed, dest_pal->pal_entry[dest_offset+i].peGreen, dest_pal->pal_entry[dest_offset+i].peBlue);
         }
     }
 }
@@ -776,6 +1116,11 @@ void VGA_ActivatePal(unsigned int length, LBM_PaletteEntry* pal_entry)
 
 void DSA_ActivatePal(void)
 {
+    if (DSA_InternalMode == 3)
+    {
+        DSAHOST_SetPalette(DSA_globalParams.global_palette_data->number_of_entries, DSA_globalParams.global_palette_data->pal_entry);
+        return;
+    }
     VGA_ActivatePal(DSA_globalParams.global_palette_data->number_of_entries, DSA_globalParams.global_palette_data->pal_entry);
 }
 
@@ -791,34 +1136,282 @@ void DSA_SetPalEntry(int paletteIndex, char redValue, char greenValue, char blue
         pal_entry->peGreen = greenValue;
         pal_entry->peBlue = blueValue;
         pal_entry->peFlags = 0;
+        OPM_SetPaletteEntry(paletteIndex, redValue, greenValue, blueValue);
     }
 }
 
+/* Scale 'src_pixel_map' to the size of 'dest_pixel_map' by picking the nearest pixels. A destination row whose source
+   row is the same as that of the row above it is copied from that row instead of being scaled again. */
 void DSA_StretchOPMToScreen(OPM_Struct *src_pixel_map, OPM_Struct *dest_pixel_map)
 {
     int src_pixel_width_index;
+    int src_row, previous_src_row;
     signed int j;
     signed int i;
     int v5;
     unsigned char *src_pixel;
     unsigned char *dest_pixel;
-    
+
+    v5 = (src_pixel_map->width << 10) / dest_pixel_map->width;
+    previous_src_row = -1;
+
     for ( i = 0; dest_pixel_map->height > i; ++i )
     {
-        src_pixel = &src_pixel_map->buffer[i * src_pixel_map->height / dest_pixel_map->height * src_pixel_map->width];
-        dest_pixel = &dest_pixel_map->buffer[i * dest_pixel_map->width];
-        v5 = (src_pixel_map->width << 10) / dest_pixel_map->width;
+        src_row = i * src_pixel_map->height / dest_pixel_map->height;
+        dest_pixel = &dest_pixel_map->buffer[i * dest_pixel_map->stride];
+
+        if (src_row == previous_src_row)
+        {
+            memcpy(dest_pixel, dest_pixel - dest_pixel_map->stride, dest_pixel_map->width);
+            continue;
+        }
+        previous_src_row = src_row;
+
+        src_pixel = &src_pixel_map->buffer[src_row * src_pixel_map->stride];
+        if (src_pixel_map->width == dest_pixel_map->width)
+        {
+            memcpy(dest_pixel, src_pixel, dest_pixel_map->width);
+            continue;
+        }
+
         src_pixel_width_index = 0;
-        
         for ( j = 0; dest_pixel_map->width > j; ++j )
         {
             dest_pixel[j] = src_pixel[src_pixel_width_index >> 10];
             src_pixel_width_index += v5;
         }
     }
+
+    OPM_AddDirtyRect(dest_pixel_map, 0, 0, dest_pixel_map->width, dest_pixel_map->height);
+}
+
+/* Two banks with page flipping, three with triple buffering, else one. */
+static int DSA_GetNumberOfBanks(void)
+{
+    if (!(DSA_globalParams.method_flags & DSA_METHOD_PAGE_FLIP))
+    {
+        return 1;
+    }
+    return DSA_globalParams.method_flags & DSA_METHOD_TRIPLE_BUFFER ? 3 : 2;
+}
+
+/* Before 'pixel_map' is presented to bank 'bank': the other banks miss what changed in this frame, and the pixel map
+   takes on what this bank missed while the frames went to the others. With 'full' the whole frame has changed. */
+static void DSA_UpdateBankDirtyRects(OPM_Struct *pixel_map, int full)
+{
+    OPM_RectStruct *rect;
+    int bank_index;
+    int i;
+
+    for (bank_index = 0; bank_index < max_4_word_77E00; bank_index++)
+    {
+        if (bank_index == bank)
+        {
+            continue;
+        }
+        if (full)
+        {
+            OPM_AddDirtyRect(&DSA_BankDirtyRects[bank_index], 0, 0, pixel_map->width, pixel_map->height);
+            continue;
+        }
+        for (i = 0; i < pixel_map->number_of_dirty_rects; i++)
+        {
+            rect = &pixel_map->dirty_rects[i];
+            OPM_AddDirtyRect(&DSA_BankDirtyRects[bank_index], rect->x0, rect->y0, rect->x1 - rect->x0, rect->y1 - rect->y0);
+        }
+    }
+
+    for (i = 0; i < DSA_BankDirtyRects[bank].number_of_dirty_rects; i++)
+    {
+        rect = &DSA_BankDirtyRects[bank].dirty_rects[i];
+        OPM_AddDirtyRect(pixel_map, rect->x0, rect->y0, rect->x1 - rect->x0, rect->y1 - rect->y0);
+    }
+    OPM_ClearDirtyRects(&DSA_BankDirtyRects[bank]);
+}
+
+/* Make bank 'bank_index' the visible one. With two banks this waits for the vertical retrace, since the next frame
+   goes to the bank that stays visible until then; with three the next frame goes to a bank that was already hidden
+   by the flip before, so the new start address is only set. A single bank is always visible, but the host backend
+   still hands the frame on. */
+static void DSA_ShowBank(int bank_index)
+{
+    union REGS inregs;
+    unsigned int offset;
+
+    if (max_4_word_77E00 < 2 && DSA_InternalMode != 3)
+    {
+        return;
+    }
+
+    switch (DSA_InternalMode)
+    {
+        case 0:
+        {
+            /* Set display start */
+            inregs.w.ax = 0x4F07;
+            inregs.w.bx = max_4_word_77E00 > 2 ? 0 : 0x80;
+            inregs.w.cx = 0;
+            inregs.w.dx = DSA_ScanlineStart[bank_index];
+            int386(0x10, &inregs, &inregs);
+            break;
+        }
+        case 2:
+        {
+            /* CRTC start address, taken over by the card at the next vertical retrace */
+            offset = (uintptr_t)DSA_ScreenBuffer[bank_index] - 0xA0000L;
+            while (inp(0x3DA) & 1)
+            {
+            }
+            outp(0x3D4, 0x0C);
+            outp(0x3D5, offset >> 8);
+            outp(0x3D4, 0x0D);
+            outp(0x3D5, offset & 0xFF);
+            if (max_4_word_77E00 <= 2)
+            {
+                while (!(inp(0x3DA) & 8))
+                {
+                }
+            }
+            break;
+        }
+        case 3:
+        {
+            DSAHOST_ShowBank(bank_index);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+/* Write through window A if it can be written to, else through window B. */
+static void DSA_SelectWindow(void)
+{
+    DSA_WindowNumber = (DSA_VgaInfoBlock->WinAAttributes & 5) == 5 ? 0 : 1;
+    winSizeInBytes = DSA_VgaInfoBlock->WinSize * 1024;
+    DSA_WindowGranularity = DSA_VgaInfoBlock->WinGranularity ? DSA_VgaInfoBlock->WinGranularity * 1024 : winSizeInBytes;
+    DSA_currentBank = -1;
+}
+
+/* Move the window to granule 'position' of video memory. */
+static void DSA_SetWindow(unsigned short position)
+{
+    union REGS inregs;
+
+    DSA_currentBank = position;
+    if (DSA_InternalMode == 3)
+    {
+        DSAHOST_SetWindow(position);
+        return;
+    }
+    /* Display window control */
+    inregs.w.ax = 0x4F05;
+    inregs.w.bx = DSA_WindowNumber;
+    inregs.w.dx = position;
+    int386(0x10, &inregs, &inregs);
+}
+
+/* Turn mode 13h, which the BIOS has just set, into the unchained mode 'width' pixels wide, and clear all of video
+   memory. */
+static void DSA_SetModeX(int width)
+{
+    DSA_WriteRegisters(0x3C4, DSA_ModeXSequencer, sizeof(DSA_ModeXSequencer) / sizeof(DSA_ModeXSequencer[0]));
+    if (width == 360)
+    {
+        /* Synchronous reset while the clock changes */
+        outp(0x3C4, 0x00);
+        outp(0x3C5, 0x01);
+        outp(0x3C2, 0xE7);
+        outp(0x3C4, 0x00);
+        outp(0x3C5, 0x03);
+        /* Allow writes to CRTC registers 0 to 7 */
+        outp(0x3D4, 0x11);
+        outp(0x3D5, inp(0x3D5) & 0x7F);
+        DSA_WriteRegisters(0x3D4, DSA_ModeX360x240CRTC, sizeof(DSA_ModeX360x240CRTC) / sizeof(DSA_ModeX360x240CRTC[0]));
+    }
+    else
+    {
+        DSA_WriteRegisters(0x3D4, DSA_ModeXCRTC, sizeof(DSA_ModeXCRTC) / sizeof(DSA_ModeXCRTC[0]));
+    }
+
+    DSA_SetPlaneMask(0x0F);
+    memset((void *)0xA0000L, 0, 0x10000);
+}
+
+static void DSA_WriteRegisters(int port, const unsigned short *registers, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        outp(port, registers[i] & 0xFF);
+        outp(port + 1, registers[i] >> 8);
+    }
+}
+
+/* Select the planes that writes to video memory go to in the unchained modes, one bit per plane. */
+static void DSA_SetPlaneMask(int mask)
+{
+    if (DSA_InternalMode == 3)
+    {
+        DSAHOST_SetPlaneMask(mask);
+        return;
+    }
+    /* Sequencer map mask */
+    outp(0x3C4, 0x02);
+    outp(0x3C5, mask);
+}
+
+/* Compile the current mouse cursor into runs when it has changed since the last call. Cursors larger than their
+   body data are not compiled. */
+static int DSA_UpdateMouseCursorGfx(void)
+{
+    OPM_Struct cursor_pixel_map;
+    unsigned int size;
+
+    size = SYSTEM_MouseCursorPtr->width * SYSTEM_MouseCursorPtr->height;
+    if (DSA_MouseCursorGfxSource == SYSTEM_MouseCursorPtr
+        && DSA_MouseCursorGfxCopy.width == SYSTEM_MouseCursorPtr->width
+        && DSA_MouseCursorGfxCopy.height == SYSTEM_MouseCursorPtr->height
+        && DSA_MouseCursorGfxCopy.transparent_color == SYSTEM_MouseCursorPtr->transparent_color
+        && memcmp(DSA_MouseCursorGfxCopy.body_data, SYSTEM_MouseCursorPtr->body_data, size) == 0)
+    {
+        return 1;
+    }
+
+    OPM_DelGFX(&DSA_MouseCursorGfx);
+    DSA_MouseCursorGfxSource = 0;
+
+    if (size > sizeof(SYSTEM_MouseCursorPtr->body_data))
+    {
+        return 0;
+    }
+    if (!OPM_New(SYSTEM_MouseCursorPtr->width, SYSTEM_MouseCursorPtr->height, 1, &cursor_pixel_map, SYSTEM_MouseCursorPtr->body_data))
+    {
+        return 0;
+    }
+    cursor_pixel_map.flags |= BBOPM_TRANSPARENCY;
+    cursor_pixel_map.transparent_color = SYSTEM_MouseCursorPtr->transparent_color;
+
+    if (!OPM_CreateGFX(&cursor_pixel_map, &DSA_MouseCursorGfx))
+    {
+        OPM_Del(&cursor_pixel_map);
+        return 0;
+    }
+    OPM_Del(&cursor_pixel_map);
+
+    DSA_MouseCursorGfxSource = SYSTEM_MouseCursorPtr;
+    /* Cursors are allocated with only as much body data as they need */
+    DSA_MouseCursorGfxCopy.width = SYSTEM_MouseCursorPtr->width;
+    DSA_MouseCursorGfxCopy.height = SYSTEM_MouseCursorPtr->height;
+    DSA_MouseCursorGfxCopy.transparent_color = SYSTEM_MouseCursorPtr->transparent_color;
+    memcpy(DSA_MouseCursorGfxCopy.body_data, SYSTEM_MouseCursorPtr->body_data, size);
+    return 1;
 }
 
 static void DSA_PrintData(char *buffer, DSA_ErrorStruct *data)
 {
-    sprintf(buffer, "ERROR!: %s  %ld, %ld", data->text, data->data1, data->data2);
+    sprintf(buffer, "ERROR!: %s  %ld, %ld", data->text, (long int)data->data1, (long int)data->data2);
 }
\ No newline at end of file
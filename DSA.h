@@ -28,6 +28,14 @@
 #include <stdint.h>
 #include "OPM.h"
 
+/* DSA_OpenScreen method flags. With page flipping every present goes to a bank that is not visible, which is shown
+   once the frame is complete; triple buffering adds a third bank so that a present never waits for the retrace. */
+#define DSA_METHOD_PAGE_FLIP 0x10000
+#define DSA_METHOD_HOST 0x20000         /* present to the framebuffer of the host backend (see DSAHOST.h) */
+#define DSA_METHOD_TRIPLE_BUFFER 0x40000
+#define DSA_METHOD_BANKED 0x80000       /* host backend: present through an emulated VESA window, for testing */
+#define DSA_METHOD_PLANAR 0x100000      /* host backend: present through emulated unchained VGA planes, for testing */
+
 typedef struct {
     char* text;
     int data1;
@@ -87,6 +95,9 @@ extern void DSA_LoadPal(LBM_LogPalette* src_pal, unsigned int src_offset, unsign
 extern void DSA_ActivatePal(void);
 extern void DSA_SetPalEntry(int paletteIndex, char redValue, char greenValue, char blueValue);
 extern void DSA_StretchOPMToScreen(OPM_Struct *src_pixel_map, OPM_Struct *dest_pixel_map);
+extern void VGA_CopyScreenRects(char *screenBuffer, OPM_Struct *src_pixel_map);
+extern void VGA_CopyScreenRectsBanked(OPM_Struct *src_pixel_map, unsigned int first_scanline, int full);
+extern void VGA_CopyScreenRectsPlanar(char *screenBuffer, OPM_Struct *src_pixel_map, int full);
 extern void VGA_CopyMouseCursor(char *screenBuffer, unsigned char *opmBuffer, int stride, int x, int y, unsigned int opmWidth, unsigned int opmHeight);
 extern void VGA_CopyScreenSectionToBuffer(unsigned char *opmBuffer, char *screenBuffer, int stride, int x, int y, unsigned int opmWidth, unsigned int opmHeight);
 extern void ASM_copyMouseCursorWithTransparency(char transparent_color, int count, unsigned char *mouse_body, unsigned char *buffer1, unsigned char *buffer2);
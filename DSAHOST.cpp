@@ -0,0 +1,598 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * Screen backend for build hosts without VGA hardware. The main OPM is
+ * presented to a 32 bit framebuffer in memory, which can be written out
+ * as PPM files or shared with a viewer process.
+ *************************************************************************/
+
+#include "BASEMEM.h"
+#include "ERROR.h"
+#include "DSAHOST.h"
+#include <stdio.h>
+#include <string.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+unsigned int *DSAHOST_FrameBuffer;
+unsigned int *DSAHOST_Banks[DSAHOST_MAX_BANKS];
+unsigned int DSAHOST_FramesPresented;
+unsigned int DSAHOST_PixelsConverted;
+unsigned char *DSAHOST_VideoMemory;
+unsigned char *DSAHOST_Window;
+unsigned int DSAHOST_WindowMoves;
+
+static int DSAHOST_Sink = DSAHOST_SINK_NONE;
+static char DSAHOST_SinkPath[256];
+static unsigned int DSAHOST_SinkNumberOffset;
+static unsigned int DSAHOST_Width;
+static unsigned int DSAHOST_Height;
+static unsigned int DSAHOST_PaletteLUT[256];
+static DSAHOST_ShmHeaderStruct *DSAHOST_ShmHeader;
+static unsigned int DSAHOST_ShmSize;
+static unsigned char *DSAHOST_RowBuffer;
+static unsigned int DSAHOST_VideoMemorySize;
+static unsigned int DSAHOST_WindowGranularity;
+static unsigned int DSAHOST_WindowSize;
+static unsigned int DSAHOST_WindowStart;
+static int DSAHOST_PlaneMask;
+
+static unsigned int DSAHOST_GetWindowLength(void);
+static void DSAHOST_ConvertRow(unsigned int *dst, const unsigned char *src, int width);
+static void DSAHOST_WritePPM(void);
+static void DSAHOST_PrintData(char *buffer, DSA_ErrorStruct *data);
+
+/* Choose where the following DSAHOST_Open sends its frames. The path of a PPM sequence must contain one %u for the
+   frame number and no other %. Returns 0, and sends the frames nowhere, if the path is not usable. */
+int DSAHOST_SetSink(int sink, const char *path)
+{
+    DSA_ErrorStruct data;
+    const char *number;
+
+    DSAHOST_Sink = DSAHOST_SINK_NONE;
+    DSAHOST_SinkPath[0] = 0;
+    if (sink == DSAHOST_SINK_NONE)
+    {
+        return 1;
+    }
+
+    if (path == NULL || strlen(path) >= sizeof(DSAHOST_SinkPath))
+    {
+        data.text = "DSAHOST_SetSink: Path missing or too long - sink,length";
+        data.data1 = sink;
+        data.data2 = path ? strlen(path) : 0;
+        ERROR_PushError((ERROR_PrintErrorPtr)DSAHOST_PrintData, "BBDSA Library", sizeof(data), (const char *) &data);
+
+        return 0;
+    }
+    if (sink == DSAHOST_SINK_PPM)
+    {
+        number = strchr(path, '%');
+        if (number == NULL || number[1] != 'u' || strchr(number + 2, '%') != NULL)
+        {
+            data.text = "DSAHOST_SetSink: PPM path needs one frame number field and no other percent sign - sink,length";
+            data.data1 = sink;
+            data.data2 = strlen(path);
+            ERROR_PushError((ERROR_PrintErrorPtr)DSAHOST_PrintData, "BBDSA Library", sizeof(data), (const char *) &data);
+
+            return 0;
+        }
+        DSAHOST_SinkNumberOffset = number - path;
+    }
+
+    strcpy(DSAHOST_SinkPath, path);
+    DSAHOST_Sink = sink;
+    return 1;
+}
+
+/* Open a screen of 'number_of_banks' banks; the first one is visible. */
+int DSAHOST_Open(unsigned int width, unsigned int height, int number_of_banks)
+{
+    DSA_ErrorStruct data;
+    unsigned int *pixels;
+    unsigned int size;
+    int i;
+#if defined(__linux__)
+    void *mapping;
+    int fd;
+#endif
+
+    DSAHOST_Close();
+
+    if (number_of_banks < 1 || number_of_banks > DSAHOST_MAX_BANKS)
+    {
+        number_of_banks = 1;
+    }
+    size = width * height * 4;
+    pixels = 0;
+    data.text = 0;
+    if (DSAHOST_Sink == DSAHOST_SINK_SHM)
+    {
+#if defined(__linux__)
+        DSAHOST_ShmSize = sizeof(DSAHOST_ShmHeaderStruct) + size * number_of_banks;
+        mapping = MAP_FAILED;
+        fd = shm_open(DSAHOST_SinkPath, O_CREAT | O_RDWR, 0600);
+        if (fd >= 0)
+        {
+            if (ftruncate(fd, DSAHOST_ShmSize) == 0)
+            {
+                mapping = mmap(0, DSAHOST_ShmSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            close(fd);
+        }
+        if (mapping == MAP_FAILED)
+        {
+            data.text = "DSAHOST_Open: Cannot map shared memory width,height";
+        }
+        else
+        {
+            DSAHOST_ShmHeader = (DSAHOST_ShmHeaderStruct *)mapping;
+            DSAHOST_ShmHeader->magic = DSAHOST_SHM_MAGIC;
+            DSAHOST_ShmHeader->width = width;
+            DSAHOST_ShmHeader->height = height;
+            DSAHOST_ShmHeader->stride = width * 4;
+            DSAHOST_ShmHeader->number_of_banks = number_of_banks;
+            DSAHOST_ShmHeader->bank = 0;
+            DSAHOST_ShmHeader->frame = 0;
+            pixels = (unsigned int *)(DSAHOST_ShmHeader + 1);
+        }
+#else
+        data.text = "DSAHOST_Open: No shared memory on this system width,height";
+#endif
+    }
+    else
+    {
+        pixels = (unsigned int *)BASEMEM_Alloc(size * number_of_banks, BASEMEM_XMS_MEMORY | BASEMEM_ZERO_MEMORY);
+        if (pixels == NULL)
+        {
+            data.text = "DSAHOST_Open: Cannot Allocate Mem for FrameBuffer width,height";
+        }
+        else if (DSAHOST_Sink == DSAHOST_SINK_PPM)
+        {
+            DSAHOST_RowBuffer = (unsigned char *)BASEMEM_Alloc(width * 3, BASEMEM_XMS_MEMORY);
+            if (DSAHOST_RowBuffer == NULL)
+            {
+                data.text = "DSAHOST_Open: Cannot Allocate Mem for PPM rows width,height";
+            }
+        }
+    }
+
+    if (pixels)
+    {
+        memset(pixels, 0, size * number_of_banks);
+        for (i = 0; i < number_of_banks; i++)
+        {
+            DSAHOST_Banks[i] = pixels + i * width * height;
+        }
+        DSAHOST_FrameBuffer = pixels;
+    }
+    DSAHOST_Width = width;
+    DSAHOST_Height = height;
+    DSAHOST_FramesPresented = 0;
+    DSAHOST_PixelsConverted = 0;
+    if (data.text)
+    {
+        DSAHOST_Close();
+        data.data1 = width;
+        data.data2 = height;
+        ERROR_PushError((ERROR_PrintErrorPtr)DSAHOST_PrintData, "BBDSA Library", sizeof(data), (const char *) &data);
+        return 0;
+    }
+    return 1;
+}
+
+void DSAHOST_Close(void)
+{
+    if (DSAHOST_ShmHeader)
+    {
+#if defined(__linux__)
+        munmap(DSAHOST_ShmHeader, DSAHOST_ShmSize);
+        shm_unlink(DSAHOST_SinkPath);
+#endif
+        DSAHOST_ShmHeader = 0;
+    }
+    else if (DSAHOST_Banks[0])
+    {
+        BASEMEM_Free(DSAHOST_Banks[0]);
+    }
+    DSAHOST_FrameBuffer = 0;
+    memset(DSAHOST_Banks, 0, sizeof(DSAHOST_Banks));
+
+    if (DSAHOST_RowBuffer)
+    {
+        BASEMEM_Free(DSAHOST_RowBuffer);
+        DSAHOST_RowBuffer = 0;
+    }
+
+    if (DSAHOST_VideoMemory)
+    {
+        BASEMEM_Free(DSAHOST_VideoMemory);
+        BASEMEM_Free(DSAHOST_Window);
+        DSAHOST_VideoMemory = 0;
+        DSAHOST_Window = 0;
+    }
+    DSAHOST_PlaneMask = 0;
+}
+
+/* Set up video memory of 'video_memory_size' bytes, seen through a window of 'window_size' bytes that moves in steps of
+   'granularity' bytes. The window starts at the beginning of video memory. */
+int DSAHOST_OpenWindow(unsigned int video_memory_size, unsigned int granularity, unsigned int window_size)
+{
+    DSA_ErrorStruct data;
+
+    DSAHOST_VideoMemory = (unsigned char *)BASEMEM_Alloc(video_memory_size, BASEMEM_XMS_MEMORY | BASEMEM_ZERO_MEMORY);
+    DSAHOST_Window = (unsigned char *)BASEMEM_Alloc(window_size, BASEMEM_XMS_MEMORY | BASEMEM_ZERO_MEMORY);
+    if (DSAHOST_VideoMemory == NULL || DSAHOST_Window == NULL)
+    {
+        if (DSAHOST_VideoMemory)
+        {
+            BASEMEM_Free(DSAHOST_VideoMemory);
+        }
+        if (DSAHOST_Window)
+        {
+            BASEMEM_Free(DSAHOST_Window);
+        }
+        DSAHOST_VideoMemory = 0;
+        DSAHOST_Window = 0;
+        data.text = "DSAHOST_OpenWindow: Cannot Allocate Mem for video memory size,window size";
+        data.data1 = video_memory_size;
+        data.data2 = window_size;
+        ERROR_PushError((ERROR_PrintErrorPtr)DSAHOST_PrintData, "BBDSA Library", sizeof(data), (const char *) &data);
+        return 0;
+    }
+
+    memset(DSAHOST_VideoMemory, 0, video_memory_size);
+    memset(DSAHOST_Window, 0, window_size);
+    DSAHOST_VideoMemorySize = video_memory_size;
+    DSAHOST_WindowGranularity = granularity;
+    DSAHOST_WindowSize = window_size;
+    DSAHOST_WindowStart = 0;
+    DSAHOST_WindowMoves = 0;
+    DSAHOST_PlaneMask = 0;
+    return 1;
+}
+
+/* Set up the four planes of 64 KB of an unchained VGA mode, one after the other in video memory. The window stands for
+   the 64 KB at A0000h and is written to the planes selected with DSAHOST_SetPlaneMask, initially all of them. */
+int DSAHOST_OpenPlanes(void)
+{
+    if (!DSAHOST_OpenWindow(4 * 0x10000, 0x10000, 0x10000))
+    {
+        return 0;
+    }
+    DSAHOST_PlaneMask = 0x0F;
+    return 1;
+}
+
+/* Select the planes that the window is written to. What was written so far goes to the previously selected planes, and
+   the window then shows the first selected plane, so bytes that are not written again keep their value. */
+void DSAHOST_SetPlaneMask(int mask)
+{
+    int plane;
+
+    if (DSAHOST_PlaneMask == 0 || (mask & 0x0F) == 0)
+    {
+        return;
+    }
+    DSAHOST_FlushWindow();
+    DSAHOST_PlaneMask = mask & 0x0F;
+    for (plane = 0; !(DSAHOST_PlaneMask & (1 << plane)); plane++);
+    memcpy(DSAHOST_Window, DSAHOST_VideoMemory + plane * 0x10000, 0x10000);
+    DSAHOST_WindowMoves++;
+}
+
+/* Move the window to granule 'position'. What was written to it goes to video memory first. */
+void DSAHOST_SetWindow(unsigned int position)
+{
+    if (DSAHOST_VideoMemory == NULL)
+    {
+        return;
+    }
+    DSAHOST_FlushWindow();
+    DSAHOST_WindowStart = position * DSAHOST_WindowGranularity;
+    memcpy(DSAHOST_Window, DSAHOST_VideoMemory + DSAHOST_WindowStart, DSAHOST_GetWindowLength());
+    DSAHOST_WindowMoves++;
+}
+
+void DSAHOST_FlushWindow(void)
+{
+    int plane;
+
+    if (DSAHOST_PlaneMask)
+    {
+        for (plane = 0; plane < 4; plane++)
+        {
+            if (DSAHOST_PlaneMask & (1 << plane))
+            {
+                memcpy(DSAHOST_VideoMemory + plane * 0x10000, DSAHOST_Window, 0x10000);
+            }
+        }
+    }
+    else if (DSAHOST_VideoMemory)
+    {
+        memcpy(DSAHOST_VideoMemory + DSAHOST_WindowStart, DSAHOST_Window, DSAHOST_GetWindowLength());
+    }
+}
+
+/* The part of the window that lies in video memory. */
+static unsigned int DSAHOST_GetWindowLength(void)
+{
+    if (DSAHOST_WindowStart >= DSAHOST_VideoMemorySize)
+    {
+        return 0;
+    }
+    return DSAHOST_VideoMemorySize - DSAHOST_WindowStart < DSAHOST_WindowSize ? DSAHOST_VideoMemorySize - DSAHOST_WindowStart : DSAHOST_WindowSize;
+}
+
+/* The host counterpart of VGA_ActivatePal: pixels presented from now on use these colors. */
+void DSAHOST_SetPalette(unsigned int length, LBM_PaletteEntry *pal_entry)
+{
+    unsigned int i;
+
+    for (i = 0; i < length && i < 256; i++)
+    {
+        DSAHOST_PaletteLUT[i] = ((unsigned int)pal_entry[i].peRed << 16) | ((unsigned int)pal_entry[i].peGreen << 8) | pal_entry[i].peBlue;
+    }
+}
+
+/* Convert the dirty rectangles of 'pixel_map', or all of it if 'full' is set, into bank 'bank_index'. */
+void DSAHOST_Present(OPM_Struct *pixel_map, int full, int bank_index)
+{
+    OPM_RectStruct full_rect;
+    OPM_RectStruct *rects;
+    unsigned char *src;
+    unsigned int *dst;
+    unsigned int value;
+    int number_of_rects;
+    int x0, y0, x1, y1;
+    int x;
+    int i;
+
+    if (bank_index < 0 || bank_index >= DSAHOST_MAX_BANKS || DSAHOST_Banks[bank_index] == NULL)
+    {
+        return;
+    }
+
+    rects = pixel_map->dirty_rects;
+    number_of_rects = pixel_map->number_of_dirty_rects;
+    if (full)
+    {
+        full_rect.x0 = 0;
+        full_rect.y0 = 0;
+        full_rect.x1 = pixel_map->width;
+        full_rect.y1 = pixel_map->height;
+        rects = &full_rect;
+        number_of_rects = 1;
+    }
+
+    for (i = 0; i < number_of_rects; i++)
+    {
+        x0 = rects[i].x0;
+        y0 = rects[i].y0;
+        x1 = rects[i].x1 < (int)DSAHOST_Width ? rects[i].x1 : DSAHOST_Width;
+        y1 = rects[i].y1 < (int)DSAHOST_Height ? rects[i].y1 : DSAHOST_Height;
+        if (x1 <= x0 || y1 <= y0)
+        {
+            continue;
+        }
+        DSAHOST_PixelsConverted += (x1 - x0) * (y1 - y0);
+
+        for (; y0 < y1; y0++)
+        {
+            src = pixel_map->buffer + y0 * pixel_map->stride + x0 * pixel_map->bytes_per_pixel;
+            dst = DSAHOST_Banks[bank_index] + y0 * DSAHOST_Width + x0;
+            switch (pixel_map->bytes_per_pixel)
+            {
+                case 1:
+                {
+                    DSAHOST_ConvertRow(dst, src, x1 - x0);
+                    break;
+                }
+                case 2:
+                {
+                    /* RGB 5:6:5, the top bits of each component repeat in its new low bits */
+                    for (x = x0; x < x1; x++, src += 2, dst++)
+                    {
+                        value = src[0] | (src[1] << 8);
+                        *dst = ((value & 0xF800) << 8) | ((value & 0xE000) << 3) | ((value & 0x07E0) << 5) | ((value & 0x0600) >> 1) | ((value & 0x001F) << 3) | ((value & 0x001C) >> 2);
+                    }
+                    break;
+                }
+                case 4:
+                {
+                    memcpy(dst, src, (x1 - x0) * 4);
+                    break;
+                }
+                default:
+                {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+/* Convert the dirty rectangles of 'pixel_map', or all of it if 'full' is set, from the planes into bank 'bank_index'.
+   The page starts 'page_offset' bytes into each plane; pixel x of a row is in plane x & 3. */
+void DSAHOST_PresentPlanar(OPM_Struct *pixel_map, unsigned int page_offset, int full, int bank_index)
+{
+    OPM_RectStruct full_rect;
+    OPM_RectStruct *rects;
+    unsigned char *src;
+    unsigned int *dst;
+    unsigned int stride;
+    int number_of_rects;
+    int x0, y0, x1, y1;
+    int x;
+    int i;
+
+    if (bank_index < 0 || bank_index >= DSAHOST_MAX_BANKS || DSAHOST_Banks[bank_index] == NULL || DSAHOST_PlaneMask == 0)
+    {
+        return;
+    }
+
+    rects = pixel_map->dirty_rects;
+    number_of_rects = pixel_map->number_of_dirty_rects;
+    if (full)
+    {
+        full_rect.x0 = 0;
+        full_rect.y0 = 0;
+        full_rect.x1 = pixel_map->width;
+        full_rect.y1 = pixel_map->height;
+        rects = &full_rect;
+        number_of_rects = 1;
+    }
+
+    stride = DSAHOST_Width / 4;
+    for (i = 0; i < number_of_rects; i++)
+    {
+        x0 = rects[i].x0;
+        y0 = rects[i].y0;
+        x1 = rects[i].x1 < (int)DSAHOST_Width ? rects[i].x1 : DSAHOST_Width;
+        y1 = rects[i].y1 < (int)DSAHOST_Height ? rects[i].y1 : DSAHOST_Height;
+        if (x1 <= x0 || y1 <= y0)
+        {
+            continue;
+        }
+        DSAHOST_PixelsConverted += (x1 - x0) * (y1 - y0);
+
+        for (; y0 < y1; y0++)
+        {
+            src = DSAHOST_VideoMemory + page_offset + y0 * stride;
+            dst = DSAHOST_Banks[bank_index] + y0 * DSAHOST_Width;
+            for (x = x0; x < x1; x++)
+            {
+                dst[x] = DSAHOST_PaletteLUT[src[(x & 3) * 0x10000 + x / 4]];
+            }
+        }
+    }
+}
+
+/* Flip to bank 'bank_index' by pointing the framebuffer at it, and hand the frame to the sink. */
+void DSAHOST_ShowBank(int bank_index)
+{
+    if (bank_index < 0 || bank_index >= DSAHOST_MAX_BANKS || DSAHOST_Banks[bank_index] == NULL)
+    {
+        return;
+    }
+
+    DSAHOST_FrameBuffer = DSAHOST_Banks[bank_index];
+    DSAHOST_FramesPresented++;
+    if (DSAHOST_Sink == DSAHOST_SINK_PPM)
+    {
+        DSAHOST_WritePPM();
+    }
+    else if (DSAHOST_ShmHeader)
+    {
+        DSAHOST_ShmHeader->bank = bank_index;
+        DSAHOST_ShmHeader->frame = DSAHOST_FramesPresented;
+    }
+}
+
+/* Look up a row of palette indices. With AVX2 eight pixels are gathered from the table at once; otherwise four
+   indices are read as one 32 bit word. */
+static void DSAHOST_ConvertRow(unsigned int *dst, const unsigned char *src, int width)
+{
+    unsigned int indices;
+#if defined(__AVX2__)
+    __m256i wide_indices;
+
+    for (; width >= 8; width -= 8, src += 8, dst += 8)
+    {
+        wide_indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src));
+        _mm256_storeu_si256((__m256i *)dst, _mm256_i32gather_epi32((const int *)DSAHOST_PaletteLUT, wide_indices, 4));
+    }
+#endif
+
+    for (; width >= 4; width -= 4, src += 4, dst += 4)
+    {
+        memcpy(&indices, src, 4);
+        dst[0] = DSAHOST_PaletteLUT[indices & 0xFF];
+        dst[1] = DSAHOST_PaletteLUT[(indices >> 8) & 0xFF];
+        dst[2] = DSAHOST_PaletteLUT[(indices >> 16) & 0xFF];
+        dst[3] = DSAHOST_PaletteLUT[indices >> 24];
+    }
+    for (; width > 0; width--, src++, dst++)
+    {
+        *dst = DSAHOST_PaletteLUT[*src];
+    }
+}
+
+/* Write the framebuffer as the next file of the PPM sequence. On an error the sequence stops. */
+static void DSAHOST_WritePPM(void)
+{
+    DSA_ErrorStruct data;
+    char file_name[sizeof(DSAHOST_SinkPath) + 16];
+    unsigned int *src;
+    unsigned char *dst;
+    FILE *fp;
+    unsigned int x;
+    unsigned int y;
+    int failed;
+
+    /* The path is not used as a format, only the part before and after its %u */
+    memcpy(file_name, DSAHOST_SinkPath, DSAHOST_SinkNumberOffset);
+    sprintf(file_name + DSAHOST_SinkNumberOffset, "%u", DSAHOST_FramesPresented);
+    strcat(file_name, DSAHOST_SinkPath + DSAHOST_SinkNumberOffset + 2);
+    fp = fopen(file_name, "wb");
+    failed = fp == NULL;
+    if (!failed)
+    {
+        failed = fprintf(fp, "P6\n%u %u\n255\n", DSAHOST_Width, DSAHOST_Height) < 0;
+        for (y = 0; y < DSAHOST_Height && !failed; y++)
+        {
+            src = DSAHOST_FrameBuffer + y * DSAHOST_Width;
+            dst = DSAHOST_RowBuffer;
+            for (x = 0; x < DSAHOST_Width; x++, src++, dst += 3)
+            {
+                dst[0] = (unsigned char)(*src >> 16);
+                dst[1] = (unsigned char)(*src >> 8);
+                dst[2] = (unsigned char)*src;
+            }
+            failed = fwrite(DSAHOST_RowBuffer, 3, DSAHOST_Width, fp) != DSAHOST_Width;
+        }
+        failed |= fclose(fp) != 0;
+    }
+
+    if (failed)
+    {
+        DSAHOST_Sink = DSAHOST_SINK_NONE;
+        data.text = "DSAHOST_WritePPM: Cannot write frame number";
+        data.data1 = DSAHOST_FramesPresented;
+        data.data2 = 0;
+        ERROR_PushError((ERROR_PrintErrorPtr)DSAHOST_PrintData, "BBDSA Library", sizeof(data), (const char *) &data);
+    }
+}
+
+static void DSAHOST_PrintData(char *buffer, DSA_ErrorStruct *data)
+{
+    sprintf(buffer, "ERROR!: %s  %ld, %ld", data->text, (long int)data->data1, (long int)data->data2);
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef DSAHOST_H
+#define DSAHOST_H
+
+#include <stdint.h>
+#include "OPM.h"
+#include "DSA.h"
+
+/* Where DSAHOST_Present sends the frames */
+#define DSAHOST_SINK_NONE 0     /* only the framebuffer in memory */
+#define DSAHOST_SINK_PPM 1      /* one PPM file per frame; a %u in the path is replaced by the frame number */
+#define DSAHOST_SINK_SHM 2      /* the framebuffer lives in a shared memory segment of that name */
+
+#define DSAHOST_SHM_MAGIC 0x54534F48u   /* "HOST" */
+
+#define DSAHOST_MAX_BANKS 4
+
+/* Start of the shared memory segment; the banks follow it, one after the other. A viewer shows bank 'bank' when
+   'frame' changes. */
+typedef struct
+{
+    unsigned int magic;
+    unsigned int width;
+    unsigned int height;
+    unsigned int stride;        /* bytes per row of pixels */
+    unsigned int number_of_banks;
+    volatile unsigned int bank;
+    volatile unsigned int frame;
+} DSAHOST_ShmHeaderStruct;
+
+/* The visible screen as XRGB 8:8:8:8 pixels, valid between DSAHOST_Open and DSAHOST_Close. Presents go to the
+   banks, which become visible with DSAHOST_ShowBank. */
+extern unsigned int *DSAHOST_FrameBuffer;
+extern unsigned int *DSAHOST_Banks[DSAHOST_MAX_BANKS];
+extern unsigned int DSAHOST_FramesPresented;
+extern unsigned int DSAHOST_PixelsConverted;
+
+/* Stand-in for the video memory of a VESA card with a movable window, valid between DSAHOST_OpenWindow and
+   DSAHOST_Close. Writes to the window reach video memory when it is moved or flushed. DSAHOST_OpenPlanes sets it up
+   as the four planes of an unchained VGA mode instead. */
+extern unsigned char *DSAHOST_VideoMemory;
+extern unsigned char *DSAHOST_Window;
+extern unsigned int DSAHOST_WindowMoves;
+
+extern int DSAHOST_SetSink(int sink, const char *path);
+extern int DSAHOST_Open(unsigned int width, unsigned int height, int number_of_banks);
+extern void DSAHOST_Close(void);
+extern void DSAHOST_SetPalette(unsigned int length, LBM_PaletteEntry *pal_entry);
+extern void DSAHOST_Present(OPM_Struct *pixel_map, int full, int bank_index);
+extern void DSAHOST_ShowBank(int bank_index);
+extern int DSAHOST_OpenWindow(unsigned int video_memory_size, unsigned int granularity, unsigned int window_size);
+extern void DSAHOST_SetWindow(unsigned int position);
+extern void DSAHOST_FlushWindow(void);
+extern int DSAHOST_OpenPlanes(void);
+extern void DSAHOST_SetPlaneMask(int mask);
+extern void DSAHOST_PresentPlanar(OPM_Struct *pixel_map, unsigned int page_offset, int full, int bank_index);
+
+#endif /* DSAHOST_H */
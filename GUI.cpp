@@ -32,6 +32,7 @@
 #include "BLEV.h"
 #include "FILE.h"
 #include "INI.h"
+#include "ERROR.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -41,6 +42,20 @@
 #include <dos.h>
 #include <stdarg.h>
 
+#define GUI_MAX_SPANS 96
+#define GUI_TEXT_LAYOUT_CACHE_SIZE 32
+#define GUI_MAX_SAVE_UNDERS 8
+#define GUI_DISPLAY_COMMANDS_STEP 256
+#define GUI_DISPLAY_STRINGS_STEP 1024
+#define GUI_DISPLAY_MERGE_DISTANCE 4
+#define GUI_SHADOW_LEVEL (OPM_SHADE_NORMAL / 2)
+
+typedef struct {
+    const char *text;
+    int data1;
+    int data2;
+} GUI_ErrorStruct;
+
 const char *GUI_StringData_German[] =
 {
     "Keine VGA-Karte vorhanden.",
@@ -304,8 +319,8 @@ unsigned int GUI_OpmHeight = 200;
 unsigned int GUI_ScreenWidth = 320;
 unsigned int GUI_ScreenHeight = 200;
 OPM_Struct GUI_ScreenOpm;
-OPM_Struct GUI_TextBoxPixelMap;
-OPM_Struct GUI_ProgressBarPixelMap;
+int GUI_TextBoxSaveUnder = -1;
+int GUI_ProgressBarSaveUnder = -1;
 
 int GUI_ProgressBarStatusFlag;
 int GUI_ProgressBarMaxLength;
@@ -323,52 +338,701 @@ char GUI_ErrorBuffer[400];
 
 unsigned char GUI_DriveNumber = 0; /* TODO: Purpose unclear */
 
+static GUI_TextLayoutStruct GUI_TextLayoutCache[GUI_TEXT_LAYOUT_CACHE_SIZE];
+static int GUI_NextTextLayout;
+
+static GUI_SaveUnderStruct GUI_SaveUnders[GUI_MAX_SAVE_UNDERS];
+static unsigned char *GUI_SaveUnderPool;
+static unsigned int GUI_SaveUnderPoolSize;
+
+static GUI_DisplayListStruct *GUI_RecordingList;
+static GUI_DisplayListStruct GUI_ProgressBarDisplayList;
+
 void GUI_DrawMessageBox(char *text, char *heading, char *button, unsigned char color0, unsigned char color1, unsigned char color2, unsigned char color3, unsigned char color4, unsigned char color5, int color6);
 
+/* Append a command to 'buffer'. Returns 0 if there is no memory left for it. */
+static int GUI_RecordCommand(GUI_DisplayBufferStruct *buffer, int type, int x0, int y0, int x1, int y1, unsigned char color, const char *string)
+{
+    GUI_DisplayCommandStruct *command;
+    unsigned int length;
+    void *memory;
+
+    if (buffer->number_of_commands == buffer->max_commands)
+    {
+        memory = realloc(buffer->commands, (buffer->max_commands + GUI_DISPLAY_COMMANDS_STEP) * sizeof(GUI_DisplayCommandStruct));
+        if (memory == NULL)
+        {
+            return 0;
+        }
+        buffer->commands = (GUI_DisplayCommandStruct *)memory;
+        buffer->max_commands += GUI_DISPLAY_COMMANDS_STEP;
+    }
+
+    command = &buffer->commands[buffer->number_of_commands];
+    command->string = 0;
+    if (string)
+    {
+        length = strlen(string) + 1;
+        if (buffer->strings_size + length > buffer->max_strings_size)
+        {
+            memory = realloc(buffer->strings, buffer->strings_size + length + GUI_DISPLAY_STRINGS_STEP);
+            if (memory == NULL)
+            {
+                return 0;
+            }
+            buffer->strings = (char *)memory;
+            buffer->max_strings_size = buffer->strings_size + length + GUI_DISPLAY_STRINGS_STEP;
+        }
+        memcpy(buffer->strings + buffer->strings_size, string, length);
+        command->string = buffer->strings_size;
+        buffer->strings_size += length;
+    }
+    command->type = type;
+    command->color = color;
+    command->x0 = x0;
+    command->y0 = y0;
+    command->x1 = x1;
+    command->y1 = y1;
+    buffer->number_of_commands++;
+    return 1;
+}
+
+static int GUI_IsSameCommand(const GUI_DisplayCommandStruct *a, const char *a_strings, const GUI_DisplayCommandStruct *b, const char *b_strings)
+{
+    if (a->type != b->type || a->color != b->color || a->x0 != b->x0 || a->y0 != b->y0 || a->x1 != b->x1 || a->y1 != b->y1)
+    {
+        return 0;
+    }
+    return a->type != GUI_DISPLAY_STRING || strcmp(a_strings + a->string, b_strings + b->string) == 0;
+}
+
+static int GUI_IsOverlapping(const GUI_DisplayCommandStruct *a, const GUI_DisplayCommandStruct *b)
+{
+    return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1;
+}
+
+/* Coverage masks have one bit per pixel and 'words_per_row' words per row. x0 and x1 are inclusive. */
+static int GUI_IsSpanCovered(const unsigned int *row, int x0, int x1)
+{
+    unsigned int bits;
+    int word;
+
+    for (word = x0 >> 5; word <= x1 >> 5; word++)
+    {
+        bits = 0xFFFFFFFFu;
+        if (word == x0 >> 5)
+        {
+            bits &= 0xFFFFFFFFu << (x0 & 31);
+        }
+        if (word == x1 >> 5)
+        {
+            bits &= 0xFFFFFFFFu >> (31 - (x1 & 31));
+        }
+        if ((row[word] & bits) != bits)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void GUI_CoverSpan(unsigned int *row, int x0, int x1)
+{
+    unsigned int bits;
+    int word;
+
+    for (word = x0 >> 5; word <= x1 >> 5; word++)
+    {
+        bits = 0xFFFFFFFFu;
+        if (word == x0 >> 5)
+        {
+            bits &= 0xFFFFFFFFu << (x0 & 31);
+        }
+        if (word == x1 >> 5)
+        {
+            bits &= 0xFFFFFFFFu >> (31 - (x1 & 31));
+        }
+        row[word] |= bits;
+    }
+}
+
+/* Draw one command; fills have to lie inside the clip rectangle already, strings are clipped here. */
+static void GUI_DrawDisplayCommand(OPM_Struct *pixel_map, const GUI_DisplayCommandStruct *command, const char *strings, int clip_x0, int clip_y0, int clip_x1, int clip_y1)
+{
+    OPM_Struct view;
+
+    if (command->type == GUI_DISPLAY_FILL)
+    {
+        OPM_FillBox(pixel_map, command->x0, command->y0, command->x1 - command->x0 + 1, command->y1 - command->y0 + 1, command->color);
+    }
+    else if (command->type == GUI_DISPLAY_REMAP)
+    {
+        OPM_RemapBox(pixel_map, command->x0, command->y0, command->x1 - command->x0 + 1, command->y1 - command->y0 + 1, command->color);
+    }
+    else if (command->type == GUI_DISPLAY_STRING)
+    {
+        if (command->x0 >= clip_x0 && command->y0 >= clip_y0 && command->x1 <= clip_x1 && command->y1 <= clip_y1)
+        {
+            OPM_DrawString(pixel_map, (char *)strings + command->string, command->x0, command->y0, command->color);
+        }
+        else
+        {
+            OPM_CreateVirtualOPM(pixel_map, &view, clip_x0, clip_y0, clip_x1 - clip_x0 + 1, clip_y1 - clip_y0 + 1);
+            OPM_DrawString(&view, (char *)strings + command->string, command->x0 - clip_x0, command->y0 - clip_y0, command->color);
+        }
+    }
+}
+
+/* Clip a copy of 'command' to the clip rectangle. Commands outside of it become GUI_DISPLAY_NONE; strings keep their
+   position, since they cannot be cut. */
+static void GUI_ClipDisplayCommand(GUI_DisplayCommandStruct *clipped, const GUI_DisplayCommandStruct *command, int clip_x0, int clip_y0, int clip_x1, int clip_y1)
+{
+    *clipped = *command;
+    if (command->x0 > clip_x1 || command->x1 < clip_x0 || command->y0 > clip_y1 || command->y1 < clip_y0)
+    {
+        clipped->type = GUI_DISPLAY_NONE;
+    }
+    else if (command->type != GUI_DISPLAY_STRING)
+    {
+        clipped->x0 = command->x0 < clip_x0 ? clip_x0 : command->x0;
+        clipped->y0 = command->y0 < clip_y0 ? clip_y0 : command->y0;
+        clipped->x1 = command->x1 > clip_x1 ? clip_x1 : command->x1;
+        clipped->y1 = command->y1 > clip_y1 ? clip_y1 : command->y1;
+    }
+}
+
+/* Shading a second time would darken or lighten the pixels under it again, and these are not part of the list. */
+static int GUI_IsShownRemap(const GUI_DisplayBufferStruct *buffer, const GUI_DisplayBufferStruct *shown, int i)
+{
+    return buffer->commands[i].type == GUI_DISPLAY_REMAP && shown && i < shown->number_of_commands
+        && GUI_IsSameCommand(&buffer->commands[i], buffer->strings, &shown->commands[i], shown->strings);
+}
+
+/* Draw the part of 'buffer' inside the clip rectangle (inclusive bounds). Going backwards, commands that the fills
+   after them cover completely are dropped and single line fills are cut down to their uncovered part. Going
+   forwards, fills of the same color that together form a rectangle are then drawn as one. Shading commands that
+   are the same in 'shown', the recording the pixel map shows, are not applied a second time. The working copy of the
+   commands and the coverage mask are kept in 'list' and only grow. */
+static void GUI_DrawDisplayBuffer(GUI_DisplayListStruct *list, GUI_DisplayBufferStruct *buffer, const GUI_DisplayBufferStruct *shown, OPM_Struct *pixel_map, int clip_x0, int clip_y0, int clip_x1, int clip_y1)
+{
+    GUI_DisplayCommandStruct *commands;
+    GUI_DisplayCommandStruct *command;
+    GUI_DisplayCommandStruct merged;
+    unsigned int *mask;
+    unsigned int *row;
+    unsigned int mask_words;
+    void *memory;
+    int words_per_row;
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    int distance;
+    int i;
+    int j;
+    int k;
+
+    if (clip_x0 < 0)
+    {
+        clip_x0 = 0;
+    }
+    if (clip_y0 < 0)
+    {
+        clip_y0 = 0;
+    }
+    if (clip_x1 >= pixel_map->width)
+    {
+        clip_x1 = pixel_map->width - 1;
+    }
+    if (clip_y1 >= pixel_map->height)
+    {
+        clip_y1 = pixel_map->height - 1;
+    }
+    if (clip_x1 < clip_x0 || clip_y1 < clip_y0 || buffer->number_of_commands == 0)
+    {
+        return;
+    }
+
+    if (buffer->number_of_commands > list->max_scratch)
+    {
+        memory = realloc(list->scratch, buffer->max_commands * sizeof(GUI_DisplayCommandStruct));
+        if (memory != NULL)
+        {
+            list->scratch = (GUI_DisplayCommandStruct *)memory;
+            list->max_scratch = buffer->max_commands;
+        }
+    }
+    commands = list->scratch;
+    if (buffer->number_of_commands > list->max_scratch)
+    {
+        /* Draw everything in the order it was recorded */
+        for (i = 0; i < buffer->number_of_commands; i++)
+        {
+            GUI_ClipDisplayCommand(&merged, &buffer->commands[i], clip_x0, clip_y0, clip_x1, clip_y1);
+            if (!GUI_IsShownRemap(buffer, shown, i))
+            {
+                GUI_DrawDisplayCommand(pixel_map, &merged, buffer->strings, clip_x0, clip_y0, clip_x1, clip_y1);
+            }
+        }
+        return;
+    }
+    for (i = 0; i < buffer->number_of_commands; i++)
+    {
+        GUI_ClipDisplayCommand(&commands[i], &buffer->commands[i], clip_x0, clip_y0, clip_x1, clip_y1);
+        if (GUI_IsShownRemap(buffer, shown, i))
+        {
+            commands[i].type = GUI_DISPLAY_NONE;
+        }
+    }
+
+    words_per_row = (clip_x1 - clip_x0 + 32) >> 5;
+    mask_words = words_per_row * (clip_y1 - clip_y0 + 1);
+    if (mask_words > list->max_mask_words)
+    {
+        memory = realloc(list->mask, mask_words * sizeof(unsigned int));
+        if (memory != NULL)
+        {
+            list->mask = (unsigned int *)memory;
+            list->max_mask_words = mask_words;
+        }
+    }
+    mask = list->mask;
+    if (mask_words <= list->max_mask_words)
+    {
+        memset(mask, 0, mask_words * sizeof(unsigned int));
+        for (i = buffer->number_of_commands - 1; i >= 0; i--)
+        {
+            command = &commands[i];
+            if (command->type == GUI_DISPLAY_NONE)
+            {
+                continue;
+            }
+
+            /* Mask coordinates of the visible part */
+            x0 = (command->x0 < clip_x0 ? clip_x0 : command->x0) - clip_x0;
+            y0 = (command->y0 < clip_y0 ? clip_y0 : command->y0) - clip_y0;
+            x1 = (command->x1 > clip_x1 ? clip_x1 : command->x1) - clip_x0;
+            y1 = (command->y1 > clip_y1 ? clip_y1 : command->y1) - clip_y0;
+            for (k = y0; k <= y1 && GUI_IsSpanCovered(mask + k * words_per_row, x0, x1); k++)
+            {
+            }
+            if (k > y1)
+            {
+                command->type = GUI_DISPLAY_NONE;
+                continue;
+            }
+
+            if (command->type == GUI_DISPLAY_FILL)
+            {
+                if (y0 == y1)
+                {
+                    row = mask + y0 * words_per_row;
+                    while ((row[x0 >> 5] >> (x0 & 31)) & 1)
+                    {
+                        x0++;
+                    }
+                    while ((row[x1 >> 5] >> (x1 & 31)) & 1)
+                    {
+                        x1--;
+                    }
+                    command->x0 = x0 + clip_x0;
+                    command->x1 = x1 + clip_x0;
+                }
+                for (k = y0; k <= y1; k++)
+                {
+                    GUI_CoverSpan(mask + k * words_per_row, x0, x1);
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < buffer->number_of_commands; i++)
+    {
+        command = &commands[i];
+        if (command->type != GUI_DISPLAY_FILL)
+        {
+            continue;
+        }
+
+        /* A fill a few commands back can take this one in, if nothing drawn in between overlaps either of them */
+        for (j = i - 1, distance = 0; j >= 0 && distance < GUI_DISPLAY_MERGE_DISTANCE; j--)
+        {
+            if (commands[j].type == GUI_DISPLAY_NONE)
+            {
+                continue;
+            }
+            distance++;
+            if (commands[j].type != GUI_DISPLAY_FILL || commands[j].color != command->color)
+            {
+                continue;
+            }
+            if (!(commands[j].y0 == command->y0 && commands[j].y1 == command->y1 && commands[j].x0 <= command->x1 + 1 && command->x0 <= commands[j].x1 + 1)
+                && !(commands[j].x0 == command->x0 && commands[j].x1 == command->x1 && commands[j].y0 <= command->y1 + 1 && command->y0 <= commands[j].y1 + 1))
+            {
+                continue;
+            }
+
+            merged = *command;
+            merged.x0 = commands[j].x0 < command->x0 ? commands[j].x0 : command->x0;
+            merged.y0 = commands[j].y0 < command->y0 ? commands[j].y0 : command->y0;
+            merged.x1 = commands[j].x1 > command->x1 ? commands[j].x1 : command->x1;
+            merged.y1 = commands[j].y1 > command->y1 ? commands[j].y1 : command->y1;
+            for (k = j + 1; k < i && (commands[k].type == GUI_DISPLAY_NONE || !GUI_IsOverlapping(&commands[k], &merged)); k++)
+            {
+            }
+            if (k == i)
+            {
+                commands[j] = merged;
+                command->type = GUI_DISPLAY_NONE;
+            }
+            break;
+        }
+    }
+
+    for (i = 0; i < buffer->number_of_commands; i++)
+    {
+        GUI_DrawDisplayCommand(pixel_map, &commands[i], buffer->strings, clip_x0, clip_y0, clip_x1, clip_y1);
+    }
+}
+
+/* Record a command into the list being recorded. Returns 0 if the caller has to draw it itself, because no list is
+   being recorded or there is no memory left. In the latter case the commands recorded so far are drawn first. */
+static int GUI_Record(OPM_Struct *pixel_map, int type, int x0, int y0, int x1, int y1, unsigned char color, const char *string)
+{
+    GUI_DisplayListStruct *list;
+    GUI_DisplayBufferStruct *shown;
+    GUI_DisplayCommandStruct command;
+
+    list = GUI_RecordingList;
+    if (list == NULL)
+    {
+        return 0;
+    }
+    if (x1 < x0 || y1 < y0)
+    {
+        return 1;
+    }
+
+    shown = NULL;
+    if (list->shown && list->pixel_map == pixel_map)
+    {
+        shown = &list->buffers[list->shown - 1];
+    }
+    if (!list->is_broken)
+    {
+        if (GUI_RecordCommand(&list->buffers[list->current], type, x0, y0, x1, y1, color, string))
+        {
+            return 1;
+        }
+
+        /* Draw what was recorded so far and the rest as it comes */
+        GUI_DrawDisplayBuffer(list, &list->buffers[list->current], shown, pixel_map, 0, 0, pixel_map->width - 1, pixel_map->height - 1);
+        list->is_broken = 1;
+        list->broken_index = list->buffers[list->current].number_of_commands;
+    }
+
+    /* Shading the pixel map already shows is not applied again */
+    command.type = (unsigned char)type;
+    command.color = color;
+    command.x0 = (short)x0;
+    command.y0 = (short)y0;
+    command.x1 = (short)x1;
+    command.y1 = (short)y1;
+    command.string = 0;
+    list->broken_index++;
+    return type == GUI_DISPLAY_REMAP && shown && list->broken_index <= shown->number_of_commands
+        && GUI_IsSameCommand(&command, NULL, &shown->commands[list->broken_index - 1], shown->strings);
+}
+
+/* The GUI draws through these functions, which record instead of drawing while a display list is recorded */
+static void GUI_FillSpans(OPM_Struct *pixel_map, const OPM_SpanStruct *spans, int number_of_spans)
+{
+    int i;
+
+    for (i = 0; i < number_of_spans; i++)
+    {
+        if (!GUI_Record(pixel_map, GUI_DISPLAY_FILL, spans[i].x0, spans[i].y, spans[i].x1, spans[i].y, spans[i].color, NULL))
+        {
+            OPM_FillSpans(pixel_map, &spans[i], number_of_spans - i);
+            return;
+        }
+    }
+}
+
+static void GUI_FillBox(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigned char color)
+{
+    if (!GUI_Record(pixel_map, GUI_DISPLAY_FILL, x, y, x + width - 1, y + height - 1, color, NULL))
+    {
+        OPM_FillBox(pixel_map, x, y, width, height, color);
+    }
+}
+
+static void GUI_RemapBox(OPM_Struct *pixel_map, int x, int y, int width, int height, int level)
+{
+    if (!GUI_Record(pixel_map, GUI_DISPLAY_REMAP, x, y, x + width - 1, y + height - 1, level, NULL))
+    {
+        OPM_RemapBox(pixel_map, x, y, width, height, level);
+    }
+}
+
+static void GUI_DrawString(OPM_Struct *pixel_map, char *string, int x, int y, unsigned char color)
+{
+    if (!GUI_Record(pixel_map, GUI_DISPLAY_STRING, x, y, x + (int)strlen(string) * OPM_MediumFont.width - 1, y + OPM_MediumFont.height - 1, color, string))
+    {
+        OPM_DrawString(pixel_map, string, x, y, color);
+    }
+}
+
+/* Start recording the drawing functions of the GUI into 'list' instead of drawing. */
+void GUI_BeginDisplayList(GUI_DisplayListStruct *list)
+{
+    /* Keep the recording the pixel map shows to compare the new one against */
+    list->current = list->shown == 1 ? 1 : 0;
+    list->buffers[list->current].number_of_commands = 0;
+    list->buffers[list->current].strings_size = 0;
+    list->is_broken = 0;
+    GUI_RecordingList = list;
+}
+
+void GUI_EndDisplayList(void)
+{
+    GUI_RecordingList = NULL;
+}
+
+/* Draw the last recording of 'list'. If the pixel map still shows the recording before it, only the area of the
+   commands that changed is drawn again, so drawing an unchanged list draws nothing. */
+void GUI_ExecuteDisplayList(GUI_DisplayListStruct *list, OPM_Struct *pixel_map)
+{
+    GUI_DisplayBufferStruct *buffer;
+    GUI_DisplayBufferStruct *shown;
+    GUI_DisplayCommandStruct *command;
+    int number_of_commands;
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    int i;
+
+    if (list->is_broken)
+    {
+        /* Already drawn while recording, the part that was recorded can still be compared against */
+        list->shown = list->current + 1;
+        list->pixel_map = pixel_map;
+        list->is_shown_partial = 1;
+        return;
+    }
+
+    buffer = &list->buffers[list->current];
+    shown = NULL;
+    number_of_commands = buffer->number_of_commands;
+    if (list->shown && list->pixel_map == pixel_map)
+    {
+        shown = &list->buffers[list->shown - 1];
+        if (shown->number_of_commands > number_of_commands)
+        {
+            number_of_commands = shown->number_of_commands;
+        }
+    }
+
+    /* Everything if the pixel map does not show the list or not all of it was recorded, else the area of the
+       commands that differ */
+    x0 = 0x7FFF;
+    y0 = 0x7FFF;
+    x1 = -0x8000;
+    y1 = -0x8000;
+    if (list->is_shown_partial)
+    {
+        x0 = 0;
+        y0 = 0;
+        x1 = pixel_map->width - 1;
+        y1 = pixel_map->height - 1;
+    }
+    for (i = 0; i < number_of_commands; i++)
+    {
+        if (shown)
+        {
+            if (i < buffer->number_of_commands && i < shown->number_of_commands && GUI_IsSameCommand(&buffer->commands[i], buffer->strings, &shown->commands[i], shown->strings))
+            {
+                continue;
+            }
+            if (i < shown->number_of_commands)
+            {
+                command = &shown->commands[i];
+                x0 = command->x0 < x0 ? command->x0 : x0;
+                y0 = command->y0 < y0 ? command->y0 : y0;
+                x1 = command->x1 > x1 ? command->x1 : x1;
+                y1 = command->y1 > y1 ? command->y1 : y1;
+            }
+        }
+        if (i < buffer->number_of_commands)
+        {
+            command = &buffer->commands[i];
+            x0 = command->x0 < x0 ? command->x0 : x0;
+            y0 = command->y0 < y0 ? command->y0 : y0;
+            x1 = command->x1 > x1 ? command->x1 : x1;
+            y1 = command->y1 > y1 ? command->y1 : y1;
+        }
+    }
+
+    list->shown = list->current + 1;
+    list->pixel_map = pixel_map;
+    list->is_shown_partial = 0;
+    if (x0 <= x1 && y0 <= y1)
+    {
+        GUI_DrawDisplayBuffer(list, buffer, shown, pixel_map, x0, y0, x1, y1);
+    }
+}
+
+/* Forget what the pixel map shows, for when something else has drawn over the list. */
+void GUI_InvalidateDisplayList(GUI_DisplayListStruct *list)
+{
+    list->shown = 0;
+}
+
+void GUI_DelDisplayList(GUI_DisplayListStruct *list)
+{
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        free(list->buffers[i].commands);
+        free(list->buffers[i].strings);
+    }
+    free(list->scratch);
+    free(list->mask);
+    memset(list, 0, sizeof(GUI_DisplayListStruct));
+}
+
+/* Add a span to 'spans', drawing the ones collected so far when the array is full. */
+static void GUI_AddSpan(OPM_Struct *pixel_map, OPM_SpanStruct *spans, int *number_of_spans, int y, int x0, int x1, unsigned char color)
+{
+    if (*number_of_spans == GUI_MAX_SPANS)
+    {
+        GUI_FillSpans(pixel_map, spans, *number_of_spans);
+        *number_of_spans = 0;
+    }
+
+    spans[*number_of_spans].y = y;
+    spans[*number_of_spans].x0 = x0;
+    spans[*number_of_spans].x1 = x1;
+    spans[*number_of_spans].color = color;
+    (*number_of_spans)++;
+}
+
 void GUI_DrawArrow(OPM_Struct *pixel_map, int x, int y, char color, int direction)
 {
-    OPM_HorLine(pixel_map, (x - 1), (y - 4 * direction), 3, color);
-    OPM_HorLine(pixel_map, (x - 1), (y - 3 * direction), 3, color);
-    OPM_HorLine(pixel_map, (x - 1), (y - 2 * direction), 3, color);
-    OPM_HorLine(pixel_map, (x - 1), (y - direction), 3, color);
-    OPM_HorLine(pixel_map, (x - 4), y, 9, color);
-    OPM_HorLine(pixel_map, (x - 3), (direction + y), 7, color);
-    OPM_HorLine(pixel_map, (x - 2), (y + 2 * direction), 5, color);
-    OPM_HorLine(pixel_map, (x - 1), (y + 3 * direction), 3, color);
-    OPM_HorLine(pixel_map, x, (y + 4 * direction), 1, color);
+    OPM_SpanStruct spans[9];
+    int i;
+
+    /* a shaft of width 3 and a head whose rows get two pixels narrower towards the tip */
+    for (i = 0; i < 4; i++)
+    {
+        spans[i].y = y - (4 - i) * direction;
+        spans[i].x0 = x - 1;
+        spans[i].x1 = x + 1;
+    }
+    for (i = 0; i < 5; i++)
+    {
+        spans[4 + i].y = y + i * direction;
+        spans[4 + i].x0 = x - 4 + i;
+        spans[4 + i].x1 = x + 4 - i;
+    }
+    for (i = 0; i < 9; i++)
+    {
+        spans[i].color = color;
+    }
+
+    GUI_FillSpans(pixel_map, spans, 9);
 }
 
 void GUI_DrawFrame(OPM_Struct *pixel_map, int leftBoundary, int upperBoundary, int rightBoundary, int lowerBoundary, unsigned char color)
 {
+    OPM_SpanStruct spans[GUI_MAX_SPANS];
+    int number_of_spans;
+    int i;
+
     if (rightBoundary >= leftBoundary && lowerBoundary >= upperBoundary)
     {
-        OPM_HorLine(pixel_map, leftBoundary, upperBoundary, (rightBoundary - leftBoundary + 1), color);
-        OPM_VerLine(pixel_map, leftBoundary, upperBoundary, (lowerBoundary - upperBoundary + 1), color);
-        OPM_HorLine(pixel_map, leftBoundary, lowerBoundary, (rightBoundary - leftBoundary + 1), color);
-        OPM_VerLine(pixel_map, rightBoundary, upperBoundary, (lowerBoundary - upperBoundary + 1), color);
+        number_of_spans = 0;
+        GUI_AddSpan(pixel_map, spans, &number_of_spans, upperBoundary, leftBoundary, rightBoundary, color);
+        for (i = upperBoundary + 1; i < lowerBoundary; ++i)
+        {
+            GUI_AddSpan(pixel_map, spans, &number_of_spans, i, leftBoundary, leftBoundary, color);
+            GUI_AddSpan(pixel_map, spans, &number_of_spans, i, rightBoundary, rightBoundary, color);
+        }
+        if (lowerBoundary > upperBoundary)
+        {
+            GUI_AddSpan(pixel_map, spans, &number_of_spans, lowerBoundary, leftBoundary, rightBoundary, color);
+        }
+        GUI_FillSpans(pixel_map, spans, number_of_spans);
     }
 }
 
 void GUI_DrawEmbossedArea(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigned char shadowColor, unsigned char fillColor, unsigned char highlightColor)
 {
+    OPM_SpanStruct spans[GUI_MAX_SPANS];
+    int number_of_spans;
     int i;
 
     if (width > x && height > y)
     {
-        for (i = y; i <= height; ++i)
+        /* The shadow runs along the top and left edges, the highlight along the bottom and right edges. The top right
+           and bottom left corners keep the fill color. */
+        number_of_spans = 0;
+        GUI_AddSpan(pixel_map, spans, &number_of_spans, y, x, width - 1, shadowColor);
+        GUI_AddSpan(pixel_map, spans, &number_of_spans, y, width, width, fillColor);
+        for (i = y + 1; i < height; ++i)
+        {
+            GUI_AddSpan(pixel_map, spans, &number_of_spans, i, x, x, shadowColor);
+            GUI_AddSpan(pixel_map, spans, &number_of_spans, i, x + 1, width - 1, fillColor);
+            GUI_AddSpan(pixel_map, spans, &number_of_spans, i, width, width, highlightColor);
+        }
+        GUI_AddSpan(pixel_map, spans, &number_of_spans, height, x, x, fillColor);
+        GUI_AddSpan(pixel_map, spans, &number_of_spans, height, x + 1, width, highlightColor);
+        GUI_FillSpans(pixel_map, spans, number_of_spans);
+    }
+}
+
+/* Draw only the outer 'thickness' rows and columns of GUI_DrawEmbossedArea; the area has to be larger than twice that. */
+static void GUI_DrawEmbossedRing(OPM_Struct *pixel_map, int x, int y, int width, int height, int thickness, unsigned char shadowColor, unsigned char fillColor, unsigned char highlightColor)
+{
+    OPM_SpanStruct spans[GUI_MAX_SPANS];
+    int number_of_spans;
+    int i;
+
+    number_of_spans = 0;
+    GUI_AddSpan(pixel_map, spans, &number_of_spans, y, x, width - 1, shadowColor);
+    GUI_AddSpan(pixel_map, spans, &number_of_spans, y, width, width, fillColor);
+    for (i = y + 1; i < height; ++i)
+    {
+        GUI_AddSpan(pixel_map, spans, &number_of_spans, i, x, x, shadowColor);
+        if (i < y + thickness || i > height - thickness)
         {
-            OPM_HorLine(pixel_map, x, i, (width - x + 1), fillColor);
+            GUI_AddSpan(pixel_map, spans, &number_of_spans, i, x + 1, width - 1, fillColor);
         }
-        OPM_HorLine(pixel_map, x, y, (width - x), shadowColor);
-        OPM_VerLine(pixel_map, x, y, (height - y), shadowColor);
-        OPM_HorLine(pixel_map, (x + 1), height, (width - x), highlightColor);
-        OPM_VerLine(pixel_map, width, (y + 1), (height - y), highlightColor);
+        else if (thickness > 1)
+        {
+            GUI_AddSpan(pixel_map, spans, &number_of_spans, i, x + 1, x + thickness - 1, fillColor);
+            GUI_AddSpan(pixel_map, spans, &number_of_spans, i, width - thickness + 1, width - 1, fillColor);
+        }
+        GUI_AddSpan(pixel_map, spans, &number_of_spans, i, width, width, highlightColor);
     }
+    GUI_AddSpan(pixel_map, spans, &number_of_spans, height, x, x, fillColor);
+    GUI_AddSpan(pixel_map, spans, &number_of_spans, height, x + 1, width, highlightColor);
+    GUI_FillSpans(pixel_map, spans, number_of_spans);
 }
 
 void GUI_DrawFilledBackground(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigned char color0, unsigned char color1, unsigned char color2, unsigned char color3)
 {
-    if (width > x && height > y)
+    if (width - 4 > x + 4 && height - 4 > y + 4)
+    {
+        /* Each of the three areas covers all but the border of the one before, so only the borders that stay visible
+           are drawn and the inside, which is all color3, is filled once. */
+        GUI_DrawEmbossedRing(pixel_map, x, y, width, height, 3, color0, color1, color2);
+        GUI_DrawEmbossedRing(pixel_map, x + 3, y + 3, width - 3, height - 3, 1, color2, color1, color0);
+        GUI_FillBox(pixel_map, x + 4, y + 4, width - x - 7, height - y - 7, color3);
+    }
+    else if (width > x && height > y)
     {
         GUI_DrawEmbossedArea(pixel_map, x, y, width, height, color0, color1, color2);
         GUI_DrawEmbossedArea(pixel_map, x + 3, y + 3, width - 3, height - 3, color2, color1, color0);
@@ -385,20 +1049,13 @@ void GUI_DrawButton(OPM_Struct *pixel_map, int leftBndry, int upperBndry, int ri
 void GUI_DrawDropShadow(OPM_Struct *pixel_map, int leftBndry, int upperBndry, int rightBndry, int lowerBndry)
 {
     int x;
-    int y;
 
     if (rightBndry > leftBndry && lowerBndry > upperBndry)
     {
-        for (y = upperBndry; y <= lowerBndry; ++y)
-        {
-            for (x = leftBndry; x <= rightBndry; ++x)
-            {
-                if ((y + 3 > lowerBndry || x + 3 > rightBndry) && x + 3 < GUI_OpmWidth && y + 3 < GUI_OpmHeight)
-                {
-                    OPM_SetPixel(pixel_map, (x + 3), (y + 3), 0);
-                }
-            }
-        }
+        /* The area moved 3 pixels right and down, except for the part the area itself covers, darkens what is under it */
+        x = rightBndry + 1 < leftBndry + 3 ? leftBndry + 3 : rightBndry + 1;
+        GUI_RemapBox(pixel_map, x, upperBndry + 3, rightBndry + 4 - x, lowerBndry - upperBndry - 2, GUI_SHADOW_LEVEL);
+        GUI_RemapBox(pixel_map, leftBndry + 3, lowerBndry + 1, rightBndry - leftBndry + 1, 3, GUI_SHADOW_LEVEL);
     }
 }
 
@@ -543,115 +1200,214 @@ int GUI_GetTextLength(char *string)
     return text_length;
 }
 
+/* Append a run to 'layout'; a layout without runs is only measured. */
+static void GUI_AddTextRun(GUI_TextLayoutStruct *layout, int type, unsigned int offset, unsigned int length, int x, int y)
+{
+    GUI_TextRunStruct *run;
+
+    if (!layout->runs)
+    {
+        return;
+    }
+
+    run = &layout->runs[layout->number_of_runs++];
+    run->type = type;
+    run->offset = offset;
+    run->length = length;
+    run->x = x;
+    run->y = y;
+}
+
+/* Break 'layout->string' into lines of at most 'layout->width' pixels. Words are separated by ' ', '~' and '\n' and
+   measured once while they are scanned. A word that does not fit on the current line starts a new one; if it follows
+   a '~' the line ends with a hyphen, otherwise the words of a line are separated by a space. Layout stops as soon as
+   a word is wider than the box or the text is higher than the box. */
+static void GUI_BuildTextLayout(GUI_TextLayoutStruct *layout)
+{
+    const char *string;
+    unsigned int i;
+    unsigned int word_start;
+    int word_width;
+    int current_x;
+    int y;
+    int is_hyphen;
+    int was_hyphen;
+    char c;
+
+    string = layout->string;
+    layout->number_of_runs = 0;
+    layout->is_complete = 0;
+
+    current_x = 0;
+    y = 0;
+    is_hyphen = 0;
+    word_start = 0;
+    word_width = 0;
+
+    for (i = 0; i <= layout->string_length; i++)
+    {
+        c = string[i];
+        if (c != ' ' && c != '~' && c && c != '\n')
+        {
+            word_width += GUI_AdvanceTextCursor(c);
+            continue;
+        }
+
+        was_hyphen = is_hyphen;
+        is_hyphen = c == '~';
+        if (word_width + GUI_AdvanceTextCursor('-') * is_hyphen > layout->width - 1)
+        {
+            return;
+        }
+
+        if (word_width + GUI_AdvanceTextCursor('-') * (current_x && !was_hyphen) > layout->width - current_x - 1)
+        {
+            if (was_hyphen)
+            {
+                GUI_AddTextRun(layout, GUI_TEXT_RUN_HYPHEN, 0, 0, current_x, y);
+            }
+            y += 8;
+            current_x = 0;
+            if (layout->height - 8 <= y)
+            {
+                return;
+            }
+        }
+
+        if (current_x && !was_hyphen)
+        {
+            GUI_AddTextRun(layout, GUI_TEXT_RUN_SPACE, 0, 0, current_x, y);
+            current_x += GUI_AdvanceTextCursor(' ');
+        }
+
+        GUI_AddTextRun(layout, GUI_TEXT_RUN_WORD, word_start, i - word_start, current_x, y);
+        current_x += word_width;
+        if (c == '\n')
+        {
+            y += 8;
+            current_x = 0;
+            if (layout->height - 8 <= y)
+            {
+                return;
+            }
+        }
+
+        word_start = i + 1;
+        word_width = 0;
+    }
+
+    layout->is_complete = 1;
+}
+
+/* Layout of 'string' in a text box of 'width' x 'height' pixels. The last GUI_TEXT_LAYOUT_CACHE_SIZE layouts are
+   kept, so redrawing a text only costs one pass over it to find its layout again. Returns 0 if out of memory. */
+const GUI_TextLayoutStruct *GUI_LayoutText(const char *string, int width, int height)
+{
+    GUI_TextLayoutStruct *layout;
+    const char *ptr;
+    unsigned int hash;
+    unsigned int string_length;
+    unsigned int number_of_words;
+    int i;
+
+    hash = 2166136261u;
+    number_of_words = 1;
+    for (ptr = string; *ptr; ptr++)
+    {
+        hash = (hash ^ (unsigned char)*ptr) * 16777619u;
+        if (*ptr == ' ' || *ptr == '~' || *ptr == '\n')
+        {
+            number_of_words++;
+        }
+    }
+    string_length = ptr - string;
+
+    for (i = 0; i < GUI_TEXT_LAYOUT_CACHE_SIZE; i++)
+    {
+        layout = &GUI_TextLayoutCache[i];
+        if (layout->string && layout->hash == hash && layout->string_length == string_length
+            && layout->width == width && layout->height == height && !memcmp(layout->string, string, string_length))
+        {
+            return layout;
+        }
+    }
+
+    /* Replace the oldest layout; every word adds at most a hyphen, a space and itself. */
+    layout = &GUI_TextLayoutCache[GUI_NextTextLayout];
+    GUI_NextTextLayout = (GUI_NextTextLayout + 1) % GUI_TEXT_LAYOUT_CACHE_SIZE;
+
+    if (layout->runs)
+    {
+        free(layout->runs);
+    }
+    memset(layout, 0, sizeof(GUI_TextLayoutStruct));
+
+    layout->runs = (GUI_TextRunStruct *)malloc(3 * number_of_words * sizeof(GUI_TextRunStruct) + string_length + 1);
+    if (!layout->runs)
+    {
+        return 0;
+    }
+    layout->string = (char *)&layout->runs[3 * number_of_words];
+    memcpy(layout->string, string, string_length + 1);
+    layout->string_length = string_length;
+    layout->hash = hash;
+    layout->width = width;
+    layout->height = height;
+
+    GUI_BuildTextLayout(layout);
+
+    return layout;
+}
+
 bool GUI_PrintText(char *string, int color, OPM_Struct *pixel_map, int x, int y, int max_x, int max_y)
 {
-    int v8;
-    int v10;
-    int string_pixel_length;
+    const GUI_TextLayoutStruct *layout;
+    const GUI_TextRunStruct *run;
     char string_buffer[256];
-    bool v20;
+    unsigned int length;
+    unsigned int j;
     int current_x;
     int i;
-    int j;
-    unsigned int string_length;
-    bool v26;
-    bool v27;
-    
+
     if (x < max_x && y + 8 < max_y)
     {
-        current_x = x; /* Set current x coordinate to passed value for x */
-        string_length = strlen(string);
-        string_buffer[0] = 0;
-        v26 = 0;
-        v27 = 0;
-        for (i = 0;; ++i)
+        layout = GUI_LayoutText(string, max_x - x, max_y - y);
+        if (!layout)
         {
-            if ((string_length + 1) <= i)
+            return 0;
+        }
+
+        for (i = 0; i < layout->number_of_runs; i++)
+        {
+            run = &layout->runs[i];
+            if (run->type == GUI_TEXT_RUN_HYPHEN)
             {
-                return 1;
+                GUI_DrawString(pixel_map, "-", x + run->x, y + run->y, color);
+                continue;
             }
-            
-            if (string[i] == ' ' || string[i] == '~' || !string[i] || string[i] == '\n')
+            if (run->type == GUI_TEXT_RUN_SPACE)
             {
-                /* Perform hyphenation at ~ symbol, if necessary */
-                /* TODO */
-                v27 = v26;
-                if (string[i] == '~')
-                {
-                    v26 = 1;
-                }
-                else
-                {
-                    v26 = 0;
-                }
-                v8 = GUI_AdvanceTextCursor('-') * v26;
-                string_pixel_length = GUI_GetTextLength(string_buffer);
-                if (string_pixel_length + v8 > max_x - x - 1)
-                {
-                    return 0;
-                }
-                
-                if (current_x != x && !v27)
-                {
-                    v20 = 1;
-                }
-                else
-                {
-                    v20 = 0;
-                }
-                v10 = GUI_AdvanceTextCursor('-') * v20;
-                string_pixel_length = GUI_GetTextLength(string_buffer);
-                if (string_pixel_length + v10 > max_x - current_x - 1)
-                {
-                    if (v27)
-                    {
-                        OPM_DrawString(pixel_map, "-", current_x, y, color);
-                    }
-                    /* Shift to next line */
-                    y += 8;
-                    current_x = x;
-                    if (max_y - 8 <= y)
-                    {
-                        return 0;
-                    }
-                }
-                
-                /* Print Space */
-                if (current_x != x && !v27)
-                {
-                    OPM_DrawString(pixel_map, " ", current_x, y, color);
-                    current_x += GUI_AdvanceTextCursor(' ');
-                }
-                
-                /* Replace _ with Space */
-                for (j = 0; j <= strlen(string_buffer); ++j)
+                GUI_DrawString(pixel_map, " ", x + run->x, y + run->y, color);
+                continue;
+            }
+
+            /* Replace _ with Space; long words are drawn in pieces */
+            current_x = x + run->x;
+            length = 0;
+            do
+            {
+                for (j = 0; j < sizeof(string_buffer) - 1 && length < run->length; j++, length++)
                 {
-                    if (string_buffer[j] == '_')
-                    {
-                        string_buffer[j] = ' ';
-                    }
+                    string_buffer[j] = layout->string[run->offset + length] == '_' ? ' ' : layout->string[run->offset + length];
                 }
-                
-                OPM_DrawString(pixel_map, string_buffer, current_x, y, color);
+                string_buffer[j] = 0;
+                GUI_DrawString(pixel_map, string_buffer, current_x, y + run->y, color);
                 current_x += GUI_GetTextLength(string_buffer);
-                if (string[i] == '\n')
-                {
-                    /* Shift to next line */
-                    y += 8;
-                    current_x = x;
-                    if (max_y - 8 <= y)
-                    {
-                        return 0;
-                    }
-                }
-                string_buffer[0] = 0;
-            }
-            else
-            {
-                string_buffer[strlen(string_buffer) + 1] = 0;
-                string_buffer[strlen(string_buffer)] = string[i];
             }
+            while (length < run->length);
         }
+
+        return layout->is_complete;
     }
     return 0;
 }
@@ -664,18 +1420,191 @@ bool GUI_PrintButtonText(char *string, int color, OPM_Struct *pixel_map, int x,
     return GUI_PrintText(string, color, pixel_map, (max_x + x) / 2 - button_text_length / 2, y, max_x, max_y);
 }
 
+/* Return what GUI_PrintText would return, without drawing anything or adding a layout to the cache. */
+static bool GUI_MeasureText(char *string, int x, int y, int max_x, int max_y)
+{
+    GUI_TextLayoutStruct layout;
+
+    if (x < max_x && y + 8 < max_y)
+    {
+        memset(&layout, 0, sizeof(layout));
+        layout.string = string;
+        layout.string_length = strlen(string);
+        layout.width = max_x - x;
+        layout.height = max_y - y;
+        GUI_BuildTextLayout(&layout);
+        return layout.is_complete;
+    }
+    return 0;
+}
+
+static bool GUI_MeasureButtonText(char *string, int x, int y, int max_x, int max_y)
+{
+    return GUI_MeasureText(string, (max_x + x) / 2 - GUI_GetTextLength(string) / 2, y, max_x, max_y);
+}
+
+/* The growing dialogs below look for the smallest step 'i' at which all their texts fit. These functions tell whether
+   step 'i' of a dialog fits, so a dialog can be drawn once at that step instead of once for every step before it. */
+static bool GUI_AssertBoxFits(char *string, int i)
+{
+    return GUI_MeasureButtonText((char *)GUI_StringData[SETUP_Language][43], GUI_ScreenWidth / 2 - 16 * i / 10 + 6, GUI_ScreenHeight / 2 - i + 5, 16 * i / 10 + GUI_ScreenWidth / 2 - 6, GUI_ScreenHeight / 2 - i + 15)
+        && GUI_MeasureText(string, GUI_ScreenWidth / 2 - 16 * i / 10 + 7, GUI_ScreenHeight / 2 - i + 17, 16 * i / 10 + GUI_ScreenWidth / 2 - 7, i + GUI_ScreenHeight / 2 - 36)
+        && GUI_MeasureButtonText((char *)GUI_StringData[SETUP_Language][34], GUI_ScreenWidth / 2 - i + 6, i + GUI_ScreenHeight / 2 - 22, GUI_ScreenWidth / 2 - 2, i + GUI_ScreenHeight / 2 - 12)
+        && GUI_MeasureButtonText((char *)GUI_StringData[SETUP_Language][35], GUI_ScreenWidth / 2 + 2, i + GUI_ScreenHeight / 2 - 22, i + GUI_ScreenWidth / 2 - 6, i + GUI_ScreenHeight / 2 - 12);
+}
+
+static bool GUI_TextBoxFits(char *string, int i)
+{
+    return GUI_MeasureText(string, GUI_ScreenWidth / 2 - 16 * i / 10 + 5, GUI_ScreenHeight / 3 - i + 5, 16 * i / 10 + GUI_ScreenWidth / 2 - 5, i + GUI_ScreenHeight / 3 - 4);
+}
+
+static bool GUI_MessageBoxFits(char *text, char *heading, char *button, int i)
+{
+    return GUI_MeasureButtonText(heading, GUI_ScreenWidth / 2 - 16 * i / 10 + 6, GUI_ScreenHeight / 2 - i + 5, 16 * i / 10 + GUI_ScreenWidth / 2 - 6, GUI_ScreenHeight / 2 - i + 15)
+        && GUI_MeasureText(text, GUI_ScreenWidth / 2 - 16 * i / 10 + 7, GUI_ScreenHeight / 2 - i + 17, 16 * i / 10 + GUI_ScreenWidth / 2 - 7, i + (signed int)GUI_ScreenHeight / 2 - 36)
+        && GUI_MeasureButtonText(button, GUI_ScreenWidth / 2 - i + 6, i + GUI_ScreenHeight / 2 - 22, i + GUI_ScreenWidth / 2 - 6, i + GUI_ScreenHeight / 2 - 12);
+}
+
+static void GUI_LocalPrintError(char *buffer, const char *data)
+{
+#define DATA (((GUI_ErrorStruct *)data))
+    sprintf(buffer, "ERROR!: %s  %ld, %ld", DATA->text, (long int)DATA->data1, (long int)DATA->data2);
+#undef DATA
+}
+
+/* Save the screen area from (x0, y0) to (x1, y1), both inclusive, before a dialog is drawn over it. All save-unders
+   share one pool that only grows, so opening a dialog does not allocate a screen sized backup. Returns the handle to
+   pass to GUI_RestoreUnder and GUI_DropSaveUnder, or -1 if all save-unders are in use or the pool cannot grow. */
+int GUI_SaveUnder(int x0, int y0, int x1, int y1)
+{
+    GUI_SaveUnderStruct *save_under;
+    GUI_ErrorStruct data;
+    OPM_Struct pixel_map;
+    unsigned char *pool;
+    unsigned int size;
+    unsigned int top;
+    int handle;
+    int i;
+
+    /* The free part of the pool starts behind the last save-under in use */
+    handle = -1;
+    top = 0;
+    for (i = 0; i < GUI_MAX_SAVE_UNDERS; i++)
+    {
+        save_under = &GUI_SaveUnders[i];
+        if (!save_under->in_use)
+        {
+            if (handle < 0)
+            {
+                handle = i;
+            }
+        }
+        else if (save_under->offset + save_under->width * save_under->height * GUI_ScreenOpm.bytes_per_pixel > top)
+        {
+            top = save_under->offset + save_under->width * save_under->height * GUI_ScreenOpm.bytes_per_pixel;
+        }
+    }
+    if (handle < 0)
+    {
+        return -1;
+    }
+
+    if (x0 < 0)
+    {
+        x0 = 0;
+    }
+    if (y0 < 0)
+    {
+        y0 = 0;
+    }
+    if (x1 >= GUI_ScreenOpm.width)
+    {
+        x1 = GUI_ScreenOpm.width - 1;
+    }
+    if (y1 >= GUI_ScreenOpm.height)
+    {
+        y1 = GUI_ScreenOpm.height - 1;
+    }
+
+    save_under = &GUI_SaveUnders[handle];
+    save_under->in_use = 1;
+    save_under->x = x0;
+    save_under->y = y0;
+    save_under->width = 0;
+    save_under->height = 0;
+    save_under->offset = top;
+    if (x1 < x0 || y1 < y0)
+    {
+        return handle;
+    }
+
+    size = top + (x1 - x0 + 1) * (y1 - y0 + 1) * GUI_ScreenOpm.bytes_per_pixel;
+    if (size > GUI_SaveUnderPoolSize)
+    {
+        pool = (unsigned char *)realloc(GUI_SaveUnderPool, size);
+        if (pool == NULL)
+        {
+            save_under->in_use = 0;
+
+            data.text = "GUI_SaveUnder: Cannot Allocate Mem for SaveUnder width,height";
+            data.data1 = x1 - x0 + 1;
+            data.data2 = y1 - y0 + 1;
+            ERROR_PushError(GUI_LocalPrintError, "BBGUI Library", sizeof(data), (const char *) &data);
+
+            return -1;
+        }
+        GUI_SaveUnderPool = pool;
+        GUI_SaveUnderPoolSize = size;
+    }
+    save_under->width = x1 - x0 + 1;
+    save_under->height = y1 - y0 + 1;
+
+    OPM_New(save_under->width, save_under->height, GUI_ScreenOpm.bytes_per_pixel, &pixel_map, GUI_SaveUnderPool + top);
+    OPM_CopyOPMOPM(&GUI_ScreenOpm, &pixel_map, x0, y0, save_under->width, save_under->height, 0, 0);
+    OPM_Del(&pixel_map);
+    return handle;
+}
+
+/* Copy an area saved by GUI_SaveUnder back to the screen. It stays saved until GUI_DropSaveUnder. */
+void GUI_RestoreUnder(int handle)
+{
+    GUI_SaveUnderStruct *save_under;
+    OPM_Struct pixel_map;
+
+    if (handle < 0 || handle >= GUI_MAX_SAVE_UNDERS || !GUI_SaveUnders[handle].in_use || !GUI_SaveUnders[handle].width)
+    {
+        return;
+    }
+    save_under = &GUI_SaveUnders[handle];
+    OPM_New(save_under->width, save_under->height, GUI_ScreenOpm.bytes_per_pixel, &pixel_map, GUI_SaveUnderPool + save_under->offset);
+    OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, save_under->width, save_under->height, save_under->x, save_under->y);
+    OPM_Del(&pixel_map);
+}
+
+void GUI_DropSaveUnder(int handle)
+{
+    if (handle >= 0 && handle < GUI_MAX_SAVE_UNDERS)
+    {
+        GUI_SaveUnders[handle].in_use = 0;
+    }
+}
+
 int GUI_DrawAssertBox(char *string)
 {
     int src_width_loc;
     int retVal;
-    OPM_Struct pixel_map;
+    int save_under;
     int i;
     
     GUI_DrawTextBox(0);
-    OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &pixel_map, 0);
-    OPM_CopyOPMOPM(&GUI_ScreenOpm, &pixel_map, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    
-    for (i = 10; (signed int)GUI_ScreenHeight / 2 > i; ++i)
+    /* Measure first: start at the smallest box that fits, or at the largest one if none does */
+    i = 10;
+    while ((signed int)GUI_ScreenHeight / 2 > i + 1 && !GUI_AssertBoxFits(string, i))
+    {
+        ++i;
+    }
+    save_under = GUI_SaveUnder(GUI_ScreenWidth / 2 - 16 * i / 10, GUI_ScreenHeight / 2 - i, GUI_ScreenWidth / 2 + 16 * i / 10 + 3, i + GUI_ScreenHeight / 2 + 3);
+    for (; (signed int)GUI_ScreenHeight / 2 > i; ++i)
     {
         GUI_DrawFilledBackground(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 16 * i / 10, GUI_ScreenHeight / 2 - i, GUI_ScreenWidth / 2 + 16 * i / 10, i + GUI_ScreenHeight / 2, 0xF9, 0xF8u, 0xF7, 0xF8);
         GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 16 * i / 10 + 4, GUI_ScreenHeight / 2 - i + 4, 16 * i / 10 + GUI_ScreenWidth / 2 - 4, GUI_ScreenHeight / 2 - i + 13, 0xF6u, 0xF6u, 0xF6u);
@@ -703,13 +1632,13 @@ int GUI_DrawAssertBox(char *string)
         GUI_ErrorHandler(1026);
     }
     GUI_DrawDropShadow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 16 * i / 10, GUI_ScreenHeight / 2 - i, GUI_ScreenWidth / 2 + 16 * i / 10, i + GUI_ScreenHeight / 2);
-    DSA_CopyMainOPMToScreen(1);
+    DSA_CopyMainOPMToScreen(0);
     retVal = GUI_DrawHorizontalMenu(2, 0,
                                     GUI_ScreenWidth / 2 - i + 5, i + GUI_ScreenHeight / 2 - 25, GUI_ScreenWidth / 2 - 2, i + GUI_ScreenHeight / 2 - 12, "Jjyy",
                                     GUI_ScreenWidth / 2 + 2, i + GUI_ScreenHeight / 2 - 25, i + GUI_ScreenWidth / 2 - 5, i + GUI_ScreenHeight / 2 - 12, "Nn");
-    OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    OPM_Del(&pixel_map);
-    DSA_CopyMainOPMToScreen(1);
+    GUI_RestoreUnder(save_under);
+    GUI_DropSaveUnder(save_under);
+    DSA_CopyMainOPMToScreen(0);
     
     return (retVal == 0);
 }
@@ -717,11 +1646,16 @@ int GUI_DrawAssertBox(char *string)
 int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
 {
     /* TODO Refactor decompiled code */
-    OPM_Struct pixel_map;
+    int save_under;
     int i;
     int j;
     unsigned int character;
     
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    
     int v22;
     int v23;
     
@@ -737,8 +1671,31 @@ int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
         return 0;
     }
     
-    OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &pixel_map, 0);
-    OPM_CopyOPMOPM(&GUI_ScreenOpm, &pixel_map, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
+    /* Only the selection frames around the entries are drawn here, so save just the area the entries cover */
+    x0 = menu->entry[0].x;
+    y0 = menu->entry[0].y;
+    x1 = menu->entry[0].max_x;
+    y1 = menu->entry[0].max_y;
+    for (i = 1; i < menu->index; ++i)
+    {
+        if (menu->entry[i].x < x0)
+        {
+            x0 = menu->entry[i].x;
+        }
+        if (menu->entry[i].y < y0)
+        {
+            y0 = menu->entry[i].y;
+        }
+        if (menu->entry[i].max_x > x1)
+        {
+            x1 = menu->entry[i].max_x;
+        }
+        if (menu->entry[i].max_y > y1)
+        {
+            y1 = menu->entry[i].max_y;
+        }
+    }
+    save_under = GUI_SaveUnder(x0 - 2, y0 - 2, x1 + 2, y1 + 2);
     
     while (1)
     {
@@ -751,7 +1708,7 @@ int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
         {
             OPM_Box(&GUI_ScreenOpm, menu->entry[idx].x - 1, menu->entry[idx].y - 1, menu->entry[idx].max_x - menu->entry[idx].x + 3, menu->entry[idx].max_y - menu->entry[idx].y + 3, 0xF9u);
             OPM_Box(&GUI_ScreenOpm, menu->entry[idx].x - 2, menu->entry[idx].y - 2, menu->entry[idx].max_x - menu->entry[idx].x + 5, menu->entry[idx].max_y - menu->entry[idx].y + 5, 0xF9u);
-            DSA_CopyMainOPMToScreen(1);
+            DSA_CopyMainOPMToScreen(0);
             v22 = 0;
         }
         
@@ -766,9 +1723,8 @@ int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
         }
         else
         {
-            OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-            OPM_Del(&pixel_map);
-            DSA_CopyMainOPMToScreen(1);
+            GUI_RestoreUnder(save_under);
+            DSA_CopyMainOPMToScreen(0);
         }
         
         if (GUI_EventFlags & 1)
@@ -785,9 +1741,9 @@ int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
     {
         if (character >= '\r' && (character <= '\r' || character == ' '))
         {
-            OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-            OPM_Del(&pixel_map);
-            DSA_CopyMainOPMToScreen(1);
+            GUI_RestoreUnder(save_under);
+            GUI_DropSaveUnder(save_under);
+            DSA_CopyMainOPMToScreen(0);
             return idx;
         }
     }
@@ -805,14 +1761,14 @@ int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
             }
         LABEL_35:
             v22 = 1;
-            OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
+            GUI_RestoreUnder(save_under);
             idx = (menu->index + idx - 1) % menu->index;
             goto LABEL_38;
         }
         if (character <= 1077 || character == 1080) /* right arrow and down arrow */
         {
             v22 = 1;
-            OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
+            GUI_RestoreUnder(save_under);
             idx = (idx + 1) % menu->index;
         }
     }
@@ -835,7 +1791,7 @@ int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
         if (idx != i && !(GUI_EventFlags & 1) && i < menu->index && (GUI_MouseEvent_CurrX != curr_mouse_x || GUI_MouseEvent_CurrY != curr_mouse_y))
         {
             idx = i;
-            OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
+            GUI_RestoreUnder(save_under);
             v22 = 1;
         }
         
@@ -846,14 +1802,14 @@ int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
                 if (idx != i && v23 == 1)
                 {
                     GUI_DrawBox(&GUI_ScreenOpm, menu->entry[idx].x, menu->entry[idx].y, menu->entry[idx].max_x, menu->entry[idx].max_y);
-                    DSA_CopyMainOPMToScreen(1);
+                    DSA_CopyMainOPMToScreen(0);
                     v23 = 0;
                 }
             }
             else
             {
                 GUI_DrawLoweredButton(&GUI_ScreenOpm, menu->entry[i].x, menu->entry[i].y, menu->entry[i].max_x, menu->entry[i].max_y);
-                DSA_CopyMainOPMToScreen(1);
+                DSA_CopyMainOPMToScreen(0);
                 v23 = 1;
             }
         }
@@ -861,22 +1817,22 @@ int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
         if (GUI_EventFlags & 1 && !(GUI_EventFlagsOld & 1) && idx == i && !v23)
         {
             GUI_DrawLoweredButton(&GUI_ScreenOpm, menu->entry[i].x, menu->entry[i].y, menu->entry[i].max_x, menu->entry[i].max_y);
-            DSA_CopyMainOPMToScreen(1);
+            DSA_CopyMainOPMToScreen(0);
             v23 = 1;
         }
         
         if (!(GUI_EventFlags & 1) && GUI_EventFlagsOld & 1 && idx == i && v23)
         {
-            OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-            OPM_Del(&pixel_map);
-            DSA_CopyMainOPMToScreen(1);
+            GUI_RestoreUnder(save_under);
+            GUI_DropSaveUnder(save_under);
+            DSA_CopyMainOPMToScreen(0);
             return i;
         }
         
         if (!(GUI_EventFlags & 1) && GUI_EventFlagsOld & 1 && idx != i && !v23 && i < menu->index)
         {
             idx = i;
-            OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
+            GUI_RestoreUnder(save_under);
             v22 = 1;
         }
     }
@@ -898,9 +1854,9 @@ int GUI_MenuLoop(SETUP_MenuStruct *menu, int idx)
         }
     }
     
-    OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    OPM_Del(&pixel_map);
-    DSA_CopyMainOPMToScreen(1);
+    GUI_RestoreUnder(save_under);
+    GUI_DropSaveUnder(save_under);
+    DSA_CopyMainOPMToScreen(0);
     return i;
 }
 
@@ -946,7 +1902,7 @@ void GUI_ProcessEvents()
 
 int GUI_DrawMenu(SETUP_MenuStruct *menu)
 {
-    OPM_Struct pixel_map;
+    int save_under;
     int x;
     int y;
     int i;
@@ -956,8 +1912,6 @@ int GUI_DrawMenu(SETUP_MenuStruct *menu)
     
     menu_loc.index = 0;
     GUI_DrawTextBox(0);
-    OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &pixel_map, 0);
-    OPM_CopyOPMOPM(&GUI_ScreenOpm, &pixel_map, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
     x = 0;
     y = 40;
     
@@ -986,6 +1940,7 @@ int GUI_DrawMenu(SETUP_MenuStruct *menu)
         }
     }
     
+    save_under = GUI_SaveUnder(GUI_ScreenWidth / 2 - x / 2, GUI_ScreenHeight / 2 - y / 2, GUI_ScreenWidth / 2 - x / 2 + x + 3, y + GUI_ScreenHeight / 2 - y / 2 + 3);
     GUI_DrawFilledBackground(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - x / 2, GUI_ScreenHeight / 2 - y / 2, GUI_ScreenWidth / 2 - x / 2 + x, y + GUI_ScreenHeight / 2 - y / 2, 0xF9, 0xF8u, 0xF7, 0xF8);
     GUI_DrawDropShadow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - x / 2, GUI_ScreenHeight / 2 - y / 2, GUI_ScreenWidth / 2 - x / 2 + x, y + GUI_ScreenHeight / 2 - y / 2);
     GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - x / 2 + 4, GUI_ScreenHeight / 2 - y / 2 + 4, GUI_ScreenWidth / 2 - x / 2 + x - 4, GUI_ScreenHeight / 2 - y / 2 + 15, 0xF6u, 0xF6u, 0xF6u);
@@ -1029,13 +1984,13 @@ int GUI_DrawMenu(SETUP_MenuStruct *menu)
         }
     }
     
-    DSA_CopyMainOPMToScreen(1);
+    DSA_CopyMainOPMToScreen(0);
     
     i = GUI_MenuLoop(&menu_loc, 0);
     
-    OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    OPM_Del(&pixel_map);
-    DSA_CopyMainOPMToScreen(1);
+    GUI_RestoreUnder(save_under);
+    GUI_DropSaveUnder(save_under);
+    DSA_CopyMainOPMToScreen(0);
     
     return menu_loc.entry[i].anchor_point;
 }
@@ -1051,9 +2006,14 @@ void GUI_DrawTextBox(char *string)
             GUI_DrawTextBox(0);
         }
         GUI_TextBoxFlag = 1;
-        OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &GUI_TextBoxPixelMap, 0);
-        OPM_CopyOPMOPM(&GUI_ScreenOpm, &GUI_TextBoxPixelMap, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-        for (i = 5; GUI_ScreenHeight / 2 > i; ++i)
+        /* Measure first: start at the smallest box that fits, or at the largest one if none does */
+        i = 5;
+        while (GUI_ScreenHeight / 2 > i + 1 && !GUI_TextBoxFits(string, i))
+        {
+            ++i;
+        }
+        GUI_TextBoxSaveUnder = GUI_SaveUnder(GUI_ScreenWidth / 2 - 16 * i / 5, GUI_ScreenHeight / 3 - i, GUI_ScreenWidth / 2 + 16 * i / 5, i + GUI_ScreenHeight / 3);
+        for (; GUI_ScreenHeight / 2 > i; ++i)
         {
             GUI_DrawFilledBackground(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 16 * i / 5, GUI_ScreenHeight / 3 - i, GUI_ScreenWidth / 2 + 16 * i / 5, i + GUI_ScreenHeight / 3, 0xF9, 0xF8u, 0xF7, 0xF8);
             if (GUI_PrintText(string, 0, &GUI_ScreenOpm, GUI_ScreenWidth / 2 - 16 * i / 10 + 5, GUI_ScreenHeight / 3 - i + 5, 16 * i / 10 + GUI_ScreenWidth / 2 - 5, i + GUI_ScreenHeight / 3 - 4))
@@ -1061,7 +2021,7 @@ void GUI_DrawTextBox(char *string)
                 break;
             }
         }
-        DSA_CopyMainOPMToScreen(1);
+        DSA_CopyMainOPMToScreen(0);
         
         if (GUI_ScreenHeight / 2 <= i)
         {
@@ -1071,22 +2031,23 @@ void GUI_DrawTextBox(char *string)
     else if (GUI_TextBoxFlag)
     {
         GUI_TextBoxFlag = 0;
-        OPM_CopyOPMOPM(&GUI_TextBoxPixelMap, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-        OPM_Del(&GUI_TextBoxPixelMap);
-        DSA_CopyMainOPMToScreen(1);
+        GUI_RestoreUnder(GUI_TextBoxSaveUnder);
+        GUI_DropSaveUnder(GUI_TextBoxSaveUnder);
+        GUI_TextBoxSaveUnder = -1;
+        DSA_CopyMainOPMToScreen(0);
     }
 }
 
 void GUI_ParseReadmeText(SETUP_ScriptDataStruct *text_data, char *filename)
 {
     int line_length;
-    unsigned int *line_ptr;
+    uintptr_t *line_ptr;
     int i;
     int j;
     int file_handle;
     int file_length;
     
-    file_handle = open(filename, 0x200);
+    file_handle = open(filename, O_RDONLY | O_BINARY);
     if (file_handle <= 0)
     {
         GUI_ErrorHandler(1029, (char *)&filename);
@@ -1114,15 +2075,15 @@ void GUI_ParseReadmeText(SETUP_ScriptDataStruct *text_data, char *filename)
         }
     }
     
-    text_data->PtrScriptLine = (unsigned int *)malloc(4 * (text_data->NumberOfLines + 1));
+    text_data->PtrScriptLine = (uintptr_t *)malloc(sizeof(uintptr_t) * (text_data->NumberOfLines + 1));
     text_data->NumberOfLines = 0;
-    text_data->PtrScriptLine[text_data->NumberOfLines++] = (unsigned int)text_data->PtrScriptBuffer; /* first entry is pointing to the beginning of the ini buffer */
+    text_data->PtrScriptLine[text_data->NumberOfLines++] = (uintptr_t)text_data->PtrScriptBuffer; /* first entry is pointing to the beginning of the ini buffer */
     
     for (j = 0; j < file_length; ++j)
     {
         if (text_data->PtrScriptBuffer[j] == '\r')
         {
-            text_data->PtrScriptLine[text_data->NumberOfLines] = (unsigned int)&text_data->PtrScriptBuffer[j + 1];
+            text_data->PtrScriptLine[text_data->NumberOfLines] = (uintptr_t)&text_data->PtrScriptBuffer[j + 1];
             text_data->PtrScriptBuffer[j] = 0;
             while (*(char *)text_data->PtrScriptLine[text_data->NumberOfLines - 1] && (*(char *)text_data->PtrScriptLine[text_data->NumberOfLines - 1] == '\n' || *(char *)text_data->PtrScriptLine[text_data->NumberOfLines - 1] == '\r'))
             {
@@ -1161,42 +2122,41 @@ void GUI_DrawReadmeText(char *text)
     /* TODO: Refactor decompiled code */
     int v1;
     char buffer[80];
-    OPM_Struct pixel_map;
-    OPM_Struct pixel_map_gui; /* FIXME: Workaround for menu persistence */
+    int save_under;
+    GUI_DisplayListStruct display_list;
     SETUP_ScriptDataStruct pText;
     int i;
     int v7;
     int line_number;
     
     GUI_ParseReadmeText(&pText, text);
-    OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &pixel_map, 0);
-    OPM_CopyOPMOPM(&GUI_ScreenOpm, &pixel_map, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    GUI_DrawFilledBackground(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 160, GUI_ScreenHeight / 2 - 100, GUI_ScreenWidth / 2 + 159, GUI_ScreenHeight / 2 + 99, 0xF9, 0xF8u, 0xF7, 0xF8);
-    GUI_DrawDropShadow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 160, GUI_ScreenHeight / 2 - 100, GUI_ScreenWidth / 2 + 159, GUI_ScreenHeight / 2 + 99);
-    GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 156, GUI_ScreenHeight / 2 - 96, GUI_ScreenWidth / 2 + 155, GUI_ScreenHeight / 2 - 87, 0xF6u, 0xF6u, 0xF6u);
-    GUI_DrawFrame(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 155, GUI_ScreenHeight / 2 - 86, GUI_ScreenWidth / 2 + 155, GUI_ScreenHeight / 2 - 86, 0xF9u);
-    GUI_PrintButtonText(text, 254, &GUI_ScreenOpm, GUI_ScreenWidth / 2 - 155, GUI_ScreenHeight / 2 - 95, GUI_ScreenWidth / 2 + 154, GUI_ScreenHeight / 2 - 86);
-    GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 153, GUI_ScreenHeight / 2 - 85, GUI_ScreenWidth / 2 + 152, GUI_ScreenHeight / 2 + 76, 0xF7u, 0xF8u, 0xF9u);
-    GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 152, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 134, GUI_ScreenHeight / 2 + 92, 0xF6u);
-    GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 143, GUI_ScreenHeight / 2 + 86, 0, -1);
-    GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 130, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 112, GUI_ScreenHeight / 2 + 92, 0xF6u);
-    GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 121, GUI_ScreenHeight / 2 + 86, 0, 1);
-    GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 103, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 85, GUI_ScreenHeight / 2 + 92, 0xF6u);
-    GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 97, GUI_ScreenHeight / 2 + 86, 0, -1);
-    GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 91, GUI_ScreenHeight / 2 + 86, 0, -1);
-    GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 81, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 63, GUI_ScreenHeight / 2 + 92, 0xF6u);
-    GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 75, GUI_ScreenHeight / 2 + 86, 0, 1);
-    GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 69, GUI_ScreenHeight / 2 + 86, 0, 1);
-    GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 + 85, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 + 151, GUI_ScreenHeight / 2 + 92, 0xF6u);
-    GUI_PrintButtonText((char *)GUI_StringData[SETUP_Language][38], 0, &GUI_ScreenOpm, GUI_ScreenWidth / 2 + 85, GUI_ScreenHeight / 2 + 82, GUI_ScreenWidth / 2 + 151, GUI_ScreenHeight / 2 + 92); /* "Done" */
-    GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 50, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 + 65, GUI_ScreenHeight / 2 + 92, 0xF7u, 0xF8u, 0xF9u);
-    
+    save_under = GUI_SaveUnder(GUI_ScreenWidth / 2 - 160, GUI_ScreenHeight / 2 - 100, GUI_ScreenWidth / 2 + 159 + 3, GUI_ScreenHeight / 2 + 99 + 3);
+    memset(&display_list, 0, sizeof(display_list));
     line_number = 0;
     v7 = 0;
-    OPM_CopyOPMOPM(&GUI_ScreenOpm, &pixel_map_gui, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0); /* FIXME: Workaround for menu persistence */
     do
     {
-        OPM_CopyOPMOPM(&pixel_map_gui, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0); /* FIXME: Workaround for menu persistence */
+        /* The whole dialog is recorded for every page, so only the lines that changed are drawn again */
+        GUI_BeginDisplayList(&display_list);
+        GUI_DrawFilledBackground(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 160, GUI_ScreenHeight / 2 - 100, GUI_ScreenWidth / 2 + 159, GUI_ScreenHeight / 2 + 99, 0xF9, 0xF8u, 0xF7, 0xF8);
+        GUI_DrawDropShadow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 160, GUI_ScreenHeight / 2 - 100, GUI_ScreenWidth / 2 + 159, GUI_ScreenHeight / 2 + 99);
+        GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 156, GUI_ScreenHeight / 2 - 96, GUI_ScreenWidth / 2 + 155, GUI_ScreenHeight / 2 - 87, 0xF6u, 0xF6u, 0xF6u);
+        GUI_DrawFrame(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 155, GUI_ScreenHeight / 2 - 86, GUI_ScreenWidth / 2 + 155, GUI_ScreenHeight / 2 - 86, 0xF9u);
+        GUI_PrintButtonText(text, 254, &GUI_ScreenOpm, GUI_ScreenWidth / 2 - 155, GUI_ScreenHeight / 2 - 95, GUI_ScreenWidth / 2 + 154, GUI_ScreenHeight / 2 - 86);
+        GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 153, GUI_ScreenHeight / 2 - 85, GUI_ScreenWidth / 2 + 152, GUI_ScreenHeight / 2 + 76, 0xF7u, 0xF8u, 0xF9u);
+        GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 152, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 134, GUI_ScreenHeight / 2 + 92, 0xF6u);
+        GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 143, GUI_ScreenHeight / 2 + 86, 0, -1);
+        GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 130, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 112, GUI_ScreenHeight / 2 + 92, 0xF6u);
+        GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 121, GUI_ScreenHeight / 2 + 86, 0, 1);
+        GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 103, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 85, GUI_ScreenHeight / 2 + 92, 0xF6u);
+        GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 97, GUI_ScreenHeight / 2 + 86, 0, -1);
+        GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 91, GUI_ScreenHeight / 2 + 86, 0, -1);
+        GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 81, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 63, GUI_ScreenHeight / 2 + 92, 0xF6u);
+        GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 75, GUI_ScreenHeight / 2 + 86, 0, 1);
+        GUI_DrawArrow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 69, GUI_ScreenHeight / 2 + 86, 0, 1);
+        GUI_DrawButton(&GUI_ScreenOpm, GUI_ScreenWidth / 2 + 85, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 + 151, GUI_ScreenHeight / 2 + 92, 0xF6u);
+        GUI_PrintButtonText((char *)GUI_StringData[SETUP_Language][38], 0, &GUI_ScreenOpm, GUI_ScreenWidth / 2 + 85, GUI_ScreenHeight / 2 + 82, GUI_ScreenWidth / 2 + 151, GUI_ScreenHeight / 2 + 92); /* "Done" */
+        GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 50, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 + 65, GUI_ScreenHeight / 2 + 92, 0xF7u, 0xF8u, 0xF9u);
         GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 49, GUI_ScreenHeight / 2 + 81, GUI_ScreenWidth / 2 + 64, GUI_ScreenHeight / 2 + 91, 0xFDu, 0xFDu, 0xFDu);
         sprintf(buffer, (char *)GUI_StringData[SETUP_Language][40], line_number / 20 + 1, (pText.NumberOfLines - 20) / 20 + 1); /* "Page %li/%li" */
         GUI_PrintButtonText(buffer, 0, &GUI_ScreenOpm, GUI_ScreenWidth / 2 - 49, GUI_ScreenHeight / 2 + 82, GUI_ScreenWidth / 2 + 64, GUI_ScreenHeight / 2 + 93);
@@ -1212,7 +2172,9 @@ void GUI_DrawReadmeText(char *text)
                 GUI_PrintText((char *)pText.PtrScriptLine[line_number + i], 0, &GUI_ScreenOpm, GUI_ScreenWidth / 2 - 152, 8 * i + (int)GUI_ScreenHeight / 2 - 84, GUI_ScreenWidth / 2 + 154, 8 * i + 8 + (int)GUI_ScreenHeight / 2 + 75 + 3);
             }
         }
-        DSA_CopyMainOPMToScreen(1);
+        GUI_EndDisplayList();
+        GUI_ExecuteDisplayList(&display_list, &GUI_ScreenOpm);
+        DSA_CopyMainOPMToScreen(0);
         v1 = GUI_DrawHorizontalMenu(5, v7,
                                     GUI_ScreenWidth / 2 - 152, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 134, GUI_ScreenHeight / 2 + 92, 0x51,
                                     GUI_ScreenWidth / 2 - 130, GUI_ScreenHeight / 2 + 80, GUI_ScreenWidth / 2 - 112, GUI_ScreenHeight / 2 + 92, 0x49,
@@ -1246,10 +2208,10 @@ void GUI_DrawReadmeText(char *text)
             line_number = 0;
         }
     } while (v7 != 4);
-    OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    OPM_Del(&pixel_map);
-    OPM_Del(&pixel_map_gui); /* FIXME: Workaround for menu persistence */
-    DSA_CopyMainOPMToScreen(1);
+    GUI_RestoreUnder(save_under);
+    GUI_DropSaveUnder(save_under);
+    GUI_DelDisplayList(&display_list);
+    DSA_CopyMainOPMToScreen(0);
 }
 
 void GUI_DrawProgressBar(int flag)
@@ -1261,15 +2223,19 @@ void GUI_DrawProgressBar(int flag)
         if (flag == -1 && GUI_ProgressBarStatusFlag)
         {
             GUI_ProgressBarStatusFlag = 0;
-            OPM_CopyOPMOPM(&GUI_ProgressBarPixelMap, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-            OPM_Del(&GUI_ProgressBarPixelMap);
-            DSA_CopyMainOPMToScreen(1);
+            GUI_RestoreUnder(GUI_ProgressBarSaveUnder);
+            GUI_DropSaveUnder(GUI_ProgressBarSaveUnder);
+            GUI_ProgressBarSaveUnder = -1;
+            GUI_DelDisplayList(&GUI_ProgressBarDisplayList);
+            DSA_CopyMainOPMToScreen(0);
         }
     }
     else if (flag <= 0)
     {
         if (GUI_ProgressBarStatusFlag)
         {
+            /* Only the growing bar changes from one call to the next */
+            GUI_BeginDisplayList(&GUI_ProgressBarDisplayList);
             GUI_DrawFilledBackground(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 155, 2 * (GUI_ScreenHeight / 3) - 16, GUI_ScreenWidth / 2 + 155, 2 * (GUI_ScreenHeight / 3) + 16, 249, 0xF8u, 247, 248);
             GUI_DrawDropShadow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 155, 2 * (GUI_ScreenHeight / 3) - 16, GUI_ScreenWidth / 2 + 155, 2 * (GUI_ScreenHeight / 3) + 16);
             GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 151, 2 * (GUI_ScreenHeight / 3) - 12, GUI_ScreenWidth / 2 + 151, 2 * (GUI_ScreenHeight / 3) - 2, 0xF6u, 0xF6u, 0xF6u);
@@ -1285,14 +2251,15 @@ void GUI_DrawProgressBar(int flag)
                 }
                 GUI_DrawEmbossedArea(&GUI_ScreenOpm, (GUI_ScreenWidth / 2 - 149), (2 * (GUI_ScreenHeight / 3) + 1), 298 * progress_bar_status / GUI_ProgressBarMaxLength + (GUI_ScreenWidth / 2 - 149), 2 * (GUI_ScreenHeight / 3) + 10, 0xFFu, 0xFDu, 0xFBu);
             }
-            DSA_CopyMainOPMToScreen(1);
+            GUI_EndDisplayList();
+            GUI_ExecuteDisplayList(&GUI_ProgressBarDisplayList, &GUI_ScreenOpm);
+            DSA_CopyMainOPMToScreen(0);
         }
     }
     else if (flag == 1 && !GUI_ProgressBarStatusFlag)
     {
         GUI_ProgressBarStatusFlag = 1;
-        OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &GUI_ProgressBarPixelMap, 0);
-        OPM_CopyOPMOPM(&GUI_ScreenOpm, &GUI_ProgressBarPixelMap, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
+        GUI_ProgressBarSaveUnder = GUI_SaveUnder(GUI_ScreenWidth / 2 - 155, 2 * (GUI_ScreenHeight / 3) - 16, GUI_ScreenWidth / 2 + 155 + 3, 2 * (GUI_ScreenHeight / 3) + 16 + 3);
         GUI_DrawProgressBar(0);
     }
 }
@@ -1305,10 +2272,10 @@ int GUI_DrawDriveSelectMenu(SETUP_MenuStruct *menu)
     size_t v3;
     int v4;
     int v5;
-    char *x;
+    int x;
     char string[40];
     SETUP_MenuStruct menu_loc;
-    OPM_Struct pixel_map;
+    int save_under;
     int menu_index_loc;
     int v13;
     int v14;
@@ -1331,9 +2298,6 @@ int GUI_DrawDriveSelectMenu(SETUP_MenuStruct *menu)
     v28 = 65;
     menu_loc.index = 0;
     GUI_DrawTextBox(0);
-    
-    OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &pixel_map, 0);
-    OPM_CopyOPMOPM(&GUI_ScreenOpm, &pixel_map, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
     height_loc = 40;
     
     for (i = 0; menu->index / v20 > i; ++i)
@@ -1346,6 +2310,8 @@ int GUI_DrawDriveSelectMenu(SETUP_MenuStruct *menu)
     
     height_loc += 68;
     text_length = GUI_GetTextLength(menu->entry[0].ptr_entry_string) + 42;
+    /* The drive buttons are laid out independently of the box width and can stick out of it, so save whole lines */
+    save_under = GUI_SaveUnder(0, GUI_ScreenHeight / 2 - height_loc / 2, GUI_ScreenWidth - 1, height_loc + GUI_ScreenHeight / 2 - height_loc / 2 + 3);
     GUI_DrawFilledBackground(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - text_length / 2, GUI_ScreenHeight / 2 - height_loc / 2, GUI_ScreenWidth / 2 - text_length / 2 + text_length, height_loc + GUI_ScreenHeight / 2 - height_loc / 2, 249, 0xF8u, 247, 248);
     GUI_DrawDropShadow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - text_length / 2, GUI_ScreenHeight / 2 - height_loc / 2, text_length + GUI_ScreenWidth / 2 - text_length / 2, height_loc + GUI_ScreenHeight / 2 - height_loc / 2);
     GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - text_length / 2 + 4, GUI_ScreenHeight / 2 - height_loc / 2 + 4, text_length + GUI_ScreenWidth / 2 - text_length / 2 - 4, GUI_ScreenHeight / 2 - height_loc / 2 + 15, 0xF6u, 0xF6u, 0xF6u);
@@ -1428,26 +2394,26 @@ int GUI_DrawDriveSelectMenu(SETUP_MenuStruct *menu)
         }
         ++v21;
     }
-    x = (char *)((signed int)GUI_ScreenWidth / 2 - text_length / 2);
+    x = (signed int)GUI_ScreenWidth / 2 - text_length / 2;
     v4 = v19;
     
-    GUI_DrawButton(&GUI_ScreenOpm, (int)x, v19, (int)(x + 80), v19 + 11, 0xF6u);
-    GUI_PrintButtonText((char *)GUI_StringData[SETUP_Language][41], 0, &GUI_ScreenOpm, (int)x, v4 + 2, (int)(x + 80), v4 + 11); /* "Cancel" */
+    GUI_DrawButton(&GUI_ScreenOpm, x, v19, x + 80, v19 + 11, 0xF6u);
+    GUI_PrintButtonText((char *)GUI_StringData[SETUP_Language][41], 0, &GUI_ScreenOpm, x, v4 + 2, x + 80, v4 + 11); /* "Cancel" */
     
     menu_loc.entry[menu_loc.index].ptr_entry_string = 0;
     menu_loc.entry[menu_loc.index].key_input = (char *)&GUI_DriveNumber;
     menu_loc.entry[menu_loc.index].anchor_point = menu->entry[i].anchor_point;
-    menu_loc.entry[menu_loc.index].x = (int)x;
+    menu_loc.entry[menu_loc.index].x = x;
     menu_loc.entry[menu_loc.index].y = v4;
-    menu_loc.entry[menu_loc.index].max_x = (int)(x + 80);
+    menu_loc.entry[menu_loc.index].max_x = x + 80;
     menu_loc.entry[menu_loc.index].max_y = v4 + 11;
     menu_index_loc = menu_loc.index++;
-    DSA_CopyMainOPMToScreen(1);
+    DSA_CopyMainOPMToScreen(0);
     i = GUI_MenuLoop(&menu_loc, 0);
     
-    OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    OPM_Del(&pixel_map);
-    DSA_CopyMainOPMToScreen(1);
+    GUI_RestoreUnder(save_under);
+    GUI_DropSaveUnder(save_under);
+    DSA_CopyMainOPMToScreen(0);
     
     if (i == menu_index_loc)
     {
@@ -1470,7 +2436,7 @@ signed int GUI_WriteIniEntry_Cdrom(void)
     int max_drive_number;
     
     menu_loc.entry[0].ptr_entry_string = (char *)GUI_StringData[SETUP_Language][46]; /* "Select your CD-ROM drive:" */
-    menu_loc.entry[menu_loc.index].key_input = (char *)&GUI_DriveNumber;
+    menu_loc.entry[0].key_input = (char *)&GUI_DriveNumber;
     menu_loc.entry[0].anchor_point = -1;
     menu_loc.index = 1;
     max_drive_number = FILE_GetMaxDriveNumber();
@@ -1523,7 +2489,7 @@ int GUI_DrawTargetDriveMenu(int required_free_space)
     
     GUI_ProgressBarMaxLength = required_free_space;
     menu_loc.entry[0].ptr_entry_string = (char *)GUI_StringData[SETUP_Language][45]; /* "Select the target drive:" */
-    menu_loc.entry[menu_loc.index].key_input = (char *)&GUI_DriveNumber;
+    menu_loc.entry[0].key_input = (char *)&GUI_DriveNumber;
     menu_loc.entry[0].anchor_point = -1;
     menu_loc.index = 1;
     
@@ -1571,7 +2537,8 @@ char *GUI_DrawTargetPathMenu(char *headerString, char *targetPath)
     int src_width_loc;
     size_t strLen;
     int src_width_loc1;
-    OPM_Struct pixel_map;
+    int save_under;
+    GUI_DisplayListStruct display_list;
     int height;
     int v9;
     int getKeyPressed;
@@ -1581,15 +2548,16 @@ char *GUI_DrawTargetPathMenu(char *headerString, char *targetPath)
     
     v9 = 0;
     v14 = 0;
+    memset(&display_list, 0, sizeof(display_list));
     GUI_DrawTextBox(0);
     
-    OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &pixel_map, 0);
-    OPM_CopyOPMOPM(&GUI_ScreenOpm, &pixel_map, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    
     sprintf((char *)&GUI_TargetPathBuffer, "%c:\\%s", SETUP_TargetDrive, targetPath);
     height = 16;
+    save_under = GUI_SaveUnder(GUI_ScreenWidth / 2 - 155, 2 * (GUI_ScreenHeight / 3) - height, GUI_ScreenWidth / 2 + 155 + 3, height + 2 * (GUI_ScreenHeight / 3) + 3);
     while (1)
     {
+        /* The dialog is drawn again after every key, but only the path changes */
+        GUI_BeginDisplayList(&display_list);
         GUI_DrawFilledBackground(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 155, 2 * (GUI_ScreenHeight / 3) - height, GUI_ScreenWidth / 2 + 155, height + 2 * (GUI_ScreenHeight / 3), 249, 0xF8u, 247, 248);
         GUI_DrawDropShadow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 155, 2 * (GUI_ScreenHeight / 3) - height, GUI_ScreenWidth / 2 + 155, height + 2 * (GUI_ScreenHeight / 3));
         GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 151, 2 * (GUI_ScreenHeight / 3) - height + 4, GUI_ScreenWidth / 2 + 151, 2 * (GUI_ScreenHeight / 3) - height + 14, 0xF6u, 0xF6u, 0xF6u);
@@ -1597,8 +2565,10 @@ char *GUI_DrawTargetPathMenu(char *headerString, char *targetPath)
         GUI_PrintText(headerString, 0xFE, &GUI_ScreenOpm, GUI_ScreenWidth / 2 - 150, 2 * (GUI_ScreenHeight / 3) - height + 5, GUI_ScreenWidth / 2 + 150, 2 * (GUI_ScreenHeight / 3) - height + 17);
         GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 150, 2 * (GUI_ScreenHeight / 3) - height + 16, GUI_ScreenWidth / 2 + 150, height + 2 * (GUI_ScreenHeight / 3) - 5, 0xF7u, 0xF8u, 0xF9u);
         GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 149, 2 * (GUI_ScreenHeight / 3) - height + 17, GUI_ScreenWidth / 2 + 149, height + 2 * (GUI_ScreenHeight / 3) - 6, 0xFDu, 0xFDu, 0xFDu);
-        OPM_DrawString(&GUI_ScreenOpm, (char *)&GUI_TargetPathBuffer, GUI_ScreenWidth / 2 - 149, 2 * (GUI_ScreenHeight / 3) - height + 18, 0);
-        DSA_CopyMainOPMToScreen(1);
+        GUI_DrawString(&GUI_ScreenOpm, (char *)&GUI_TargetPathBuffer, GUI_ScreenWidth / 2 - 149, 2 * (GUI_ScreenHeight / 3) - height + 18, 0);
+        GUI_EndDisplayList();
+        GUI_ExecuteDisplayList(&display_list, &GUI_ScreenOpm);
+        DSA_CopyMainOPMToScreen(0);
         GUI_ProcessEvents();
         
 /* FIXME: Incomprehensible decompilation; figure out purpose */
@@ -1654,9 +2624,10 @@ char *GUI_DrawTargetPathMenu(char *headerString, char *targetPath)
         }
     }
     
-    OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    OPM_Del(&pixel_map);
-    DSA_CopyMainOPMToScreen(1);
+    GUI_RestoreUnder(save_under);
+    GUI_DropSaveUnder(save_under);
+    GUI_DelDisplayList(&display_list);
+    DSA_CopyMainOPMToScreen(0);
     
     return (char *)&GUI_TargetPathBuffer;
 }
@@ -1720,20 +2691,25 @@ void GUI_ErrorHandler(int number, ...)
     printf("\n\nInterner Fehler %i !\n", number);
     vprintf((const char *)GUI_StringData[SETUP_Language][number - 1000], arglist);
     printf("\n");
-    arglist[0] = 0;
+    va_end(arglist);
     SYSTEM_Deinit();
     exit(-1);
 }
 
 void GUI_DrawMessageBox(char *text, char *heading, char *button, unsigned char color0, unsigned char color1, unsigned char color2, unsigned char color3, unsigned char color4, unsigned char color5, int color6)
 {
-    OPM_Struct pixel_map;
+    int save_under;
     int i;
     
     GUI_DrawTextBox(0);
-    OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &pixel_map, 0);
-    OPM_CopyOPMOPM(&GUI_ScreenOpm, &pixel_map, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    for (i = 10; GUI_ScreenHeight / 2 > i; ++i)
+    /* Measure first: start at the smallest box that fits, or at the largest one if none does */
+    i = 10;
+    while (GUI_ScreenHeight / 2 > i + 1 && !GUI_MessageBoxFits(text, heading, button, i))
+    {
+        ++i;
+    }
+    save_under = GUI_SaveUnder(GUI_ScreenWidth / 2 - 16 * i / 10, GUI_ScreenHeight / 2 - i, GUI_ScreenWidth / 2 + 16 * i / 10 + 3, i + GUI_ScreenHeight / 2 + 3);
+    for (; GUI_ScreenHeight / 2 > i; ++i)
     {
         GUI_DrawFilledBackground(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 16 * i / 10, GUI_ScreenHeight / 2 - i, GUI_ScreenWidth / 2 + 16 * i / 10, i + GUI_ScreenHeight / 2, color1, color0, color2, color0);
         GUI_DrawEmbossedArea(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 16 * i / 10 + 4, GUI_ScreenHeight / 2 - i + 4, 16 * i / 10 + GUI_ScreenWidth / 2 - 4, GUI_ScreenHeight / 2 - i + 13, color3, color3, color3);
@@ -1757,11 +2733,11 @@ void GUI_DrawMessageBox(char *text, char *heading, char *button, unsigned char c
         GUI_ErrorHandler(1026);
     }
     GUI_DrawDropShadow(&GUI_ScreenOpm, GUI_ScreenWidth / 2 - 16 * i / 10, GUI_ScreenHeight / 2 - i, GUI_ScreenWidth / 2 + 16 * i / 10, i + GUI_ScreenHeight / 2);
-    DSA_CopyMainOPMToScreen(1);
+    DSA_CopyMainOPMToScreen(0);
     GUI_DrawHorizontalMenu(1, 0, (GUI_ScreenWidth / 2 - i + 5), i + GUI_ScreenHeight / 2 - 25, i + GUI_ScreenWidth / 2 - 5, i + GUI_ScreenHeight / 2 - 12, 0x1B);
-    OPM_CopyOPMOPM(&pixel_map, &GUI_ScreenOpm, 0, 0, GUI_ScreenWidth, GUI_ScreenHeight, 0, 0);
-    OPM_Del(&pixel_map);
-    DSA_CopyMainOPMToScreen(1);
+    GUI_RestoreUnder(save_under);
+    GUI_DropSaveUnder(save_under);
+    DSA_CopyMainOPMToScreen(0);
 }
 
 void GUI_PrintInfoBox(char *string)
@@ -37,6 +37,91 @@ typedef struct
     unsigned char blue;
 } GUI_ColorMapStruct;
 
+#define GUI_TEXT_RUN_WORD 0
+#define GUI_TEXT_RUN_SPACE 1
+#define GUI_TEXT_RUN_HYPHEN 2
+
+/* One word, separating space or hyphen of a laid out text. */
+typedef struct
+{
+    unsigned int offset;        /* first character of a word in the string */
+    unsigned int length;
+    short x;                    /* position relative to the top left corner of the text box */
+    short y;
+    unsigned char type;
+} GUI_TextRunStruct;
+
+/* Text broken into lines for a text box of 'width' x 'height' pixels, as drawn by GUI_PrintText. */
+typedef struct
+{
+    char *string;               /* copy of the text that was laid out */
+    unsigned int string_length;
+    unsigned int hash;
+    int width;
+    int height;
+    int is_complete;            /* 0 if the text did not fit; the runs are the part that did */
+    int number_of_runs;
+    GUI_TextRunStruct *runs;
+} GUI_TextLayoutStruct;
+
+/* Screen area saved by GUI_SaveUnder, kept in a pool shared by all save-unders. */
+typedef struct
+{
+    int in_use;
+    int x;
+    int y;
+    int width;                  /* 0 if the area is empty */
+    int height;
+    unsigned int offset;        /* first byte of the saved pixels in the pool */
+} GUI_SaveUnderStruct;
+
+#define GUI_DISPLAY_NONE 0
+#define GUI_DISPLAY_FILL 1
+#define GUI_DISPLAY_STRING 2
+#define GUI_DISPLAY_REMAP 3
+
+/* One recorded drawing command: a filled rectangle, a string drawn with the medium font, or a rectangle shaded by
+   OPM_RemapBox with 'color' as the shade level. Shading is meant for pixels the list does not draw itself, like a
+   drop shadow over the screen behind a dialog, since it is not repeated while it stays the same. */
+typedef struct
+{
+    unsigned char type;
+    unsigned char color;
+    short x0;                   /* inclusive bounds; for strings the area the characters can cover */
+    short y0;
+    short x1;
+    short y1;
+    unsigned int string;        /* offset of the string in the string pool */
+} GUI_DisplayCommandStruct;
+
+typedef struct
+{
+    int number_of_commands;
+    int max_commands;
+    GUI_DisplayCommandStruct *commands;
+    unsigned int strings_size;
+    unsigned int max_strings_size;
+    char *strings;
+} GUI_DisplayBufferStruct;
+
+/* Drawing commands recorded between GUI_BeginDisplayList and GUI_EndDisplayList. The previous recording is kept to
+   find out what changed since it was drawn. A zeroed structure is an empty list. If recording runs out of memory
+   the rest is drawn directly; shading recorded before that point is still not repeated on the next draw. */
+typedef struct
+{
+    GUI_DisplayBufferStruct buffers[2];
+    int current;                /* buffer being recorded, or recorded last */
+    int shown;                  /* 1 + the buffer the pixel map shows, 0 if it shows none */
+    int is_broken;              /* recording ran out of memory and drew directly */
+    int broken_index;           /* index the next command would have had in the broken recording */
+    int is_shown_partial;       /* the shown recording broke off; the commands after it were drawn directly */
+    OPM_Struct *pixel_map;      /* where the list was drawn last */
+    GUI_DisplayCommandStruct *scratch; /* working copy of the commands while drawing, kept to be used again */
+    int max_scratch;
+    unsigned int *mask;         /* coverage mask while drawing, kept to be used again */
+    unsigned int max_mask_words;
+} GUI_DisplayListStruct;
+
 extern void GUI_DrawArrow(OPM_Struct *pixel_map, int x, int y, char color, int direction);
 extern void GUI_DrawFrame(OPM_Struct *pixel_map, int leftBoundary, int upperBoundary, int rightBoundary, int lowerBoundary, unsigned char color);
 extern void GUI_DrawEmbossedArea(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigned char shadowColor, unsigned char fillColor, unsigned char highlightColor);
@@ -47,8 +132,18 @@ extern void GUI_DrawLoweredButton(OPM_Struct *pixel_map, int x_start, int y_star
 extern void GUI_DrawBox(OPM_Struct *pixel_map, int x, int y, int x_max, int y_max);
 extern void GUI_SetPal(void);
 extern void GUI_CreateMouseCursor(unsigned short width, unsigned short height, short x, short y, unsigned char *bitmap);
+extern int GUI_GetTextLength(char *string);
+extern const GUI_TextLayoutStruct *GUI_LayoutText(const char *string, int width, int height);
 extern bool GUI_PrintText(char *string, int color, OPM_Struct *pixel_map, int x, int y, int max_x, int max_y);
 extern bool GUI_PrintButtonText(char *string, int color, OPM_Struct *pixel_map, int x, int y, int max_x, int max_y);
+extern int GUI_SaveUnder(int x0, int y0, int x1, int y1);
+extern void GUI_RestoreUnder(int handle);
+extern void GUI_DropSaveUnder(int handle);
+extern void GUI_BeginDisplayList(GUI_DisplayListStruct *list);
+extern void GUI_EndDisplayList(void);
+extern void GUI_ExecuteDisplayList(GUI_DisplayListStruct *list, OPM_Struct *pixel_map);
+extern void GUI_InvalidateDisplayList(GUI_DisplayListStruct *list);
+extern void GUI_DelDisplayList(GUI_DisplayListStruct *list);
 extern int GUI_DrawAssertBox(char *string);
 extern int GUI_DrawMenu(SETUP_MenuStruct *menu);
 extern void GUI_DrawTextBox(char *string);
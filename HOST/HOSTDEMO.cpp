@@ -0,0 +1,160 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * Opens the host backend through DSA_OpenScreen like SETUP does, draws
+ * the setup background and then the progress bar frame by frame.
+ *
+ * hostdemo [-frames N] [-flip] [-triple] [-banked] [-planar]
+ *          [-lbm FILE] [-ppm PATTERN] [-shm NAME]
+ *************************************************************************/
+
+#include "../OPM.h"
+#include "../DSA.h"
+#include "../DSAHOST.h"
+#include "../GUI.h"
+#include "../LBM.h"
+#include "../ERROR.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HOSTDEMO_ERROR_FLAGS 0x27   /* prefix, data and newline, to the log */
+
+static int HOSTDEMO_Usage(void)
+{
+    printf("usage: hostdemo [-frames N] [-flip] [-triple] [-banked] [-planar] [-lbm FILE] [-ppm PATTERN] [-shm NAME]\n");
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int method;
+    int sink;
+    const char *sink_path;
+    char *lbm_path;
+    unsigned int frames;
+    unsigned int frame;
+    clock_t start;
+    double seconds;
+
+    method = DSA_METHOD_HOST;
+    sink = DSAHOST_SINK_NONE;
+    sink_path = 0;
+    lbm_path = 0;
+    frames = 300;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+        {
+            frames = strtoul(argv[++i], 0, 10);
+        }
+        else if (!strcmp(argv[i], "-flip"))
+        {
+            method |= DSA_METHOD_PAGE_FLIP;
+        }
+        else if (!strcmp(argv[i], "-triple"))
+        {
+            method |= DSA_METHOD_TRIPLE_BUFFER;
+        }
+        else if (!strcmp(argv[i], "-banked"))
+        {
+            method |= DSA_METHOD_BANKED;
+        }
+        else if (!strcmp(argv[i], "-planar"))
+        {
+            method |= DSA_METHOD_PLANAR;
+        }
+        else if (!strcmp(argv[i], "-lbm") && i + 1 < argc)
+        {
+            lbm_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-ppm") && i + 1 < argc)
+        {
+            sink = DSAHOST_SINK_PPM;
+            sink_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-shm") && i + 1 < argc)
+        {
+            sink = DSAHOST_SINK_SHM;
+            sink_path = argv[++i];
+        }
+        else
+        {
+            return HOSTDEMO_Usage();
+        }
+    }
+
+    ERROR_Init((ERROR_OutputFuncPtr)printf);
+
+    if (sink != DSAHOST_SINK_NONE && !DSAHOST_SetSink(sink, sink_path))
+    {
+        ERROR_PrintAllErrors(HOSTDEMO_ERROR_FLAGS);
+        return 1;
+    }
+
+    DSA_Init();
+    OPM_New(GUI_ScreenWidth, GUI_ScreenHeight, 1u, &GUI_ScreenOpm, 0);
+    if (!DSA_OpenScreen(&GUI_ScreenOpm, method))
+    {
+        ERROR_PrintAllErrors(HOSTDEMO_ERROR_FLAGS);
+        OPM_Del(&GUI_ScreenOpm);
+        return 1;
+    }
+    DSA_MouseUpdateFlag = 0;
+
+    if (!lbm_path || !LBM_LoadBackground(lbm_path, &GUI_ScreenOpm, &pal))
+    {
+        GUI_DrawFilledBackground(&GUI_ScreenOpm, 0, 0, GUI_ScreenWidth - 1, GUI_ScreenHeight - 1, 0xF9, 0xF8u, 0xF7, 0xF6);
+    }
+    GUI_SetPal();
+    DSA_CopyMainOPMToScreen(1);
+
+    start = clock();
+    GUI_ProgressBarMaxLength = frames;
+    GUI_ProgressBarCurrentLength = 0;
+    GUI_DrawProgressBar(1);
+    for (frame = 0; frame < frames; frame++)
+    {
+        GUI_ProgressBarCurrentLength++;
+        GUI_DrawProgressBar(0);
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%u frames in %.3f s, %u presented, %u pixels converted, %u window moves\n",
+           frames, seconds, DSAHOST_FramesPresented, DSAHOST_PixelsConverted, DSAHOST_WindowMoves);
+
+    GUI_DrawProgressBar(-1);
+    DSA_CloseScreen();
+    OPM_Del(&GUI_ScreenOpm);
+
+    if (!ERROR_IsStackEmpty())
+    {
+        ERROR_PrintAllErrors(HOSTDEMO_ERROR_FLAGS);
+        return 1;
+    }
+    return 0;
+}
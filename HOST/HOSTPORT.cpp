@@ -0,0 +1,355 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * The parts of the DOS and DPMI layers that OPM, DSA, GUI, LBM, ERROR and
+ * INI use, for building them on a host without DOS. Memory and files go
+ * to the C library, hardware access and input do nothing.
+ *************************************************************************/
+
+#include "../BASEMEM.h"
+#include "../BLEV.h"
+#include "../DOS.h"
+#include "../DPMI.h"
+#include "../FILE.h"
+#include "../INI.h"
+#include "../SETUP.h"
+#include "../SYSTEM.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <i86.h>
+#include <conio.h>
+#include <dos.h>
+#include <io.h>
+
+unsigned int SETUP_Language;
+unsigned char SETUP_TargetDrive;
+unsigned char SETUP_CdDrive;
+unsigned short SETUP_CriticalErrorFlag;
+unsigned int SETUP_DevError;
+unsigned int SETUP_ErrCode;
+unsigned char SETUP_SourcePath[256];
+unsigned char SETUP_TargetPath[256];
+char *SETUP_PtrArgvPath;
+char *SETUP_PtrArgv;
+
+VbeInfoBlock *DPMI_VbeInfo;
+RMREGS rmregs;
+
+SYSTEM_MouseCursorStruct *SYSTEM_MouseCursorPtr;
+unsigned int SYSTEM_MouseCursorSize;
+
+int BASEMEM_Init(void)
+{
+    return 1;
+}
+
+void *BASEMEM_Alloc(unsigned int size, unsigned int memory_flags)
+{
+    return memory_flags & BASEMEM_ZERO_MEMORY ? calloc(1, size) : malloc(size);
+}
+
+int BASEMEM_Free(void *mem_ptr)
+{
+    free(mem_ptr);
+    return 1;
+}
+
+void BASEMEM_FillMemByte(void *dst, unsigned int length, int c)
+{
+    memset(dst, c, length);
+}
+
+void BLEV_GetEvent(BLEV_EventStruct *event)
+{
+    memset(event, 0, sizeof(BLEV_EventStruct));
+}
+
+int DOS_Open(const char *path, unsigned int mode)
+{
+    switch (mode)
+    {
+        case DOS_OPEN_MODE_CREATE:
+        {
+            return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        }
+        case DOS_OPEN_MODE_RDWR:
+        {
+            return open(path, O_RDWR);
+        }
+        case DOS_OPEN_MODE_APPEND:
+        {
+            return open(path, O_WRONLY | O_APPEND);
+        }
+        default:
+        {
+            return open(path, O_RDONLY);
+        }
+    }
+}
+
+int DOS_Close(int file_handle)
+{
+    return close(file_handle) == 0;
+}
+
+int DOS_Read(int file_handle, void *buffer, unsigned int length)
+{
+    return read(file_handle, buffer, length);
+}
+
+int DOS_Write(int file_handle, const void *buffer, unsigned int length)
+{
+    return write(file_handle, buffer, length);
+}
+
+int DOS_Seek(int file_handle, int origin, int offset)
+{
+    static const int whence[3] = { SEEK_CUR, SEEK_SET, SEEK_END };
+
+    return origin >= 0 && origin < 3 && lseek(file_handle, offset, whence[origin]) != -1;
+}
+
+int DOS_GetFileLength(const char *path)
+{
+    struct stat file_stat;
+
+    return stat(path, &file_stat) == 0 ? (int)file_stat.st_size : -1;
+}
+
+bool FILE_IsDriveNumberValid(unsigned char drive_number)
+{
+    return false;
+}
+
+bool FILE_IsFileExisting(const char *path)
+{
+    return access(path, F_OK) == 0;
+}
+
+unsigned char FILE_GetMaxDriveNumber(void)
+{
+    return 0;
+}
+
+void *DPMI_Alloc(int size)
+{
+    return 0;
+}
+
+bool DPMI_IsVesaAvailable(void)
+{
+    return false;
+}
+
+bool DPMI_IsVideoModeSupported(short video_mode, short *vbe_info)
+{
+    return false;
+}
+
+void SYSTEM_Deinit(void)
+{
+}
+
+void SYSTEM_mouse_position_sub_21968()
+{
+}
+
+void SYSTEM_ShowMousePtr(SYSTEM_MouseCursorStruct *ptrMouseCursor)
+{
+}
+
+void SYSTEM_RefreshMousePtr(void)
+{
+}
+
+void SYSTEM_DrawMousePtr(void)
+{
+}
+
+int int386(int number, union REGS *in_regs, union REGS *out_regs)
+{
+    memset(out_regs, 0, sizeof(union REGS));
+    return 0;
+}
+
+int int386x(int number, union REGS *in_regs, union REGS *out_regs, struct SREGS *segment_regs)
+{
+    memset(out_regs, 0, sizeof(union REGS));
+    return 0;
+}
+
+unsigned int inp(unsigned int port)
+{
+    return 0;
+}
+
+unsigned int outp(unsigned int port, unsigned int value)
+{
+    return value;
+}
+
+int kbhit(void)
+{
+    return 0;
+}
+
+int getch(void)
+{
+    return 0;
+}
+
+unsigned int _dos_getdiskfree(unsigned int drive, struct diskfree_t *diskspace)
+{
+    memset(diskspace, 0, sizeof(struct diskfree_t));
+    return 1;
+}
+
+void _dos_getdrive(unsigned int *drive)
+{
+    *drive = 3;
+}
+
+void _dos_setdrive(unsigned int drive, unsigned int *total)
+{
+    *total = 26;
+}
+
+unsigned short _bios_equiplist(void)
+{
+    return 0;
+}
+
+char *itoa(int value, char *buffer, int radix)
+{
+    sprintf(buffer, radix == 16 ? "%x" : radix == 8 ? "%o" : "%d", value);
+    return buffer;
+}
+
+int _bprintf(char *buffer, size_t length, const char *format, ...)
+{
+    va_list args;
+    int retVal;
+
+    va_start(args, format);
+    retVal = vsnprintf(buffer, length, format, args);
+    va_end(args);
+    return retVal;
+}
+
+/* Split 'path' like Open Watcom does; directories are separated by a slash as well as a backslash. 'path' may be 0. */
+void _splitpath(const char *path, char *drive, char *dir, char *fname, char *ext)
+{
+    const char *name;
+    const char *dot;
+    const char *ptr;
+
+    if (!path)
+    {
+        path = "";
+    }
+    if (drive)
+    {
+        drive[0] = 0;
+    }
+    if (path[0] && path[1] == ':')
+    {
+        if (drive)
+        {
+            memcpy(drive, path, 2);
+            drive[2] = 0;
+        }
+        path += 2;
+    }
+
+    name = path;
+    for (ptr = path; *ptr; ptr++)
+    {
+        if (*ptr == '\\' || *ptr == '/')
+        {
+            name = ptr + 1;
+        }
+    }
+    dot = strrchr(name, '.');
+    if (!dot)
+    {
+        dot = name + strlen(name);
+    }
+
+    if (dir)
+    {
+        memcpy(dir, path, name - path);
+        dir[name - path] = 0;
+    }
+    if (fname)
+    {
+        memcpy(fname, name, dot - name);
+        fname[dot - name] = 0;
+    }
+    if (ext)
+    {
+        strcpy(ext, dot);
+    }
+}
+
+void _makepath(char *path, const char *drive, const char *dir, const char *fname, const char *ext)
+{
+    path[0] = 0;
+    if (drive)
+    {
+        strcat(path, drive);
+    }
+    if (dir && dir[0])
+    {
+        strcat(path, dir);
+        if (dir[strlen(dir) - 1] != '\\' && dir[strlen(dir) - 1] != '/')
+        {
+            strcat(path, "/");
+        }
+    }
+    if (fname)
+    {
+        strcat(path, fname);
+    }
+    if (ext && ext[0])
+    {
+        if (ext[0] != '.')
+        {
+            strcat(path, ".");
+        }
+        strcat(path, ext);
+    }
+}
+
+long filelength(int file_handle)
+{
+    struct stat file_stat;
+
+    return fstat(file_handle, &file_stat) == 0 ? (long)file_stat.st_size : -1L;
+}
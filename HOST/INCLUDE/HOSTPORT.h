@@ -0,0 +1,50 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * Included into every file of the host build (see HOST/Makefile) in
+ * place of what Open Watcom provides on its own.
+ *************************************************************************/
+
+#ifndef HOSTPORT_H
+#define HOSTPORT_H
+
+#include <stddef.h>
+#include <strings.h>
+
+#define __int8 char
+#define __int16 short
+#define far
+#define __far
+
+#define stricmp strcasecmp
+#define strnicmp strncasecmp
+#define _unlink unlink
+
+extern char *itoa(int value, char *buffer, int radix);
+extern int _bprintf(char *buffer, size_t length, const char *format, ...);
+extern void _splitpath(const char *path, char *drive, char *dir, char *fname, char *ext);
+extern void _makepath(char *path, const char *drive, const char *dir, const char *fname, const char *ext);
+
+#endif /* HOSTPORT_H */
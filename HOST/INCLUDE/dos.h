@@ -0,0 +1,46 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * <dos.h> of Open Watcom for the host build.
+ *************************************************************************/
+
+#ifndef HOST_DOS_H
+#define HOST_DOS_H
+
+#include <i86.h>
+
+struct diskfree_t
+{
+    unsigned short total_clusters;
+    unsigned short avail_clusters;
+    unsigned short sectors_per_cluster;
+    unsigned short bytes_per_sector;
+};
+
+extern unsigned int _dos_getdiskfree(unsigned int drive, struct diskfree_t *diskspace);
+extern void _dos_getdrive(unsigned int *drive);
+extern void _dos_setdrive(unsigned int drive, unsigned int *total);
+
+#endif /* HOST_DOS_H */
@@ -0,0 +1,88 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * <i86.h> of Open Watcom for the host build. Interrupts do nothing and
+ * return zeroed registers.
+ *************************************************************************/
+
+#ifndef HOST_I86_H
+#define HOST_I86_H
+
+#include <stdint.h>
+
+struct DWORDREGS
+{
+    unsigned int eax;
+    unsigned int ebx;
+    unsigned int ecx;
+    unsigned int edx;
+    unsigned int esi;
+    unsigned int edi;
+    unsigned int cflag;
+};
+
+struct WORDREGS
+{
+    unsigned short ax, _1;
+    unsigned short bx, _2;
+    unsigned short cx, _3;
+    unsigned short dx, _4;
+    unsigned short si, _5;
+    unsigned short di, _6;
+    unsigned int cflag;
+};
+
+struct BYTEREGS
+{
+    unsigned char al, ah; unsigned short _1;
+    unsigned char bl, bh; unsigned short _2;
+    unsigned char cl, ch; unsigned short _3;
+    unsigned char dl, dh; unsigned short _4;
+};
+
+union REGS
+{
+    struct DWORDREGS x;
+    struct WORDREGS w;
+    struct BYTEREGS h;
+};
+
+struct SREGS
+{
+    unsigned short es;
+    unsigned short cs;
+    unsigned short ss;
+    unsigned short ds;
+    unsigned short fs;
+    unsigned short gs;
+};
+
+#define FP_SEG(p) ((unsigned short)0)
+#define FP_OFF(p) ((unsigned int)(uintptr_t)(p))
+
+extern int int386(int number, union REGS *in_regs, union REGS *out_regs);
+extern int int386x(int number, union REGS *in_regs, union REGS *out_regs, struct SREGS *segment_regs);
+
+#endif /* HOST_I86_H */
@@ -0,0 +1,209 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-026: INI entries are found by their exact key, case-insensitive,
+ * with the inner spaces of their values. Staged changes reach the file
+ * only on the outermost commit, and an abort leaves it alone. Lines that
+ * do not change keep their bytes, comments and CRLF line endings.
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include "../INI.h"
+#include "../SETUP.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_INI "./TEST026.ini"
+
+static const char TEST_Original[] =
+    "; Setup configuration\r\n"
+    "[SYSTEM]\r\n"
+    "VESA=Y\r\n"
+    "  Language = 2 \r\n"
+    "LANG=9\r\n"
+    "PATH=C:\\GAMES\\MY GAME\r\n"
+    "\r\n"
+    "; video cards\r\n"
+    "[VESA]\r\n"
+    "MEMORY=64\r\n"
+    "OEM=Some Card  Inc.\r\n"
+    "\r\n";
+
+static const char TEST_Changed[] =
+    "; Setup configuration\r\n"
+    "[SYSTEM]\r\n"
+    "VESA=Y\r\n"
+    "  Language = 5\r\n"
+    "LANG=3\r\n"
+    "PATH=C:\\GAMES\\MY GAME\r\n"
+    "\r\n"
+    "; video cards\r\n"
+    "[VESA]\r\n"
+    "MEMORY=128\r\n"
+    "OEM=Some Card  Inc.\r\n"
+    "NEW=X  Y\r\n"
+    "\r\n"
+    "[SOUND]\r\n"
+    "CARD=SB 16\r\n";
+
+static const char TEST_System[] =
+    "; Setup configuration\r\n"
+    "[SYSTEM]\r\n"
+    "VESA=N\r\n"
+    "  Language = 2\r\n"
+    "LANG=3\r\n"
+    "FPU=N\r\n"
+    "\r\n"
+    "; video cards\r\n"
+    "[VESA]\r\n"
+    "MEMORY=128\r\n"
+    "OEM=Some Card  Inc.\r\n"
+    "NEW=X  Y\r\n"
+    "\r\n"
+    "[SOUND]\r\n"
+    "CARD=SB 16\r\n";
+
+static void TEST_WriteFile(const char *contents)
+{
+    FILE *fp;
+
+    fp = fopen(TEST_INI, "wb");
+    fwrite(contents, strlen(contents), 1, fp);
+    fclose(fp);
+    INI_InvalidateModel();
+}
+
+/* Whether the INI file holds exactly 'contents'. */
+static int TEST_IsFile(const char *contents)
+{
+    static char buffer[4096];
+    FILE *fp;
+    size_t length;
+
+    fp = fopen(TEST_INI, "rb");
+    if (!fp)
+    {
+        return 0;
+    }
+    length = fread(buffer, 1, sizeof(buffer), fp);
+    fclose(fp);
+    return length == strlen(contents) && !memcmp(buffer, contents, length);
+}
+
+static void TEST_CheckEntry(const char *category, const char *item, const char *expected)
+{
+    char buffer[100];
+
+    if (!INI_GetEntry(category, item, buffer, sizeof(buffer)))
+    {
+        if (expected)
+        {
+            TESTUTIL_Fail("[%s] %s was not found", category, item);
+        }
+    }
+    else if (!expected)
+    {
+        TESTUTIL_Fail("[%s] %s was found as \"%s\"", category, item, buffer);
+    }
+    else if (strcmp(buffer, expected))
+    {
+        TESTUTIL_Fail("[%s] %s is \"%s\" instead of \"%s\"", category, item, buffer, expected);
+    }
+}
+
+int main(void)
+{
+    SETUP_PtrArgv = (char *)"./TEST026.EXE";
+    INI_MakePath();
+    if (strcmp((const char *)INI_WriteBuffer, TEST_INI))
+    {
+        TESTUTIL_Fail("INI_MakePath gave %s", (const char *)INI_WriteBuffer);
+        strcpy((char *)INI_WriteBuffer, TEST_INI);
+    }
+    TEST_WriteFile(TEST_Original);
+
+    TEST_CheckEntry("SYSTEM", "LANG", "9");
+    TEST_CheckEntry("SYSTEM", "LANGUAGE", "2");
+    TEST_CheckEntry("system", "language", "2");
+    TEST_CheckEntry("SYSTEM", "LAN", 0);
+    TEST_CheckEntry("SYSTEM", "LANGUAGES", 0);
+    TEST_CheckEntry("SYSTEM", "PATH", "C:\\GAMES\\MY GAME");
+    TEST_CheckEntry("SYSTEM", "MEMORY", 0);
+    TEST_CheckEntry("VESA", "OEM", "Some Card  Inc.");
+    TEST_CheckEntry("VES", "OEM", 0);
+
+    /* Setting a value it already has writes the file back unchanged. */
+    INI_BeginTransaction();
+    INI_WriteEntry("SYSTEM", "LANG", "9");
+    if (!INI_CommitTransaction() || !TEST_IsFile(TEST_Original))
+    {
+        TESTUTIL_Fail("the unchanged file did not round-trip");
+    }
+
+    INI_BeginTransaction();
+    INI_WriteEntry("VESA", "MEMORY", "128");
+    INI_AbortTransaction();
+    INI_BeginTransaction();
+    if (!INI_CommitTransaction() || !TEST_IsFile(TEST_Original))
+    {
+        TESTUTIL_Fail("an aborted transaction changed the file");
+    }
+
+    INI_BeginTransaction();
+    INI_WriteEntry("SYSTEM", "LANG", "3");
+    INI_WriteEntry("SYSTEM", "Language", "5");
+    INI_WriteEntry("VESA", "MEMORY", "128");
+    INI_WriteEntry("VESA", "NEW", "X  Y");
+    INI_WriteEntry("SOUND", "CARD", "SB 16");
+    if (!TEST_IsFile(TEST_Original))
+    {
+        TESTUTIL_Fail("staged entries were written before the commit");
+    }
+    if (!INI_CommitTransaction() || !TEST_IsFile(TEST_Changed))
+    {
+        TESTUTIL_Fail("the committed file differs");
+        TEST_WriteFile(TEST_Changed);
+    }
+    TEST_CheckEntry("SYSTEM", "LANG", "3");
+    TEST_CheckEntry("VESA", "NEW", "X  Y");
+    TEST_CheckEntry("SOUND", "CARD", "SB 16");
+
+    SETUP_Language = 1;
+    INI_DeleteEntry("SYSTEM", "PATH");
+    INI_WriteEntry_System();
+    if (!TEST_IsFile(TEST_System))
+    {
+        TESTUTIL_Fail("INI_WriteEntry_System gave a different file");
+    }
+    TEST_CheckEntry("SYSTEM", "PATH", 0);
+
+    if (!access("./TEST026.TMP", F_OK) || !access("./TEST026.BAK", F_OK))
+    {
+        TESTUTIL_Fail("a temporary file was left behind");
+    }
+    unlink(TEST_INI);
+    return TESTUTIL_Finish("TEST026");
+}
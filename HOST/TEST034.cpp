@@ -0,0 +1,178 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-034: an image saved by LBM_SaveOPM, as PBM or ILBM, packed or
+ * not, must load back through LBM_DisplayLBM, from the file and from
+ * memory, with the same pixels and palette.
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include "../LBM.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_IMAGE "test034.lbm"
+#define TEST_ROUNDS 300
+
+#define TEST_LOAD_NEW_OPM 1         /* flags of LBM_DisplayLBM */
+#define TEST_LOAD_IN_MEMORY 0x10000
+
+static int TEST_IsSamePal(const LBM_LogPalette *saved, const LBM_LogPalette *loaded)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        if (i < saved->number_of_entries
+            ? loaded->pal_entry[i].peRed != saved->pal_entry[i].peRed || loaded->pal_entry[i].peGreen != saved->pal_entry[i].peGreen
+              || loaded->pal_entry[i].peBlue != saved->pal_entry[i].peBlue
+            : loaded->pal_entry[i].peRed || loaded->pal_entry[i].peGreen || loaded->pal_entry[i].peBlue)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int TEST_IsSamePixels(OPM_Struct *saved, OPM_Struct *loaded)
+{
+    if (loaded->width != saved->width || loaded->height != saved->height)
+    {
+        return 0;
+    }
+    for (int y = 0; y < saved->height; y++)
+    {
+        if (memcmp(&saved->buffer[y * saved->stride], &loaded->buffer[y * loaded->stride], saved->width))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Read the saved image into memory, or return 0. */
+static char *TEST_ReadImage(void)
+{
+    FILE *fp;
+    long length;
+    char *data;
+
+    fp = fopen(TEST_IMAGE, "rb");
+    if (!fp)
+    {
+        return 0;
+    }
+    fseek(fp, 0, SEEK_END);
+    length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = (char *)malloc(length);
+    if (data && fread(data, 1, length, fp) != (size_t)length)
+    {
+        free(data);
+        data = 0;
+    }
+    fclose(fp);
+    return data;
+}
+
+int main(void)
+{
+    OPM_Struct saved, loaded;
+    LBM_LogPalette pal, loaded_pal;
+    char *data;
+    int width, height, colors, run, flags;
+    unsigned char color;
+
+    srand(34);
+    for (int round = 0; round < TEST_ROUNDS; round++)
+    {
+        width = 1 + TESTUTIL_Random(round % 4 == 0 ? 330 : 40);
+        height = 1 + TESTUTIL_Random(60);
+        OPM_New(width, height, 1, &saved, 0);
+
+        /* noise, short runs or long runs of a few colors */
+        colors = round % 3 == 0 ? 256 : 1 + TESTUTIL_Random(8);
+        run = 0;
+        color = 0;
+        for (int i = 0; i < width * height; i++)
+        {
+            if (run-- <= 0)
+            {
+                run = round % 3 == 2 ? TESTUTIL_Random(300) : TESTUTIL_Random(4);
+                color = TESTUTIL_Random(colors) * 255 / colors;
+            }
+            saved.buffer[i] = round % 3 == 0 ? TESTUTIL_Random(256) : color;
+        }
+
+        pal.number_of_entries = round % 5 == 0 ? 1 + TESTUTIL_Random(255) : 256;
+        for (int i = 0; i < 256; i++)
+        {
+            pal.pal_entry[i].peRed = TESTUTIL_Random(256);
+            pal.pal_entry[i].peGreen = TESTUTIL_Random(256);
+            pal.pal_entry[i].peBlue = TESTUTIL_Random(256);
+        }
+
+        flags = round % 4 == 3 ? LBM_SAVE_FLAG_ILBM | LBM_SAVE_FLAG_UNCOMPRESSED : round % 4;
+        if (!LBM_SaveOPM((char *)TEST_IMAGE, &saved, &pal, flags))
+        {
+            TESTUTIL_Fail("round %d: cannot save %dx%d with flags %d", round, width, height, flags);
+            OPM_Del(&saved);
+            continue;
+        }
+
+        memset(&loaded_pal, 0xA5, sizeof(loaded_pal));
+        if (!LBM_DisplayLBM((char *)TEST_IMAGE, &loaded, &loaded_pal, TEST_LOAD_NEW_OPM))
+        {
+            TESTUTIL_Fail("round %d: cannot load %dx%d with flags %d", round, width, height, flags);
+        }
+        else
+        {
+            if (!TEST_IsSamePixels(&saved, &loaded) || !TEST_IsSamePal(&pal, &loaded_pal))
+            {
+                TESTUTIL_Fail("round %d: %dx%d with flags %d loads differently", round, width, height, flags);
+            }
+            OPM_Del(&loaded);
+        }
+
+        data = TEST_ReadImage();
+        memset(&loaded_pal, 0xA5, sizeof(loaded_pal));
+        if (!data || !LBM_DisplayLBM(data, &loaded, &loaded_pal, TEST_LOAD_NEW_OPM | TEST_LOAD_IN_MEMORY))
+        {
+            TESTUTIL_Fail("round %d: cannot load %dx%d with flags %d from memory", round, width, height, flags);
+        }
+        else
+        {
+            if (!TEST_IsSamePixels(&saved, &loaded) || !TEST_IsSamePal(&pal, &loaded_pal))
+            {
+                TESTUTIL_Fail("round %d: %dx%d with flags %d loads differently from memory", round, width, height, flags);
+            }
+            OPM_Del(&loaded);
+        }
+        free(data);
+        OPM_Del(&saved);
+    }
+
+    remove(TEST_IMAGE);
+    return TESTUTIL_Finish("TEST034");
+}
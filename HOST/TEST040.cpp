@@ -0,0 +1,199 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-040: every drawing primitive records what it touched, so a
+ * present that uploads only the dirty rectangles must leave the screen
+ * equal to the whole main OPM.
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include "../DSA.h"
+#include "../DSAHOST.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 200
+#define TEST_FRAMES 5000
+
+static void TEST_Draw(OPM_Struct *pixel_map, OPM_Struct *sprite)
+{
+    OPM_Struct view;
+    OPM_Struct *target;
+    OPM_SpanStruct spans[20];
+    unsigned char pixels[20 * 110];
+    int x, y, width, height, number_of_spans;
+    unsigned char color;
+
+    target = pixel_map;
+    if (TESTUTIL_Random(4) == 0)
+    {
+        OPM_CreateVirtualOPM(pixel_map, &view, TESTUTIL_Random(400) - 40, TESTUTIL_Random(260) - 30, TESTUTIL_Random(200), TESTUTIL_Random(150));
+        view.origin_x += TESTUTIL_Random(3) - 1;
+        target = &view;
+    }
+
+    x = TESTUTIL_Random(380) - 30;
+    y = TESTUTIL_Random(260) - 30;
+    width = 1 + TESTUTIL_Random(120);
+    height = 1 + TESTUTIL_Random(90);
+    color = TESTUTIL_Random(256);
+    switch (TESTUTIL_Random(9))
+    {
+        case 0:
+        {
+            OPM_SetPixel(target, x, y, color);
+            break;
+        }
+        case 1:
+        {
+            OPM_HorLine(target, x, y, width, color);
+            break;
+        }
+        case 2:
+        {
+            OPM_VerLine(target, x, y, height, color);
+            break;
+        }
+        case 3:
+        {
+            OPM_Box(target, x, y, width, height, color);
+            break;
+        }
+        case 4:
+        {
+            OPM_FillBox(target, x, y, width, height, color);
+            break;
+        }
+        case 5:
+        {
+            number_of_spans = TESTUTIL_Random(20);
+            for (int i = 0; i < number_of_spans; i++)
+            {
+                spans[i].y = y + i;
+                spans[i].x0 = x + TESTUTIL_Random(10);
+                spans[i].x1 = spans[i].x0 + TESTUTIL_Random(100) - 3;
+                spans[i].color = color;
+            }
+            for (int i = 0; i < (int)sizeof(pixels); i++)
+            {
+                pixels[i] = TESTUTIL_Random(256);
+            }
+            if (TESTUTIL_Random(2))
+            {
+                OPM_FillSpans(target, spans, number_of_spans);
+            }
+            else
+            {
+                OPM_PutSpans(target, spans, pixels, number_of_spans);
+            }
+            break;
+        }
+        case 6:
+        {
+            if (TESTUTIL_Random(2))
+            {
+                sprite->flags |= BBOPM_TRANSPARENCY;
+            }
+            else
+            {
+                sprite->flags &= ~BBOPM_TRANSPARENCY;
+            }
+            OPM_CopyOPMOPM(sprite, target, TESTUTIL_Random(20) - 5, TESTUTIL_Random(20) - 5, width, height, x, y);
+            break;
+        }
+        case 7:
+        {
+            OPM_DrawString(target, "Hello dirty", x, y, color);
+            break;
+        }
+        default:
+        {
+            OPM_FillBox(target, 0, 0, TESTUTIL_Random(4) ? 10 : 400, TESTUTIL_Random(4) ? 10 : 300, color);
+            break;
+        }
+    }
+}
+
+int main(void)
+{
+    OPM_Struct screen;
+    OPM_Struct sprite;
+    OPM_RectStruct *rect;
+    unsigned int converted;
+
+    srand(40);
+    OPM_New(TEST_WIDTH, TEST_HEIGHT, 1, &screen, 0);
+    OPM_New(64, 64, 1, &sprite, 0);
+    sprite.transparent_color = 0;
+    for (int i = 0; i < 64 * 64; i++)
+    {
+        sprite.buffer[i] = TESTUTIL_Random(4);
+    }
+    if (!TESTUTIL_OpenScreen(&screen, 0))
+    {
+        TESTUTIL_Fail("cannot open the host screen");
+        return TESTUTIL_Finish("TEST040");
+    }
+    DSA_CopyMainOPMToScreen(1);
+    converted = DSAHOST_PixelsConverted;
+
+    for (int frame = 0; frame < TEST_FRAMES; frame++)
+    {
+        for (int i = TESTUTIL_Random(6); i >= 0; i--)
+        {
+            TEST_Draw(&screen, &sprite);
+        }
+        if (screen.number_of_dirty_rects > OPM_MAX_DIRTY_RECTS)
+        {
+            TESTUTIL_Fail("frame %d: %d dirty rectangles", frame, screen.number_of_dirty_rects);
+        }
+        for (int i = 0; i < screen.number_of_dirty_rects && i < OPM_MAX_DIRTY_RECTS; i++)
+        {
+            rect = &screen.dirty_rects[i];
+            if (rect->x0 < 0 || rect->y0 < 0 || rect->x1 > TEST_WIDTH || rect->y1 > TEST_HEIGHT || rect->x0 >= rect->x1 || rect->y0 >= rect->y1)
+            {
+                TESTUTIL_Fail("frame %d: bad dirty rectangle %d,%d - %d,%d", frame, rect->x0, rect->y0, rect->x1, rect->y1);
+            }
+        }
+        DSA_CopyMainOPMToScreen(0);
+        if (screen.number_of_dirty_rects != 0)
+        {
+            TESTUTIL_Fail("frame %d: the present did not clear the dirty rectangles", frame);
+        }
+        if (!TESTUTIL_IsScreenEqual(&screen))
+        {
+            TESTUTIL_Fail("frame %d: the screen differs from the main OPM", frame);
+        }
+    }
+
+    printf("TEST040: %u frames uploaded %.1f%% of the pixels of full presents\n", TEST_FRAMES,
+           100.0 * (DSAHOST_PixelsConverted - converted) / ((double)TEST_WIDTH * TEST_HEIGHT * TEST_FRAMES));
+    DSA_CloseScreen();
+    OPM_Del(&sprite);
+    OPM_Del(&screen);
+    return TESTUTIL_Finish("TEST040");
+}
@@ -0,0 +1,114 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-041: a sprite compiled by OPM_CreateGFX and drawn with
+ * OPM_CopyGFXOPM must give the same pixels as copying its OPM with
+ * OPM_CopyOPMOPM, under any clip rectangle and origin, and must mark
+ * every pixel it changes as dirty.
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WIDTH 600
+#define TEST_HEIGHT 300
+#define TEST_ROUNDS 5000
+
+int main(void)
+{
+    OPM_Struct sprite, copied, drawn;
+    OPM_GfxStruct gfx;
+    static unsigned char before[TEST_WIDTH * TEST_HEIGHT];
+    int width, height, density, x, y;
+
+    srand(41);
+    OPM_New(TEST_WIDTH, TEST_HEIGHT, 1, &copied, 0);
+    OPM_New(TEST_WIDTH, TEST_HEIGHT, 1, &drawn, 0);
+    for (int round = 0; round < TEST_ROUNDS; round++)
+    {
+        width = 1 + TESTUTIL_Random(round % 10 == 0 ? 590 : 40);
+        height = 1 + TESTUTIL_Random(40);
+        OPM_New(width, height, 1, &sprite, 0);
+        density = TESTUTIL_Random(4);
+        for (int i = 0; i < width * height; i++)
+        {
+            sprite.buffer[i] = TESTUTIL_Random(4) < density ? 0 : 1 + TESTUTIL_Random(255);
+            if (round % 8 == 3 && i % width > 50)
+            {
+                sprite.buffer[i] = 0;
+            }
+        }
+        if (TESTUTIL_Random(5) != 0)
+        {
+            sprite.flags |= BBOPM_TRANSPARENCY;
+            sprite.transparent_color = 0;
+        }
+        if (!OPM_CreateGFX(&sprite, &gfx))
+        {
+            TESTUTIL_Fail("round %d: cannot create a %dx%d sprite", round, width, height);
+            OPM_Del(&sprite);
+            continue;
+        }
+
+        for (int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++)
+        {
+            before[i] = copied.buffer[i] = drawn.buffer[i] = TESTUTIL_Random(256);
+        }
+        copied.clip_x = drawn.clip_x = TESTUTIL_Random(100);
+        copied.clip_y = drawn.clip_y = TESTUTIL_Random(50);
+        copied.clip_width = drawn.clip_width = 1 + TESTUTIL_Random(TEST_WIDTH - copied.clip_x);
+        copied.clip_height = drawn.clip_height = 1 + TESTUTIL_Random(TEST_HEIGHT - copied.clip_y);
+        copied.origin_x = drawn.origin_x = TESTUTIL_Random(20) - 10;
+        copied.origin_y = drawn.origin_y = TESTUTIL_Random(20) - 10;
+        OPM_ClearDirtyRects(&drawn);
+
+        x = TESTUTIL_Random(700) - 100;
+        y = TESTUTIL_Random(400) - 100;
+        OPM_CopyOPMOPM(&sprite, &copied, 0, 0, width, height, x, y);
+        OPM_CopyGFXOPM(&gfx, &drawn, x, y);
+
+        if (memcmp(copied.buffer, drawn.buffer, TEST_WIDTH * TEST_HEIGHT))
+        {
+            TESTUTIL_Fail("round %d: %dx%d sprite at %d,%d differs from the copy", round, width, height, x, y);
+        }
+        for (int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++)
+        {
+            if (drawn.buffer[i] != before[i] && !TESTUTIL_IsInDirtyRects(&drawn, i % TEST_WIDTH, i / TEST_WIDTH))
+            {
+                TESTUTIL_Fail("round %d: pixel %d,%d changed outside the dirty rectangles", round, i % TEST_WIDTH, i / TEST_WIDTH);
+                break;
+            }
+        }
+
+        OPM_DelGFX(&gfx);
+        OPM_Del(&sprite);
+    }
+
+    OPM_Del(&drawn);
+    OPM_Del(&copied);
+    return TESTUTIL_Finish("TEST041");
+}
@@ -0,0 +1,289 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-042: drawing the same operations into 8, 16 and 32 bit pixel
+ * maps must give 16 and 32 bit pixels that are the palette colors of
+ * the 8 bit ones. Copies between depths that are not supported, and
+ * loading or saving an image with a pixel map that is not 8 bit, must
+ * report an error and leave the target alone.
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include "../ERROR.h"
+#include "../LBM.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WIDTH 200
+#define TEST_HEIGHT 120
+#define TEST_ROUNDS 20000
+#define TEST_IMAGE "test042.lbm"
+
+static unsigned int TEST_Color32[256];
+static unsigned short TEST_Color16[256];
+
+static int TEST_IsEqual(OPM_Struct *indexed, OPM_Struct *map32, OPM_Struct *map16)
+{
+    unsigned char index;
+
+    for (int y = 0; y < indexed->height; y++)
+    {
+        for (int x = 0; x < indexed->width; x++)
+        {
+            index = indexed->buffer[y * indexed->stride + x];
+            if (((unsigned int *)(map32->buffer + y * map32->stride))[x] != TEST_Color32[index] ||
+                ((unsigned short *)(map16->buffer + y * map16->stride))[x] != TEST_Color16[index])
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static void TEST_Copy(OPM_Struct *src, int transparent, OPM_Struct *dst, int src_x, int src_y, int width, int height, int x, int y)
+{
+    if (transparent)
+    {
+        src->flags |= BBOPM_TRANSPARENCY;
+    }
+    src->transparent_color = 0;
+    OPM_CopyOPMOPM(src, dst, src_x, src_y, width, height, x, y);
+    src->flags &= ~BBOPM_TRANSPARENCY;
+}
+
+static void TEST_CheckUnsupported(OPM_Struct *src, OPM_Struct *dst)
+{
+    OPM_ClearDirtyRects(dst);
+    ERROR_ClearStack();
+    OPM_CopyOPMOPM(src, dst, 0, 0, 8, 8, 0, 0);
+    if (ERROR_IsStackEmpty() || dst->number_of_dirty_rects != 0)
+    {
+        TESTUTIL_Fail("copy from %d to %d bytes per pixel was not reported", src->bytes_per_pixel, dst->bytes_per_pixel);
+    }
+    ERROR_ClearStack();
+}
+
+static void TEST_CheckImages(OPM_Struct *indexed, OPM_Struct *pixel_map)
+{
+    OPM_Struct before;
+
+    ERROR_ClearStack();
+    if (!LBM_SaveOPM((char *)TEST_IMAGE, indexed, 0, 0))
+    {
+        TESTUTIL_Fail("cannot save the 8 bit pixel map");
+        return;
+    }
+    OPM_New(pixel_map->width, pixel_map->height, pixel_map->bytes_per_pixel, &before, 0);
+    memcpy(before.buffer, pixel_map->buffer, pixel_map->size);
+    for (int flags = 0; flags <= 2; flags += 2)
+    {
+        if (LBM_DisplayLBM((char *)TEST_IMAGE, pixel_map, 0, flags) || ERROR_IsStackEmpty()
+            || pixel_map->stride != before.stride || memcmp(pixel_map->buffer, before.buffer, pixel_map->size) != 0)
+        {
+            TESTUTIL_Fail("loading into %d bytes per pixel with flags %d was not reported", pixel_map->bytes_per_pixel, flags);
+        }
+        ERROR_ClearStack();
+    }
+    if (LBM_SaveOPM((char *)TEST_IMAGE, pixel_map, 0, 0) || ERROR_IsStackEmpty())
+    {
+        TESTUTIL_Fail("saving %d bytes per pixel was not reported", pixel_map->bytes_per_pixel);
+    }
+    ERROR_ClearStack();
+    OPM_Del(&before);
+    remove(TEST_IMAGE);
+}
+
+int main(void)
+{
+    static const int bytes_per_pixel[3] = { 1, 4, 2 };
+    OPM_Struct maps[3], sprites[3], view;
+    OPM_Struct *target;
+    OPM_GfxStruct gfx;
+    OPM_SpanStruct spans[10];
+    unsigned char pixels[10 * 70];
+    unsigned char red, green, blue, index;
+    int operation, x, y, width, height, color, transparent, use_view, view_x, view_y, view_width, view_height, src_x, src_y, number_of_spans;
+
+    srand(42);
+    for (int i = 0; i < 256; i++)
+    {
+        red = (i >> 3) << 3;
+        green = (i & 7) << 5;
+        blue = TESTUTIL_Random(256);
+        OPM_SetPaletteEntry(i, red, green, blue);
+        TEST_Color32[i] = (red << 16) | (green << 8) | blue;
+        TEST_Color16[i] = ((red & 0xF8) << 8) | ((green & 0xFC) << 3) | (blue >> 3);
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        OPM_New(TEST_WIDTH, TEST_HEIGHT, bytes_per_pixel[k], &maps[k], 0);
+        OPM_New(50, 40, bytes_per_pixel[k], &sprites[k], 0);
+    }
+    for (int i = 0; i < 50 * 40; i++)
+    {
+        index = TESTUTIL_Random(3) ? TESTUTIL_Random(256) : 0;
+        sprites[0].buffer[i] = index;
+        ((unsigned int *)sprites[1].buffer)[i] = TEST_Color32[index];
+        ((unsigned short *)sprites[2].buffer)[i] = TEST_Color16[index];
+    }
+    for (int k = 1; k < 3; k++)
+    {
+        OPM_CopyOPMOPM(&maps[0], &maps[k], 0, 0, TEST_WIDTH, TEST_HEIGHT, 0, 0);
+    }
+    sprites[0].flags |= BBOPM_TRANSPARENCY;
+    sprites[0].transparent_color = 0;
+    if (!OPM_CreateGFX(&sprites[0], &gfx))
+    {
+        TESTUTIL_Fail("cannot create the sprite");
+        return TESTUTIL_Finish("TEST042");
+    }
+    sprites[0].flags &= ~BBOPM_TRANSPARENCY;
+
+    for (int round = 0; round < TEST_ROUNDS; round++)
+    {
+        operation = TESTUTIL_Random(11);
+        x = TESTUTIL_Random(260) - 30;
+        y = TESTUTIL_Random(180) - 30;
+        width = 1 + TESTUTIL_Random(80);
+        height = 1 + TESTUTIL_Random(60);
+        color = TESTUTIL_Random(256);
+        transparent = TESTUTIL_Random(2);
+        use_view = TESTUTIL_Random(3) == 0;
+        view_x = TESTUTIL_Random(220) - 10;
+        view_y = TESTUTIL_Random(140) - 10;
+        view_width = TESTUTIL_Random(150);
+        view_height = TESTUTIL_Random(100);
+        src_x = TESTUTIL_Random(20) - 5;
+        src_y = TESTUTIL_Random(20) - 5;
+        number_of_spans = TESTUTIL_Random(10);
+        for (int i = 0; i < number_of_spans; i++)
+        {
+            spans[i].y = y + i;
+            spans[i].x0 = x + TESTUTIL_Random(10);
+            spans[i].x1 = spans[i].x0 + TESTUTIL_Random(60);
+            spans[i].color = TESTUTIL_Random(256);
+        }
+        for (int i = 0; i < (int)sizeof(pixels); i++)
+        {
+            pixels[i] = TESTUTIL_Random(256);
+        }
+
+        for (int k = 0; k < 3; k++)
+        {
+            target = &maps[k];
+            if (use_view)
+            {
+                OPM_CreateVirtualOPM(&maps[k], &view, view_x, view_y, view_width, view_height);
+                target = &view;
+            }
+            switch (operation)
+            {
+                case 0:
+                {
+                    OPM_SetPixel(target, x, y, color);
+                    break;
+                }
+                case 1:
+                {
+                    OPM_HorLine(target, x, y, width, color);
+                    break;
+                }
+                case 2:
+                {
+                    OPM_VerLine(target, x, y, height, color);
+                    break;
+                }
+                case 3:
+                {
+                    OPM_Box(target, x, y, width, height, color);
+                    break;
+                }
+                case 4:
+                {
+                    OPM_FillBox(target, x, y, width, height, color);
+                    break;
+                }
+                case 5:
+                {
+                    OPM_FillSpans(target, spans, number_of_spans);
+                    break;
+                }
+                case 6:
+                {
+                    OPM_PutSpans(target, spans, pixels, number_of_spans);
+                    break;
+                }
+                case 7:
+                {
+                    /* 8 bit source expanded through the tables */
+                    TEST_Copy(&sprites[0], transparent, target, src_x, src_y, width, height, x, y);
+                    break;
+                }
+                case 8:
+                {
+                    /* source of the same depth */
+                    TEST_Copy(&sprites[k], transparent, target, src_x, src_y, width, height, x, y);
+                    break;
+                }
+                case 9:
+                {
+                    OPM_CopyGFXOPM(&gfx, target, x, y);
+                    break;
+                }
+                default:
+                {
+                    OPM_DrawString(target, "Ab9 xyz", x, y, color);
+                    break;
+                }
+            }
+        }
+        if (!TEST_IsEqual(&maps[0], &maps[1], &maps[2]))
+        {
+            TESTUTIL_Fail("round %d: operation %d%s gives different colors", round, operation, use_view ? " through a view" : "");
+            for (int k = 1; k < 3; k++)
+            {
+                OPM_CopyOPMOPM(&maps[0], &maps[k], 0, 0, TEST_WIDTH, TEST_HEIGHT, 0, 0);
+            }
+        }
+    }
+
+    TEST_CheckUnsupported(&maps[1], &maps[0]);
+    TEST_CheckUnsupported(&maps[2], &maps[0]);
+    TEST_CheckUnsupported(&maps[1], &maps[2]);
+    TEST_CheckUnsupported(&maps[2], &maps[1]);
+    TEST_CheckImages(&maps[0], &maps[1]);
+    TEST_CheckImages(&maps[0], &maps[2]);
+
+    OPM_DelGFX(&gfx);
+    for (int k = 0; k < 3; k++)
+    {
+        OPM_Del(&sprites[k]);
+        OPM_Del(&maps[k]);
+    }
+    return TESTUTIL_Finish("TEST042");
+}
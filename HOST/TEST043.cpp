@@ -0,0 +1,262 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-043: the whole-block fills and copies, the row reuse of
+ * DSA_StretchOPMToScreen and the single inner fill of
+ * GUI_DrawFilledBackground must give the same pixels as the per-row and
+ * per-pixel code they replaced, which is written out here.
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include "../DSA.h"
+#include "../GUI.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WIDTH 160
+#define TEST_HEIGHT 100
+
+static unsigned int TEST_Color32[256];
+static unsigned short TEST_Color16[256];
+
+static unsigned int TEST_GetNative(OPM_Struct *pixel_map, unsigned char *buffer, int x, int y)
+{
+    unsigned char *pixel;
+
+    pixel = buffer + y * pixel_map->stride + x * pixel_map->bytes_per_pixel;
+    switch (pixel_map->bytes_per_pixel)
+    {
+        case 2:
+        {
+            return *(unsigned short *)pixel;
+        }
+        case 4:
+        {
+            return *(unsigned int *)pixel;
+        }
+        default:
+        {
+            return *pixel;
+        }
+    }
+}
+
+static unsigned int TEST_GetColor(OPM_Struct *pixel_map, unsigned char color)
+{
+    switch (pixel_map->bytes_per_pixel)
+    {
+        case 2:
+        {
+            return TEST_Color16[color];
+        }
+        case 4:
+        {
+            return TEST_Color32[color];
+        }
+        default:
+        {
+            return color;
+        }
+    }
+}
+
+/* Fills and copies of whole rows at every depth, checked pixel by pixel. */
+static void TEST_FillsAndCopies(void)
+{
+    static const int bytes_per_pixel[3] = { 1, 2, 4 };
+    static unsigned char before[TEST_WIDTH * TEST_HEIGHT * 4];
+    OPM_Struct dst, src;
+    int x, y, width, height, src_x, src_y, inside;
+    unsigned char color;
+    unsigned int expected;
+
+    for (int k = 0; k < 3; k++)
+    {
+        OPM_New(TEST_WIDTH, TEST_HEIGHT, bytes_per_pixel[k], &dst, 0);
+        OPM_New(TEST_WIDTH, TEST_HEIGHT, bytes_per_pixel[k], &src, 0);
+        for (int i = 0; i < TEST_WIDTH * TEST_HEIGHT * bytes_per_pixel[k]; i++)
+        {
+            src.buffer[i] = TESTUTIL_Random(256);
+        }
+        for (int round = 0; round < 2000; round++)
+        {
+            for (int i = 0; i < TEST_WIDTH * TEST_HEIGHT * bytes_per_pixel[k]; i++)
+            {
+                dst.buffer[i] = TESTUTIL_Random(256);
+            }
+            memcpy(before, dst.buffer, TEST_WIDTH * TEST_HEIGHT * bytes_per_pixel[k]);
+
+            /* mostly whole rows, so the single block paths are taken */
+            x = TESTUTIL_Random(4) ? 0 : TESTUTIL_Random(TEST_WIDTH);
+            width = x == 0 && TESTUTIL_Random(4) ? TEST_WIDTH : 1 + TESTUTIL_Random(TEST_WIDTH);
+            y = TESTUTIL_Random(TEST_HEIGHT);
+            height = 1 + TESTUTIL_Random(TEST_HEIGHT);
+            src_x = x;
+            src_y = TESTUTIL_Random(TEST_HEIGHT);
+            color = TESTUTIL_Random(256);
+            if (round % 2)
+            {
+                OPM_FillBox(&dst, x, y, width, height, color);
+            }
+            else
+            {
+                OPM_CopyOPMOPM(&src, &dst, src_x, src_y, width, height, x, y);
+            }
+
+            for (int py = 0; py < TEST_HEIGHT; py++)
+            {
+                for (int px = 0; px < TEST_WIDTH; px++)
+                {
+                    inside = px >= x && px < x + width && py >= y && py < y + height;
+                    if (inside && round % 2)
+                    {
+                        expected = TEST_GetColor(&dst, color);
+                    }
+                    else if (inside && src_y + py - y < TEST_HEIGHT)
+                    {
+                        expected = TEST_GetNative(&src, src.buffer, px, src_y + py - y);
+                    }
+                    else
+                    {
+                        expected = TEST_GetNative(&dst, before, px, py);
+                    }
+                    if (TEST_GetNative(&dst, dst.buffer, px, py) != expected)
+                    {
+                        TESTUTIL_Fail("%s of %d,%d %dx%d at %d bytes per pixel differs at %d,%d", round % 2 ? "fill" : "copy", x, y, width, height, bytes_per_pixel[k], px, py);
+                        px = TEST_WIDTH;
+                        py = TEST_HEIGHT;
+                    }
+                }
+            }
+        }
+        OPM_Del(&src);
+        OPM_Del(&dst);
+    }
+}
+
+/* The stretch as it was before the rows were reused. */
+static void TEST_StretchPerPixel(OPM_Struct *src_pixel_map, OPM_Struct *dest_pixel_map)
+{
+    unsigned char *src_pixel;
+    unsigned char *dest_pixel;
+    int step, index;
+
+    for (int i = 0; i < dest_pixel_map->height; i++)
+    {
+        src_pixel = &src_pixel_map->buffer[i * src_pixel_map->height / dest_pixel_map->height * src_pixel_map->stride];
+        dest_pixel = &dest_pixel_map->buffer[i * dest_pixel_map->stride];
+        step = (src_pixel_map->width << 10) / dest_pixel_map->width;
+        index = 0;
+        for (int j = 0; j < dest_pixel_map->width; j++)
+        {
+            dest_pixel[j] = src_pixel[index >> 10];
+            index += step;
+        }
+    }
+}
+
+static void TEST_Stretch(void)
+{
+    OPM_Struct src, expected, stretched;
+    int src_width, src_height, dst_width, dst_height;
+
+    for (int round = 0; round < 1000; round++)
+    {
+        src_width = 1 + TESTUTIL_Random(700);
+        src_height = 1 + TESTUTIL_Random(500);
+        dst_width = round % 4 == 0 ? src_width : 1 + TESTUTIL_Random(700);
+        dst_height = 1 + TESTUTIL_Random(500);
+        OPM_New(src_width, src_height, 1, &src, 0);
+        OPM_New(dst_width, dst_height, 1, &expected, 0);
+        OPM_New(dst_width, dst_height, 1, &stretched, 0);
+        for (int i = 0; i < src_width * src_height; i++)
+        {
+            src.buffer[i] = TESTUTIL_Random(256);
+        }
+        TEST_StretchPerPixel(&src, &expected);
+        DSA_StretchOPMToScreen(&src, &stretched);
+        if (memcmp(expected.buffer, stretched.buffer, dst_width * dst_height))
+        {
+            TESTUTIL_Fail("stretch from %dx%d to %dx%d differs", src_width, src_height, dst_width, dst_height);
+        }
+        OPM_Del(&stretched);
+        OPM_Del(&expected);
+        OPM_Del(&src);
+    }
+}
+
+/* The background as it was drawn before: three embossed areas over each other. */
+static void TEST_Background(void)
+{
+    OPM_Struct expected, drawn;
+    int x, y, width, height;
+
+    OPM_New(320, 200, 1, &expected, 0);
+    OPM_New(320, 200, 1, &drawn, 0);
+    for (int round = 0; round < 20000; round++)
+    {
+        memset(expected.buffer, 7, 320 * 200);
+        memset(drawn.buffer, 7, 320 * 200);
+        x = TESTUTIL_Random(360) - 20;
+        y = TESTUTIL_Random(240) - 20;
+        width = x + TESTUTIL_Random(round % 2 ? 20 : 300) - 3;
+        height = y + TESTUTIL_Random(round % 2 ? 20 : 200) - 3;
+        if (width > x && height > y)
+        {
+            GUI_DrawEmbossedArea(&expected, x, y, width, height, 1, 2, 3);
+            GUI_DrawEmbossedArea(&expected, x + 3, y + 3, width - 3, height - 3, 3, 2, 1);
+            GUI_DrawEmbossedArea(&expected, x + 4, y + 4, width - 4, height - 4, 4, 4, 4);
+        }
+        GUI_DrawFilledBackground(&drawn, x, y, width, height, 1, 2, 3, 4);
+        if (memcmp(expected.buffer, drawn.buffer, 320 * 200))
+        {
+            TESTUTIL_Fail("background %d,%d - %d,%d differs", x, y, width, height);
+        }
+    }
+    OPM_Del(&drawn);
+    OPM_Del(&expected);
+}
+
+int main(void)
+{
+    unsigned char red, green, blue;
+
+    srand(43);
+    for (int i = 0; i < 256; i++)
+    {
+        red = TESTUTIL_Random(256);
+        green = TESTUTIL_Random(256);
+        blue = TESTUTIL_Random(256);
+        OPM_SetPaletteEntry(i, red, green, blue);
+        TEST_Color32[i] = (red << 16) | (green << 8) | blue;
+        TEST_Color16[i] = ((red & 0xF8) << 8) | ((green & 0xFC) << 3) | (blue >> 3);
+    }
+
+    TEST_FillsAndCopies();
+    TEST_Stretch();
+    TEST_Background();
+    return TESTUTIL_Finish("TEST043");
+}
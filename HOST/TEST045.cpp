@@ -0,0 +1,210 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-045: drawing through a display list, which redraws only the
+ * commands that changed since the last execution, must leave the same
+ * pixels as drawing every command directly each frame. A list that did
+ * not change must not draw at all.
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include "../GUI.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 200
+#define TEST_SCREENS 400
+#define TEST_FRAMES 6
+#define TEST_MAX_OPERATIONS 60
+
+typedef struct
+{
+    int type;
+    int x0, y0, x1, y1;
+    unsigned char color0, color1, color2, color3;
+    char text[32];
+} TEST_OperationStruct;
+
+static void TEST_Run(TEST_OperationStruct *operations, int number_of_operations, OPM_Struct *pixel_map)
+{
+    TEST_OperationStruct *op;
+
+    for (int i = 0; i < number_of_operations; i++)
+    {
+        op = &operations[i];
+        switch (op->type)
+        {
+            case 0:
+            {
+                GUI_DrawEmbossedArea(pixel_map, op->x0, op->y0, op->x1, op->y1, op->color0, op->color1, op->color2);
+                break;
+            }
+            case 1:
+            {
+                GUI_DrawFrame(pixel_map, op->x0, op->y0, op->x1, op->y1, op->color0);
+                break;
+            }
+            case 2:
+            {
+                GUI_DrawFilledBackground(pixel_map, op->x0, op->y0, op->x1, op->y1, op->color0, op->color1, op->color2, op->color3);
+                break;
+            }
+            case 3:
+            {
+                GUI_DrawArrow(pixel_map, op->x0, op->y0, op->color0, op->x1 & 1 ? 1 : -1);
+                break;
+            }
+            case 4:
+            {
+                GUI_DrawButton(pixel_map, op->x0, op->y0, op->x1, op->y1, op->color0);
+                break;
+            }
+            default:
+            {
+                GUI_PrintText(op->text, op->color0, pixel_map, op->x0, op->y0, op->x1, op->y1);
+                break;
+            }
+        }
+    }
+}
+
+static void TEST_RandomOperation(TEST_OperationStruct *op)
+{
+    int length;
+
+    op->type = TESTUTIL_Random(6);
+    op->x0 = TESTUTIL_Random(360) - 20;
+    op->y0 = TESTUTIL_Random(240) - 20;
+    op->x1 = op->x0 + TESTUTIL_Random(200) - 5;
+    op->y1 = op->y0 + TESTUTIL_Random(120) - 5;
+    op->color0 = TESTUTIL_Random(256);
+    op->color1 = TESTUTIL_Random(256);
+    op->color2 = TESTUTIL_Random(256);
+    op->color3 = TESTUTIL_Random(256);
+    length = TESTUTIL_Random(30);
+    for (int i = 0; i < length; i++)
+    {
+        op->text[i] = TESTUTIL_Random(4) == 0 ? ' ' : 'a' + TESTUTIL_Random(26);
+    }
+    op->text[length] = 0;
+}
+
+static long TEST_DirtyArea(OPM_Struct *pixel_map)
+{
+    long area;
+
+    area = 0;
+    for (int i = 0; i < pixel_map->number_of_dirty_rects; i++)
+    {
+        area += (long)(pixel_map->dirty_rects[i].x1 - pixel_map->dirty_rects[i].x0) * (pixel_map->dirty_rects[i].y1 - pixel_map->dirty_rects[i].y0);
+    }
+    return area;
+}
+
+int main(void)
+{
+    OPM_Struct direct, listed;
+    TEST_OperationStruct operations[TEST_MAX_OPERATIONS];
+    TEST_OperationStruct *op;
+    GUI_DisplayListStruct list;
+    int number_of_operations;
+    long direct_area, listed_area;
+
+    srand(45);
+    OPM_New(TEST_WIDTH, TEST_HEIGHT, 1, &direct, 0);
+    OPM_New(TEST_WIDTH, TEST_HEIGHT, 1, &listed, 0);
+    direct_area = 0;
+    listed_area = 0;
+
+    for (int screen = 0; screen < TEST_SCREENS; screen++)
+    {
+        memset(&list, 0, sizeof(list));
+        number_of_operations = 1 + TESTUTIL_Random(TEST_MAX_OPERATIONS);
+        for (int i = 0; i < number_of_operations; i++)
+        {
+            TEST_RandomOperation(&operations[i]);
+        }
+        for (int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++)
+        {
+            direct.buffer[i] = listed.buffer[i] = TESTUTIL_Random(256);
+        }
+
+        for (int frame = 0; frame < TEST_FRAMES; frame++)
+        {
+            /* change a few commands between frames: a color, a letter or a position */
+            for (int i = frame ? TESTUTIL_Random(3) : 0; i > 0; i--)
+            {
+                op = &operations[TESTUTIL_Random(number_of_operations)];
+                if (TESTUTIL_Random(2))
+                {
+                    op->color0 = TESTUTIL_Random(256);
+                }
+                else if (op->type == 5)
+                {
+                    op->text[0] = 'a' + TESTUTIL_Random(26);
+                }
+                else
+                {
+                    op->x0 += TESTUTIL_Random(5) - 2;
+                }
+            }
+
+            OPM_ClearDirtyRects(&direct);
+            TEST_Run(operations, number_of_operations, &direct);
+            direct_area += TEST_DirtyArea(&direct);
+
+            OPM_ClearDirtyRects(&listed);
+            GUI_BeginDisplayList(&list);
+            TEST_Run(operations, number_of_operations, &listed);
+            GUI_EndDisplayList();
+            GUI_ExecuteDisplayList(&list, &listed);
+            listed_area += TEST_DirtyArea(&listed);
+
+            if (memcmp(direct.buffer, listed.buffer, TEST_WIDTH * TEST_HEIGHT))
+            {
+                TESTUTIL_Fail("screen %d frame %d: the display list differs from drawing directly", screen, frame);
+            }
+        }
+
+        /* the same commands again draw nothing */
+        OPM_ClearDirtyRects(&listed);
+        GUI_BeginDisplayList(&list);
+        TEST_Run(operations, number_of_operations, &listed);
+        GUI_EndDisplayList();
+        GUI_ExecuteDisplayList(&list, &listed);
+        if (listed.number_of_dirty_rects != 0)
+        {
+            TESTUTIL_Fail("screen %d: an unchanged display list drew %ld pixels", screen, TEST_DirtyArea(&listed));
+        }
+        GUI_DelDisplayList(&list);
+    }
+
+    printf("TEST045: the display lists touched %.1f%% of the area drawing directly touched\n", 100.0 * listed_area / direct_area);
+    OPM_Del(&listed);
+    OPM_Del(&direct);
+    return TESTUTIL_Finish("TEST045");
+}
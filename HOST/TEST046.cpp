@@ -0,0 +1,372 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-046: OPM_RemapBox must map every 8 bit pixel to the palette
+ * index nearest to its shaded color and scale 16 and 32 bit pixels
+ * directly. Drop shadows recorded in a display list must be applied
+ * once, also when recording runs out of memory; realloc is wrapped
+ * for that (see the Makefile).
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include "../GUI.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 200
+
+static unsigned char TEST_Palette[256][3];
+
+/* Failing reallocs: one in TEST_FailRate once the recorded list holds TEST_FailAfter commands. */
+static GUI_DisplayListStruct *TEST_FailList;
+static int TEST_FailAfter;
+static int TEST_FailRate;
+
+extern "C" void *__real_realloc(void *ptr, size_t size);
+
+extern "C" void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (TEST_FailList && TEST_FailList->buffers[TEST_FailList->current].number_of_commands >= TEST_FailAfter && TESTUTIL_Random(TEST_FailRate) == 0)
+    {
+        return NULL;
+    }
+    return __real_realloc(ptr, size);
+}
+
+static int TEST_Shade(int component, int level)
+{
+    if (level <= OPM_SHADE_NORMAL)
+    {
+        return component * level / OPM_SHADE_NORMAL;
+    }
+    return component + (255 - component) * (level - OPM_SHADE_NORMAL) / OPM_SHADE_NORMAL;
+}
+
+static int TEST_Scale(int component, int max, int level)
+{
+    if (level <= OPM_SHADE_NORMAL)
+    {
+        return component * level / OPM_SHADE_NORMAL;
+    }
+    return component + (max - component) * (level - OPM_SHADE_NORMAL) / OPM_SHADE_NORMAL;
+}
+
+static int TEST_Distance(int index, int red, int green, int blue)
+{
+    int r, g, b;
+
+    r = TEST_Palette[index][0] - red;
+    g = TEST_Palette[index][1] - green;
+    b = TEST_Palette[index][2] - blue;
+    return 3 * r * r + 4 * g * g + 2 * b * b;
+}
+
+static void TEST_Remap8(void)
+{
+    OPM_Struct pixel_map;
+    unsigned char before[37 * 11];
+    int x, y, width, height, inside, red, green, blue, best, old;
+
+    OPM_New(37, 11, 1, &pixel_map, 0);
+    for (int level = 0; level < OPM_SHADE_LEVELS; level++)
+    {
+        for (int i = 0; i < 37 * 11; i++)
+        {
+            pixel_map.buffer[i] = i;
+        }
+        memcpy(before, pixel_map.buffer, sizeof(before));
+        x = TESTUTIL_Random(10) - 3;
+        y = TESTUTIL_Random(5) - 2;
+        width = TESTUTIL_Random(40);
+        height = TESTUTIL_Random(14);
+        OPM_RemapBox(&pixel_map, x, y, width, height, level);
+
+        for (int i = 0; i < 37 * 11; i++)
+        {
+            old = before[i];
+            inside = i % 37 >= x && i % 37 < x + width && i / 37 >= y && i / 37 < y + height && level != OPM_SHADE_NORMAL;
+            if (!inside)
+            {
+                if (pixel_map.buffer[i] != old)
+                {
+                    TESTUTIL_Fail("level %d: pixel %d,%d outside %d,%d %dx%d changed", level, i % 37, i / 37, x, y, width, height);
+                }
+                continue;
+            }
+            red = TEST_Shade(TEST_Palette[old][0], level);
+            green = TEST_Shade(TEST_Palette[old][1], level);
+            blue = TEST_Shade(TEST_Palette[old][2], level);
+            best = 0x7FFFFFFF;
+            for (int j = 0; j < 256; j++)
+            {
+                if (TEST_Distance(j, red, green, blue) < best)
+                {
+                    best = TEST_Distance(j, red, green, blue);
+                }
+            }
+            if (TEST_Distance(pixel_map.buffer[i], red, green, blue) != best)
+            {
+                TESTUTIL_Fail("level %d: index %d is not shaded to the nearest color", level, old);
+            }
+        }
+    }
+    OPM_Del(&pixel_map);
+}
+
+static void TEST_RemapTrueColor(int bytes_per_pixel)
+{
+    OPM_Struct pixel_map;
+    unsigned char before[23 * 9 * 4];
+    unsigned int old, now, expected;
+    int level, inside;
+
+    OPM_New(23, 9, bytes_per_pixel, &pixel_map, 0);
+    for (int i = 0; i < 23 * 9 * bytes_per_pixel; i++)
+    {
+        pixel_map.buffer[i] = TESTUTIL_Random(256);
+    }
+    memcpy(before, pixel_map.buffer, 23 * 9 * bytes_per_pixel);
+    level = TESTUTIL_Random(OPM_SHADE_LEVELS);
+    OPM_RemapBox(&pixel_map, 2, 1, 15, 6, level);
+
+    for (int i = 0; i < 23 * 9; i++)
+    {
+        if (bytes_per_pixel == 2)
+        {
+            old = ((unsigned short *)before)[i];
+            now = ((unsigned short *)pixel_map.buffer)[i];
+        }
+        else
+        {
+            old = ((unsigned int *)before)[i];
+            now = ((unsigned int *)pixel_map.buffer)[i];
+        }
+        inside = i % 23 >= 2 && i % 23 < 17 && i / 23 >= 1 && i / 23 < 7 && level != OPM_SHADE_NORMAL;
+        if (!inside)
+        {
+            expected = old;
+        }
+        else if (bytes_per_pixel == 2)
+        {
+            expected = (TEST_Scale(old >> 11, 31, level) << 11) | (TEST_Scale((old >> 5) & 63, 63, level) << 5) | TEST_Scale(old & 31, 31, level);
+        }
+        else
+        {
+            expected = (old & 0xFF000000) | (TEST_Shade((old >> 16) & 255, level) << 16) | (TEST_Shade((old >> 8) & 255, level) << 8) | TEST_Shade(old & 255, level);
+        }
+        if (now != expected)
+        {
+            TESTUTIL_Fail("level %d at %d bytes per pixel: %x became %x instead of %x", level, bytes_per_pixel, old, now, expected);
+        }
+    }
+    OPM_Del(&pixel_map);
+}
+
+typedef struct
+{
+    int type;
+    int x0, y0, x1, y1;
+    unsigned char color0, color1, color2, color3;
+    char text[32];
+} TEST_OperationStruct;
+
+static void TEST_Run(TEST_OperationStruct *op, OPM_Struct *pixel_map)
+{
+    switch (op->type)
+    {
+        case 0:
+        {
+            GUI_DrawDropShadow(pixel_map, op->x0, op->y0, op->x1, op->y1);
+            break;
+        }
+        case 1:
+        {
+            GUI_DrawEmbossedArea(pixel_map, op->x0, op->y0, op->x1, op->y1, op->color0, op->color1, op->color2);
+            break;
+        }
+        case 2:
+        {
+            GUI_DrawFrame(pixel_map, op->x0, op->y0, op->x1, op->y1, op->color0);
+            break;
+        }
+        case 3:
+        {
+            GUI_DrawFilledBackground(pixel_map, op->x0, op->y0, op->x1, op->y1, op->color0, op->color1, op->color2, op->color3);
+            break;
+        }
+        case 4:
+        {
+            GUI_DrawButton(pixel_map, op->x0, op->y0, op->x1, op->y1, op->color0);
+            break;
+        }
+        default:
+        {
+            GUI_PrintText(op->text, op->color0, pixel_map, op->x0, op->y0, op->x1, op->y1);
+            break;
+        }
+    }
+}
+
+static void TEST_RandomOperation(TEST_OperationStruct *op)
+{
+    int length;
+
+    op->type = TESTUTIL_Random(6);
+    if (op->type == 0)
+    {
+        /* shadows stay left of everything else, so the other commands never cover them */
+        op->x0 = TESTUTIL_Random(80) - 20;
+        op->y0 = TESTUTIL_Random(240) - 20;
+        op->x1 = op->x0 + TESTUTIL_Random(30);
+        op->y1 = op->y0 + TESTUTIL_Random(60);
+    }
+    else
+    {
+        op->x0 = TESTUTIL_Random(200) + 120;
+        op->y0 = TESTUTIL_Random(240) - 20;
+        op->x1 = op->x0 + TESTUTIL_Random(200) - 5;
+        op->y1 = op->y0 + TESTUTIL_Random(120) - 5;
+    }
+    op->color0 = TESTUTIL_Random(256);
+    op->color1 = TESTUTIL_Random(256);
+    op->color2 = TESTUTIL_Random(256);
+    op->color3 = TESTUTIL_Random(256);
+    length = TESTUTIL_Random(30);
+    for (int i = 0; i < length; i++)
+    {
+        op->text[i] = TESTUTIL_Random(4) == 0 ? ' ' : 'a' + TESTUTIL_Random(26);
+    }
+    op->text[length] = 0;
+}
+
+/* Shadows are drawn once and never change; the other commands change between frames and are redrawn directly. Through
+   a display list, which is recorded completely every frame, the shadows must not get darker. */
+static void TEST_Shadows(int fail_rate)
+{
+    OPM_Struct direct, listed;
+    TEST_OperationStruct operations[60];
+    TEST_OperationStruct swap;
+    TEST_OperationStruct *op;
+    GUI_DisplayListStruct list;
+    int number_of_operations, number_of_shadows;
+
+    OPM_New(TEST_WIDTH, TEST_HEIGHT, 1, &direct, 0);
+    OPM_New(TEST_WIDTH, TEST_HEIGHT, 1, &listed, 0);
+    TEST_FailRate = fail_rate;
+    for (int screen = 0; screen < 400; screen++)
+    {
+        memset(&list, 0, sizeof(list));
+        number_of_operations = 1 + TESTUTIL_Random(60);
+        number_of_shadows = 0;
+        for (int i = 0; i < number_of_operations; i++)
+        {
+            TEST_RandomOperation(&operations[i]);
+            if (operations[i].type == 0)
+            {
+                swap = operations[i];
+                operations[i] = operations[number_of_shadows];
+                operations[number_of_shadows++] = swap;
+            }
+        }
+        for (int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++)
+        {
+            direct.buffer[i] = listed.buffer[i] = TESTUTIL_Random(256);
+        }
+
+        for (int frame = 0; frame < 6; frame++)
+        {
+            for (int i = frame ? TESTUTIL_Random(3) : 0; i > 0; i--)
+            {
+                op = &operations[TESTUTIL_Random(number_of_operations)];
+                if (op->type == 0)
+                {
+                    continue;
+                }
+                if (TESTUTIL_Random(2))
+                {
+                    op->color0 = TESTUTIL_Random(256);
+                }
+                else if (op->type == 5)
+                {
+                    op->text[0] = 'a' + TESTUTIL_Random(26);
+                }
+                else
+                {
+                    op->x0 += TESTUTIL_Random(5) - 2;
+                }
+            }
+
+            for (int i = frame ? number_of_shadows : 0; i < number_of_operations; i++)
+            {
+                TEST_Run(&operations[i], &direct);
+            }
+
+            /* a shadow remap takes two commands; memory only runs out after those are recorded */
+            TEST_FailAfter = 2 * number_of_shadows;
+            GUI_BeginDisplayList(&list);
+            TEST_FailList = fail_rate ? &list : NULL;
+            for (int i = 0; i < number_of_operations; i++)
+            {
+                TEST_Run(&operations[i], &listed);
+            }
+            TEST_FailList = NULL;
+            GUI_EndDisplayList();
+            GUI_ExecuteDisplayList(&list, &listed);
+
+            if (memcmp(direct.buffer, listed.buffer, TEST_WIDTH * TEST_HEIGHT))
+            {
+                TESTUTIL_Fail("screen %d frame %d%s: the display list differs from drawing directly", screen, frame, fail_rate ? " without memory" : "");
+            }
+        }
+        GUI_DelDisplayList(&list);
+    }
+    OPM_Del(&listed);
+    OPM_Del(&direct);
+}
+
+int main(void)
+{
+    srand(46);
+    for (int round = 0; round < 30; round++)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                TEST_Palette[i][c] = round % 3 == 0 ? (TESTUTIL_Random(256) & 0xFC) : TESTUTIL_Random(256);
+            }
+            OPM_SetPaletteEntry(i, TEST_Palette[i][0], TEST_Palette[i][1], TEST_Palette[i][2]);
+        }
+        TEST_Remap8();
+        TEST_RemapTrueColor(2);
+        TEST_RemapTrueColor(4);
+    }
+
+    TEST_Shadows(0);
+    TEST_Shadows(40);
+    return TESTUTIL_Finish("TEST046");
+}
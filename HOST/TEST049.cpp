@@ -0,0 +1,97 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-049: presenting through the emulated VESA window, which moves
+ * only for rows that are not in it yet, must leave the same frame as
+ * the linear present, with and without page flipping. Without page
+ * flipping the window must only move forward and never more often
+ * than there are granules to write.
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include "../DSA.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_GRANULARITY 0x1000 /* window granularity and size of the emulated card, see DSA_OpenScreen */
+#define TEST_WINDOW_SIZE 0x10000
+
+extern unsigned int DSA_Screen_Stride;
+
+/*
+ * Whether presenting the dirty rectangles of 'pixel_map' may take
+ * 'window_moves' window moves: no more than the number of granules they
+ * touch, and, as a window that only moves forward starts each time past
+ * the end of the last one, no more than the windows that fit between
+ * their first and their last byte.
+ */
+static int TEST_CheckMoves(const OPM_Struct *pixel_map, unsigned int window_moves)
+{
+    static unsigned char touched[1024];
+    const OPM_RectStruct *rect;
+    unsigned int number_of_granules;
+    unsigned int first_byte;
+    unsigned int last_byte;
+    unsigned int first;
+    unsigned int last;
+
+    memset(touched, 0, sizeof(touched));
+    number_of_granules = 0;
+    first_byte = ~0u;
+    last_byte = 0;
+    for (int i = 0; i < pixel_map->number_of_dirty_rects; i++)
+    {
+        rect = &pixel_map->dirty_rects[i];
+        for (int y = rect->y0; y < rect->y1; y++)
+        {
+            first = y * DSA_Screen_Stride + rect->x0;
+            last = y * DSA_Screen_Stride + rect->x1 - 1;
+            first_byte = first < first_byte ? first : first_byte;
+            last_byte = last > last_byte ? last : last_byte;
+            for (unsigned int granule = first / TEST_GRANULARITY; granule <= last / TEST_GRANULARITY; granule++)
+            {
+                number_of_granules += !touched[granule];
+                touched[granule] = 1;
+            }
+        }
+    }
+    if (number_of_granules == 0)
+    {
+        return window_moves == 0;
+    }
+    return window_moves <= number_of_granules && window_moves <= 1 + (last_byte - first_byte + TEST_GRANULARITY - 1) / TEST_WINDOW_SIZE;
+}
+
+int main(void)
+{
+    srand(49);
+    TESTUTIL_Present(640, 480, 0, NULL);
+    for (int i = 0; i < 3; i++)
+    {
+        TESTUTIL_Present(640, 480, DSA_METHOD_BANKED | (i >= 1 ? DSA_METHOD_PAGE_FLIP : 0) | (i == 2 ? DSA_METHOD_TRIPLE_BUFFER : 0), TEST_CheckMoves);
+        TESTUTIL_Present(320, 200, DSA_METHOD_BANKED | (i >= 1 ? DSA_METHOD_PAGE_FLIP : 0) | (i == 2 ? DSA_METHOD_TRIPLE_BUFFER : 0), TEST_CheckMoves);
+    }
+    return TESTUTIL_Finish("TEST049");
+}
@@ -0,0 +1,52 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * user-050: presenting through the emulated planes of an unchained VGA
+ * mode, four pixels at a time, must leave the same frame as the linear
+ * present, with and without page flipping. Without page flipping each
+ * plane must be selected once per dirty rectangle.
+ *************************************************************************/
+
+#include "TESTUTIL.h"
+#include "../DSA.h"
+#include <stdlib.h>
+
+/* Whether presenting the dirty rectangles of 'pixel_map' selected each of the four planes once per rectangle. */
+static int TEST_CheckPlaneSelects(const OPM_Struct *pixel_map, unsigned int plane_selects)
+{
+    return plane_selects == 4 * (unsigned int)pixel_map->number_of_dirty_rects;
+}
+
+int main(void)
+{
+    srand(50);
+    TESTUTIL_Present(320, 200, 0, NULL);
+    for (int i = 0; i < 3; i++)
+    {
+        TESTUTIL_Present(320, 200, DSA_METHOD_PLANAR | (i >= 1 ? DSA_METHOD_PAGE_FLIP : 0) | (i == 2 ? DSA_METHOD_TRIPLE_BUFFER : 0), TEST_CheckPlaneSelects);
+        TESTUTIL_Present(360, 240, DSA_METHOD_PLANAR | (i >= 1 ? DSA_METHOD_PAGE_FLIP : 0) | (i == 2 ? DSA_METHOD_TRIPLE_BUFFER : 0), TEST_CheckPlaneSelects);
+    }
+    return TESTUTIL_Finish("TEST050");
+}
@@ -0,0 +1,170 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "TESTUTIL.h"
+#include "../DSA.h"
+#include "../DSAHOST.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#define TESTUTIL_MAX_REPORTED 10
+#define TESTUTIL_PRESENT_FRAMES 300
+
+unsigned int TESTUTIL_NumberOfFailures;
+
+/* A number from 0 to 'range' - 1. */
+int TESTUTIL_Random(int range)
+{
+    return rand() % range;
+}
+
+/* Count a failure. Only the first few are printed. */
+void TESTUTIL_Fail(const char *format, ...)
+{
+    va_list arglist;
+
+    if (TESTUTIL_NumberOfFailures++ < TESTUTIL_MAX_REPORTED)
+    {
+        va_start(arglist, format);
+        vprintf(format, arglist);
+        va_end(arglist);
+        printf("\n");
+    }
+}
+
+/* Print the result and return the exit code of the test. */
+int TESTUTIL_Finish(const char *name)
+{
+    if (TESTUTIL_NumberOfFailures)
+    {
+        printf("%s: FAILED, %u failures\n", name, TESTUTIL_NumberOfFailures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+/* Open 'pixel_map' as the screen of the host backend with a random palette and without a mouse cursor. */
+int TESTUTIL_OpenScreen(OPM_Struct *pixel_map, int method)
+{
+    DSAHOST_SetSink(DSAHOST_SINK_NONE, "");
+    if (!DSA_OpenScreen(pixel_map, DSA_METHOD_HOST | method))
+    {
+        return 0;
+    }
+    DSA_MouseUpdateFlag = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        DSA_SetPalEntry(i, rand(), rand(), rand());
+    }
+    DSA_ActivatePal();
+    return 1;
+}
+
+/* Whether the visible framebuffer shows 'pixel_map' through the current palette. */
+int TESTUTIL_IsScreenEqual(OPM_Struct *pixel_map)
+{
+    LBM_PaletteEntry *pal_entry;
+    unsigned int *frame;
+    unsigned char *src;
+
+    pal_entry = DSA_globalParams.global_palette_data->pal_entry;
+    for (int y = 0; y < pixel_map->height; y++)
+    {
+        src = pixel_map->buffer + y * pixel_map->stride;
+        frame = DSAHOST_FrameBuffer + y * pixel_map->width;
+        for (int x = 0; x < pixel_map->width; x++)
+        {
+            if (frame[x] != (((unsigned int)pal_entry[src[x]].peRed << 16) | ((unsigned int)pal_entry[src[x]].peGreen << 8) | pal_entry[src[x]].peBlue))
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Draw random boxes into a 'width' x 'height' main OPM and present them through 'method' of the host screen, with a
+   forced full present now and then. The screen has to show the main OPM after every present, and 'check_moves', if
+   given, has to accept the window moves of every present that is neither forced nor flipped. A flipped present also
+   copies what changed in the frames before, so its moves do not follow from the dirty rectangles of the main OPM. */
+void TESTUTIL_Present(int width, int height, int method, TESTUTIL_CheckMovesFunc check_moves)
+{
+    OPM_Struct screen;
+    OPM_Struct presented;
+    unsigned int moves;
+    int full;
+
+    OPM_New(width, height, 1, &screen, 0);
+    if (!TESTUTIL_OpenScreen(&screen, method))
+    {
+        TESTUTIL_Fail("%dx%d method %x: cannot open the host screen", width, height, method);
+        OPM_Del(&screen);
+        return;
+    }
+    DSA_CopyMainOPMToScreen(1);
+    if (!TESTUTIL_IsScreenEqual(&screen))
+    {
+        TESTUTIL_Fail("%dx%d method %x: the full present differs", width, height, method);
+    }
+    for (int frame = 0; frame < TESTUTIL_PRESENT_FRAMES; frame++)
+    {
+        for (int i = TESTUTIL_Random(4); i > 0; i--)
+        {
+            OPM_FillBox(&screen, TESTUTIL_Random(width) - 20, TESTUTIL_Random(height) - 20, 1 + TESTUTIL_Random(width / 4), 1 + TESTUTIL_Random(height / 4), TESTUTIL_Random(256));
+        }
+        full = frame % 50 == 7;
+        presented = screen;
+        moves = DSAHOST_WindowMoves;
+        DSA_CopyMainOPMToScreen(full);
+        moves = DSAHOST_WindowMoves - moves;
+        if (!TESTUTIL_IsScreenEqual(&screen))
+        {
+            TESTUTIL_Fail("%dx%d method %x: frame %d differs", width, height, method, frame);
+        }
+        if (check_moves && !full && !(method & DSA_METHOD_PAGE_FLIP) && !check_moves(&presented, moves))
+        {
+            TESTUTIL_Fail("%dx%d method %x: frame %d took %u window moves for %d dirty rectangles", width, height, method, frame, moves, presented.number_of_dirty_rects);
+        }
+    }
+    DSA_CloseScreen();
+    OPM_Del(&screen);
+}
+
+/* Whether pixel ('x', 'y') lies in one of the dirty rectangles of 'pixel_map'. */
+int TESTUTIL_IsInDirtyRects(OPM_Struct *pixel_map, int x, int y)
+{
+    OPM_RectStruct *rect;
+
+    for (int i = 0; i < pixel_map->number_of_dirty_rects; i++)
+    {
+        rect = &pixel_map->dirty_rects[i];
+        if (x >= rect->x0 && x < rect->x1 && y >= rect->y0 && y < rect->y1)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
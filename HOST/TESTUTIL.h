@@ -0,0 +1,48 @@
+/**
+ *
+ *  Copyright (C) 2021 Fabian Ringpfeil
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of
+ *  this software and associated documentation files (the "Software"), to deal in
+ *  the Software without restriction, including without limitation the rights to
+ *  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is furnished to do
+ *  so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/*************************************************************************
+ * Helpers shared by the TEST programs: failure counting and a host
+ * screen whose framebuffer can be checked against the main OPM.
+ *************************************************************************/
+
+#ifndef TESTUTIL_H
+#define TESTUTIL_H
+
+#include "../OPM.h"
+
+/* Whether presenting the dirty rectangles of 'pixel_map' may take 'window_moves' window moves or plane selects. */
+typedef int (*TESTUTIL_CheckMovesFunc)(const OPM_Struct *pixel_map, unsigned int window_moves);
+
+extern unsigned int TESTUTIL_NumberOfFailures;
+
+extern int TESTUTIL_Random(int range);
+extern void TESTUTIL_Fail(const char *format, ...);
+extern int TESTUTIL_Finish(const char *name);
+extern int TESTUTIL_OpenScreen(OPM_Struct *pixel_map, int method);
+extern int TESTUTIL_IsScreenEqual(OPM_Struct *pixel_map);
+extern void TESTUTIL_Present(int width, int height, int method, TESTUTIL_CheckMovesFunc check_moves);
+extern int TESTUTIL_IsInDirtyRects(OPM_Struct *pixel_map, int x, int y);
+
+#endif /* TESTUTIL_H */
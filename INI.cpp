@@ -22,6 +22,8 @@
  *
  */
 
+#include "ERROR.h"
+#include "INI.h"
 #include "FILE.h"
 #include "SETUP.h"
 #include "DPMI.h"
@@ -35,94 +37,435 @@
 #include <ctype.h>
 #include <dos.h>
 #include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define INI_LINE_OTHER 0   /* empty lines, comments and anything else that is neither a section nor an entry */
+#define INI_LINE_SECTION 1 /* [SECTION] */
+#define INI_LINE_ENTRY 2   /* ITEM=VALUE */
+
+#define INI_HASH_EMPTY -1
+
+#define INI_STAGED_ENTRIES_STEP 32
+
+/* One line of the loaded INI file. Names and values are views into INI_Model.buffer and are not zero-terminated. */
+typedef struct
+{
+    const char *text;   /* start of the raw line */
+    unsigned int length; /* length of the raw line including its line terminator */
+    const char *name;   /* section name or entry key */
+    unsigned int name_length;
+    const char *value;  /* entry value */
+    unsigned int value_length;
+    unsigned int hash;  /* case-insensitive hash of the name (entries: combined with their section) */
+    int section;        /* index of the owning section line or -1 for lines before the first section */
+    unsigned char type;
+} INI_LineStruct;
+
+typedef struct
+{
+    char path[144];
+    time_t mtime;
+    long size;
+    char *buffer;
+    unsigned int number_of_lines;
+    INI_LineStruct *lines;
+    unsigned int hash_mask;
+    int *hash_table;    /* line indices of all sections and entries, open addressing */
+    int is_loaded;
+} INI_ModelStruct;
+
+/* A change staged by the current INI transaction. */
+typedef struct
+{
+    char category[32];
+    char item[48];
+    char value[144];
+    int section;        /* line index of the category in the loaded INI file or -1, valid while writing */
+    unsigned char is_delete;
+    unsigned char is_applied;
+} INI_StagedEntryStruct;
+
+typedef struct
+{
+    const char *text;
+    unsigned int data1;
+    unsigned int data2;
+} INI_ErrorStruct;
+
+static int INI_StageEntry(const char *category, const char *item, const char *value, int is_delete);
+static int INI_FinishTransaction(const char *text, int staged);
+static int INI_WriteStagedItem(FILE *fp, const INI_StagedEntryStruct *entry, const char *newline);
+static int INI_WriteStagedEntries(void);
+static void INI_LocalPrintError(char *buffer, const char *data);
+static unsigned int INI_HashName(const char *name, unsigned int length);
+static int INI_CompareName(const INI_LineStruct *line, const char *name, unsigned int length);
+static void INI_FreeModel(void);
+static int INI_LoadModel(void);
+static void INI_ParseLine(INI_LineStruct *line, int section);
+static int INI_FindSection(const char *category);
+static int INI_FindItem(int section, const char *item);
 
 unsigned char INI_ReadBuffer[100];
 unsigned char INI_WriteBuffer[119];
 
-bool INI_ParseEntry(const char *category, const char *item, unsigned char *buffer, int length)
+static INI_ModelStruct INI_Model;
+static INI_StagedEntryStruct *INI_StagedEntries;
+static int INI_NumberOfStagedEntries;
+static int INI_MaxStagedEntries;
+static int INI_TransactionDepth;
+
+/* Case-insensitive FNV-1a hash of a section name or entry key. */
+static unsigned int INI_HashName(const char *name, unsigned int length)
 {
-    FILE *fp;
-    char local_buffer[200];
-    char *ptr_local_buffer;
-    bool category_found = 0;
-    bool retVal = 0;
+    unsigned int hash = 2166136261u;
 
-    unsigned int line_length;
-    unsigned int string_length;
-    unsigned int category_length;
-    unsigned int item_length;
+    while (length--)
+    {
+        hash ^= (unsigned char)toupper(*name++);
+        hash *= 16777619u;
+    }
 
-    memset(buffer, 0, length);
+    return hash;
+}
+
+static int INI_CompareName(const INI_LineStruct *line, const char *name, unsigned int length)
+{
+    return line->name_length == length && !strnicmp(line->name, name, length);
+}
+
+static void INI_FreeModel(void)
+{
+    if (INI_Model.buffer)
+    {
+        free(INI_Model.buffer);
+    }
+    if (INI_Model.lines)
+    {
+        free(INI_Model.lines);
+    }
+    if (INI_Model.hash_table)
+    {
+        free(INI_Model.hash_table);
+    }
+    memset(&INI_Model, 0, sizeof(INI_Model));
+}
+
+/* Force the next lookup to reload the INI file, e.g. after it has been rewritten. */
+void INI_InvalidateModel(void)
+{
+    INI_FreeModel();
+}
+
+/* Split a raw line into its type, name and value. Leading and trailing white space is not part of names or values. */
+static void INI_ParseLine(INI_LineStruct *line, int section)
+{
+    const char *ptr = line->text;
+    const char *end = line->text + line->length;
+    const char *separator;
+
+    line->type = INI_LINE_OTHER;
+    line->section = section;
+
+    while (end > ptr && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+    {
+        end--;
+    }
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+    {
+        ptr++;
+    }
+    if (ptr == end || *ptr == ';')
+    {
+        return;
+    }
 
-    fp = fopen((const char *)&INI_WriteBuffer, "rt");
-    if (!fp)
+    if (*ptr == '[')
     {
+        separator = (const char *)memchr(ptr, ']', end - ptr);
+        line->type = INI_LINE_SECTION;
+        line->name = ptr + 1;
+        line->name_length = (separator ? separator : end) - line->name;
+        line->section = -1;
+        return;
+    }
+
+    separator = (const char *)memchr(ptr, '=', end - ptr);
+    line->type = INI_LINE_ENTRY;
+    line->name = ptr;
+    if (separator)
+    {
+        line->name_length = separator - ptr;
+        line->value = separator + 1;
+        while (line->value < end && (*line->value == ' ' || *line->value == '\t'))
+        {
+            line->value++;
+        }
+        line->value_length = end - line->value;
+    }
+    else
+    {
+        line->name_length = end - ptr;
+        line->value = end;
+        line->value_length = 0;
+    }
+    while (line->name_length && (ptr[line->name_length - 1] == ' ' || ptr[line->name_length - 1] == '\t'))
+    {
+        line->name_length--;
+    }
+}
+
+/* Load the INI file named in INI_WriteBuffer into the index unless the loaded copy is still current. */
+static int INI_LoadModel(void)
+{
+    struct stat file_status;
+    int file_handle;
+    int file_length;
+    unsigned int line_index;
+    unsigned int hash_index;
+    int section;
+    char *ptr;
+    char *end;
+    INI_LineStruct *line;
+
+    if (stat((const char *)&INI_WriteBuffer, &file_status))
+    {
+        INI_FreeModel();
         return 0;
     }
 
-    while (1)
+    if (INI_Model.is_loaded
+        && !stricmp(INI_Model.path, (const char *)&INI_WriteBuffer)
+        && INI_Model.mtime == file_status.st_mtime
+        && INI_Model.size == file_status.st_size)
+    {
+        return 1;
+    }
+
+    INI_FreeModel();
+
+    file_handle = open((const char *)&INI_WriteBuffer, O_RDONLY | O_BINARY);
+    if (file_handle == -1)
     {
-        ptr_local_buffer = fgets((char *)&local_buffer, sizeof(local_buffer), fp);
-        if (!ptr_local_buffer)
+        return 0;
+    }
+
+    file_length = filelength(file_handle);
+    if (file_length < 0)
+    {
+        close(file_handle);
+        return 0;
+    }
+
+    INI_Model.buffer = (char *)malloc(file_length + 1);
+    if (!INI_Model.buffer)
+    {
+        close(file_handle);
+        return 0;
+    }
+    if (read(file_handle, INI_Model.buffer, file_length) != file_length)
+    {
+        close(file_handle);
+        INI_FreeModel();
+        return 0;
+    }
+    close(file_handle);
+    INI_Model.buffer[file_length] = 0;
+
+    /* Count lines to size the line table and the hash table in one go. */
+    INI_Model.number_of_lines = 0;
+    end = INI_Model.buffer + file_length;
+    for (ptr = INI_Model.buffer; ptr < end; ptr++)
+    {
+        if (*ptr == '\n')
         {
-            break;
+            INI_Model.number_of_lines++;
         }
+    }
+    if (file_length && end[-1] != '\n')
+    {
+        INI_Model.number_of_lines++;
+    }
+
+    INI_Model.hash_mask = 15;
+    while (INI_Model.hash_mask + 1 < 2 * INI_Model.number_of_lines)
+    {
+        INI_Model.hash_mask = (INI_Model.hash_mask << 1) | 1;
+    }
 
-        line_length = strspn(local_buffer, " \n\r");
-        if (line_length)
+    INI_Model.lines = (INI_LineStruct *)malloc((INI_Model.number_of_lines + 1) * sizeof(INI_LineStruct));
+    INI_Model.hash_table = (int *)malloc((INI_Model.hash_mask + 1) * sizeof(int));
+    if (!INI_Model.lines || !INI_Model.hash_table)
+    {
+        INI_FreeModel();
+        return 0;
+    }
+    memset(INI_Model.lines, 0, (INI_Model.number_of_lines + 1) * sizeof(INI_LineStruct));
+    memset(INI_Model.hash_table, INI_HASH_EMPTY, (INI_Model.hash_mask + 1) * sizeof(int));
+
+    section = -1;
+    ptr = INI_Model.buffer;
+    for (line_index = 0; line_index < INI_Model.number_of_lines; line_index++)
+    {
+        line = &INI_Model.lines[line_index];
+        line->text = ptr;
+        while (ptr < end && *ptr != '\n')
         {
-            string_length = strlen(&local_buffer[-line_length + 1]);
-            memmove(local_buffer, &local_buffer[line_length], string_length); /* remove initial white space chars? */
+            ptr++;
         }
+        if (ptr < end)
+        {
+            ptr++;
+        }
+        line->length = ptr - line->text;
 
-        line_length = strcspn(local_buffer, " \n\r");
-        local_buffer[line_length] = 0;
-        if (strlen(local_buffer))
+        INI_ParseLine(line, section);
+        if (line->type == INI_LINE_OTHER)
         {
-            if (local_buffer[0] == '[') /* FIXME Check for closing bracket */
+            continue;
+        }
+
+        line->hash = INI_HashName(line->name, line->name_length);
+        if (line->type == INI_LINE_SECTION)
+        {
+            section = line_index;
+        }
+        else if (section < 0)
+        {
+            continue; /* entries outside of any section can not be looked up */
+        }
+        else
+        {
+            line->hash ^= INI_Model.lines[section].hash + (unsigned int)section * 0x9E3779B1u;
+        }
+
+        /* Only the first occurrence of a section or key is reachable, just like the sequential scan this replaces. */
+        hash_index = line->hash & INI_Model.hash_mask;
+        while (INI_Model.hash_table[hash_index] != INI_HASH_EMPTY)
+        {
+            if (INI_Model.lines[INI_Model.hash_table[hash_index]].type == line->type
+                && INI_Model.lines[INI_Model.hash_table[hash_index]].section == line->section
+                && INI_CompareName(&INI_Model.lines[INI_Model.hash_table[hash_index]], line->name, line->name_length))
             {
-                if (category_found)
-                {
-                    break;
-                }
-                category_length = strlen(&local_buffer[0]) - 2;
-                if (!strnicmp(&local_buffer[1], category, category_length))
-                {
-                    category_found = 1;
-                }
+                break;
             }
-            else
-            {
+            hash_index = (hash_index + 1) & INI_Model.hash_mask;
+        }
+        if (INI_Model.hash_table[hash_index] == INI_HASH_EMPTY)
+        {
+            INI_Model.hash_table[hash_index] = line_index;
+        }
+    }
 
-                if (strlen(local_buffer) >= strlen(item))
-                {
-                    item_length = strlen(item);
-                }
-                else
-                {
-                    item_length = strlen(local_buffer);
-                }
-                if (!strnicmp(local_buffer, item, item_length))
-                {
-                    ptr_local_buffer = strchr(&local_buffer[0], '='); /* get position of = */
-                    if (ptr_local_buffer)
-                    {
-                        strncpy((char *)&buffer[0], (const char *)&ptr_local_buffer[1], length - 1);
-                        buffer[length - 1] = 0;
-                    }
-                    else
-                    {
-                        *buffer = 0;
-                    }
-                    retVal = 1;
-                    break;
-                }
-            }
+    strncpy(INI_Model.path, (const char *)&INI_WriteBuffer, sizeof(INI_Model.path) - 1);
+    INI_Model.mtime = file_status.st_mtime;
+    INI_Model.size = file_status.st_size;
+    INI_Model.is_loaded = 1;
+
+    return 1;
+}
+
+/* Return the line index of the section named 'category' or -1. */
+static int INI_FindSection(const char *category)
+{
+    unsigned int length = strlen(category);
+    unsigned int hash_index = INI_HashName(category, length) & INI_Model.hash_mask;
+    INI_LineStruct *line;
+
+    while (INI_Model.hash_table[hash_index] != INI_HASH_EMPTY)
+    {
+        line = &INI_Model.lines[INI_Model.hash_table[hash_index]];
+        if (line->type == INI_LINE_SECTION && INI_CompareName(line, category, length))
+        {
+            return INI_Model.hash_table[hash_index];
         }
+        hash_index = (hash_index + 1) & INI_Model.hash_mask;
     }
 
-    fclose(fp);
-    return retVal;
+    return -1;
+}
+
+/* Return the line index of the entry 'item' in the section starting at line 'section' or -1. */
+static int INI_FindItem(int section, const char *item)
+{
+    unsigned int length = strlen(item);
+    unsigned int hash_index;
+    INI_LineStruct *line;
+
+    hash_index = (INI_HashName(item, length) ^ (INI_Model.lines[section].hash + (unsigned int)section * 0x9E3779B1u)) & INI_Model.hash_mask;
+    while (INI_Model.hash_table[hash_index] != INI_HASH_EMPTY)
+    {
+        line = &INI_Model.lines[INI_Model.hash_table[hash_index]];
+        if (line->type == INI_LINE_ENTRY && line->section == section && INI_CompareName(line, item, length))
+        {
+            return INI_Model.hash_table[hash_index];
+        }
+        hash_index = (hash_index + 1) & INI_Model.hash_mask;
+    }
+
+    return -1;
+}
+
+/* Look up an 'item' in a specified 'category' without copying it. The returned view is not zero-terminated and stays
+   valid until the INI file is reloaded or rewritten. */
+int INI_FindEntry(const char *category, const char *item, const char **value, unsigned int *length)
+{
+    int section;
+    int line_index;
+
+    if (!INI_LoadModel())
+    {
+        return 0;
+    }
+
+    section = INI_FindSection(category);
+    if (section < 0)
+    {
+        return 0;
+    }
+
+    line_index = INI_FindItem(section, item);
+    if (line_index < 0)
+    {
+        return 0;
+    }
+
+    *value = INI_Model.lines[line_index].value;
+    *length = INI_Model.lines[line_index].value_length;
+    return 1;
+}
+
+/* Copy the value of an 'item' in a specified 'category' into a caller supplied buffer of 'length' bytes. */
+int INI_GetEntry(const char *category, const char *item, char *buffer, unsigned int length)
+{
+    const char *value;
+    unsigned int value_length;
+
+    if (!length)
+    {
+        return 0;
+    }
+
+    memset(buffer, 0, length);
+
+    if (!INI_FindEntry(category, item, &value, &value_length))
+    {
+        return 0;
+    }
+
+    if (value_length > length - 1)
+    {
+        value_length = length - 1;
+    }
+    memcpy(buffer, value, value_length);
+
+    return 1;
+}
+
+bool INI_ParseEntry(const char *category, const char *item, unsigned char *buffer, int length)
+{
+    return INI_GetEntry(category, item, (char *)buffer, length) != 0;
 }
 
 /* Get an entry from the INI file for an 'item' in a specified 'category'. */
@@ -142,218 +485,399 @@ unsigned char *INI_ReadEntry(unsigned char *buffer, const char *category, const
     return retVal;
 }
 
-int INI_WriteEntry(const char *category, const char *item, const char *value)
+/* Begin a batch of INI changes. Changes are only staged in memory until the outermost INI_CommitTransaction(). */
+void INI_BeginTransaction(void)
+{
+    INI_TransactionDepth++;
+}
+
+/* Discard all staged changes of the current transaction. */
+void INI_AbortTransaction(void)
+{
+    INI_TransactionDepth = 0;
+    INI_NumberOfStagedEntries = 0;
+}
+
+/* Commit the current transaction if all its changes were 'staged'. Otherwise discard it, so no part of it is written,
+   and push the error 'text'. */
+static int INI_FinishTransaction(const char *text, int staged)
+{
+    INI_ErrorStruct data;
+
+    if (staged)
+    {
+        return INI_CommitTransaction();
+    }
+
+    INI_AbortTransaction();
+    data.text = text;
+    data.data1 = 0;
+    data.data2 = 0;
+    ERROR_PushError((ERROR_PrintErrorPtr)INI_LocalPrintError, "BBINI Library", sizeof(data), (const char *) &data);
+    return 0;
+}
+
+/* Stage an entry; replaces an earlier staged change of the same entry. The table grows as needed, so a transaction is
+   always written at once. */
+static int INI_StageEntry(const char *category, const char *item, const char *value, int is_delete)
+{
+    int entry_index;
+    INI_StagedEntryStruct *entry;
+    INI_StagedEntryStruct *entries;
+    INI_ErrorStruct data;
+
+    if (strlen(category) >= sizeof(entry->category) || strlen(item) >= sizeof(entry->item))
+    {
+        data.text = "INI_StageEntry: Category or item name too long, length";
+        data.data1 = strlen(category) > strlen(item) ? strlen(category) : strlen(item);
+        data.data2 = 0;
+        ERROR_PushError((ERROR_PrintErrorPtr)INI_LocalPrintError, "BBINI Library", sizeof(data), (const char *) &data);
+        return 0;
+    }
+    if (value && strlen(value) >= sizeof(entry->value))
+    {
+        data.text = "INI_StageEntry: Value too long, length,maximum";
+        data.data1 = strlen(value);
+        data.data2 = sizeof(entry->value) - 1;
+        ERROR_PushError((ERROR_PrintErrorPtr)INI_LocalPrintError, "BBINI Library", sizeof(data), (const char *) &data);
+        return 0;
+    }
+
+    entry = 0;
+    for (entry_index = 0; entry_index < INI_NumberOfStagedEntries; entry_index++)
+    {
+        entry = &INI_StagedEntries[entry_index];
+        if (!stricmp(entry->category, category) && !stricmp(entry->item, item))
+        {
+            break;
+        }
+    }
+
+    if (entry_index == INI_NumberOfStagedEntries)
+    {
+        if (INI_NumberOfStagedEntries == INI_MaxStagedEntries)
+        {
+            entries = (INI_StagedEntryStruct *)realloc(INI_StagedEntries, (INI_MaxStagedEntries + INI_STAGED_ENTRIES_STEP) * sizeof(INI_StagedEntryStruct));
+            if (!entries)
+            {
+                data.text = "INI_StageEntry: Cannot Allocate Mem for number of entries";
+                data.data1 = INI_MaxStagedEntries + INI_STAGED_ENTRIES_STEP;
+                data.data2 = 0;
+                ERROR_PushError((ERROR_PrintErrorPtr)INI_LocalPrintError, "BBINI Library", sizeof(data), (const char *) &data);
+                return 0;
+            }
+            INI_StagedEntries = entries;
+            INI_MaxStagedEntries += INI_STAGED_ENTRIES_STEP;
+        }
+        entry = &INI_StagedEntries[INI_NumberOfStagedEntries++];
+        strcpy(entry->category, category);
+        strcpy(entry->item, item);
+    }
+
+    strcpy(entry->value, value ? value : "");
+    entry->is_delete = is_delete;
+
+    return 1;
+}
+
+/* Set 'item' in 'category' to 'value'; creates the category and the item if necessary. */
+int INI_SetEntry(const char *category, const char *item, const char *value)
+{
+    int retVal;
+
+    INI_BeginTransaction();
+    retVal = INI_StageEntry(category, item, value, 0);
+    if (!INI_CommitTransaction())
+    {
+        retVal = 0;
+    }
+
+    return retVal;
+}
+
+/* Remove 'item' from 'category'. */
+int INI_DeleteEntry(const char *category, const char *item)
+{
+    int retVal;
+
+    INI_BeginTransaction();
+    retVal = INI_StageEntry(category, item, 0, 1);
+    if (!INI_CommitTransaction())
+    {
+        retVal = 0;
+    }
+
+    return retVal;
+}
+
+/* Finish a batch of INI changes. The outermost commit writes all staged changes to the INI file at once. */
+int INI_CommitTransaction(void)
+{
+    if (INI_TransactionDepth > 0)
+    {
+        INI_TransactionDepth--;
+    }
+    if (INI_TransactionDepth)
+    {
+        return 1;
+    }
+
+    return INI_WriteStagedEntries();
+}
+
+static int INI_WriteStagedItem(FILE *fp, const INI_StagedEntryStruct *entry, const char *newline)
+{
+    return fputs(entry->item, fp) >= 0 && fputc('=', fp) != EOF && fputs(entry->value, fp) >= 0 && fputs(newline, fp) >= 0;
+}
+
+/* Write the INI file once with all staged changes applied. Lines that are not changed are copied byte by byte, so
+   comments, white space and line terminators are preserved. The new file is written to a temporary file and flushed
+   to disk before it replaces the original, so the INI file is never left half written. */
+static int INI_WriteStagedEntries(void)
 {
     char drive[4];
     char dir[132];
     char fname[12];
     char ext[8];
+    char temp_path[144];
+    char backup_path[144];
 
-    char path[144];
-
-    FILE *read_fp;
     FILE *write_fp;
+    const char *newline;
+    INI_LineStruct *line;
+    INI_StagedEntryStruct *entry;
+    unsigned int line_index;
+    unsigned int insert_after;
+    int entry_index;
+    int other_index;
+    int section;
+    int is_written;
+    int is_ok;
+
+    if (!INI_NumberOfStagedEntries)
+    {
+        return 1;
+    }
 
-    int category_found;
-    int itemWritten;
-
-    char *buffer;
-    char string[200];
-    char buf[200];
-    int segLen;
-    int newLen;
-    int fputsRetVal;
-    int strLenCategory;
-    int len;
-    int retVal;
+    if (!INI_LoadModel())
+    {
+        INI_NumberOfStagedEntries = 0;
+        return 0;
+    }
 
     /* Split path in buffer to its components and replace the extension with '.tmp' */
     _splitpath((const char *)&INI_WriteBuffer, drive, dir, fname, ext);
-    _makepath((char *)&path[0], drive, dir, fname, "TMP");
+    _makepath(temp_path, drive, dir, fname, "TMP");
+    _makepath(backup_path, drive, dir, fname, "BAK");
 
-    /* open file in buffer for reading */
-    read_fp = fopen((const char *)&INI_WriteBuffer, "rt");
-    if (!read_fp)
+    write_fp = fopen(temp_path, "wb");
+    if (!write_fp)
     {
+        INI_NumberOfStagedEntries = 0;
         return 0;
     }
 
-    /* open temporary file for writing */
-    write_fp = fopen(path, "wt");
-    if (write_fp)
+    /* New lines use the same line terminator as the existing file. */
+    newline = "\r\n";
+    if (INI_Model.number_of_lines && INI_Model.lines[0].text[INI_Model.lines[0].length - 1] == '\n'
+        && (INI_Model.lines[0].length < 2 || INI_Model.lines[0].text[INI_Model.lines[0].length - 2] != '\r'))
     {
-        category_found = 0;
-        itemWritten = 0;
+        newline = "\n";
+    }
 
-        while (1)
-        {
-            buffer = fgets(string, sizeof(string), read_fp);
-            if (!buffer)
-            {
-                break;
-            }
+    for (entry_index = 0; entry_index < INI_NumberOfStagedEntries; entry_index++)
+    {
+        INI_StagedEntries[entry_index].section = INI_FindSection(INI_StagedEntries[entry_index].category);
+        INI_StagedEntries[entry_index].is_applied = 0;
+    }
 
-            segLen = strspn(string, " \r\n\t");
-            if (segLen)
-            {
-                newLen = strlen(string - segLen + 1);
-                memmove(string, string + segLen, newLen);
-            }
-            segLen = strcspn(string, " \r\n\t");
-            string[segLen] = 0;
+    is_ok = 1;
+    section = -1;
+    insert_after = 0;
+    for (line_index = 0; is_ok && line_index < INI_Model.number_of_lines; line_index++)
+    {
+        line = &INI_Model.lines[line_index];
+        is_written = 0;
 
-            if (strlen(string))
+        if (line->type == INI_LINE_SECTION)
+        {
+            /* New items of a section are added after its last entry, in front of trailing blank lines and comments. */
+            section = line_index;
+            insert_after = line_index;
+            for (other_index = line_index + 1; other_index < (int)INI_Model.number_of_lines; other_index++)
             {
-                if (!itemWritten)
-                {
-                    if (string[0] == '[') /* FIXME: if-condition incomplete */
-                    {
-                        if (category_found)
-                        {
-                            _bprintf(buf, sizeof(buf), "%s=%s\n", item, value);
-                            fputsRetVal = fputs(buf, write_fp);
-
-                            if (fputsRetVal <= 0)
-                            {
-                                break;
-                            }
-                            itemWritten = 1;
-                        }
-                        else
-                        {
-                            strLenCategory = strlen(&string[0]) - 2;
-                            if (!strnicmp(&string[1], category, strLenCategory))
-                            {
-                                category_found = 1;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        if (strlen(string) >= strlen(item))
-                        {
-                            len = strlen(item);
-                        }
-                        else
-                        {
-                            len = strlen(string);
-                        }
-                        if (!strnicmp(&string[0], item, len))
-                        {
-                            _bprintf(string, 200u, "%s=%s", item, value);
-                            itemWritten = 1;
-                        }
-                    }
-                }
-                fputsRetVal = fputs(string, write_fp);
-                if (fputsRetVal <= 0)
+                if (INI_Model.lines[other_index].type == INI_LINE_SECTION)
                 {
                     break;
                 }
-                fputsRetVal = fputs("\n", write_fp);
-                if (fputsRetVal <= 0)
+                if (INI_Model.lines[other_index].type == INI_LINE_ENTRY)
                 {
-                    break;
+                    insert_after = other_index;
                 }
             }
-            else
+        }
+        else if (line->type == INI_LINE_ENTRY && section >= 0 && line->section == section)
+        {
+            for (entry_index = 0; entry_index < INI_NumberOfStagedEntries; entry_index++)
             {
-                fputsRetVal = fputs("\n", write_fp);
-                if (fputsRetVal <= 0)
+                entry = &INI_StagedEntries[entry_index];
+                if (entry->is_applied || entry->section != section || !INI_CompareName(line, entry->item, strlen(entry->item)))
+                {
+                    continue;
+                }
+
+                entry->is_applied = 1;
+                is_written = 1;
+                if (entry->is_delete)
                 {
                     break;
                 }
+
+                /* Keep the original spelling and indentation of the key. */
+                if (line->value > line->name + line->name_length)
+                {
+                    is_ok = fwrite(line->text, line->value - line->text, 1, write_fp) == 1 && fputs(entry->value, write_fp) >= 0
+                            && fputs(newline, write_fp) >= 0;
+                }
+                else
+                {
+                    is_ok = INI_WriteStagedItem(write_fp, entry, newline);
+                }
+                break;
             }
         }
 
-        /* Write item if category already exists. */
-        if (category_found)
+        if (!is_written)
         {
-            if (!itemWritten)
+            is_ok = fwrite(line->text, line->length, 1, write_fp) == 1;
+            if (is_ok && line_index == INI_Model.number_of_lines - 1 && line->text[line->length - 1] != '\n')
             {
-                _bprintf(string, sizeof(string), "%s=%s\n", item, value);
-                fputsRetVal = fputs(string, write_fp);
-                if (fputsRetVal > 0)
-                {
-                    itemWritten = 1;
-                }
+                is_ok = fputs(newline, write_fp) >= 0;
             }
         }
-        else /* Write category and item if both do not exist. */
+
+        if (section >= 0 && line_index == insert_after)
         {
-            _bprintf(string, sizeof(string), "[%s]\n", category);
-            fputsRetVal = fputs(string, write_fp);
-            if (fputsRetVal > 0)
+            for (entry_index = 0; is_ok && entry_index < INI_NumberOfStagedEntries; entry_index++)
             {
-                _bprintf(string, sizeof(string), "%s=%s\n", item, value);
-                fputsRetVal = fputs(string, write_fp);
-                if (fputsRetVal > 0)
+                entry = &INI_StagedEntries[entry_index];
+                if (entry->section == section && !entry->is_applied && !entry->is_delete)
                 {
-                    itemWritten = 1;
+                    entry->is_applied = 1;
+                    is_ok = INI_WriteStagedItem(write_fp, entry, newline);
                 }
             }
         }
-        fclose(read_fp);
-        fclose(write_fp);
+    }
 
-        if (itemWritten)
+    /* Append categories that do not exist yet, each one followed by all of its new items. */
+    for (entry_index = 0; is_ok && entry_index < INI_NumberOfStagedEntries; entry_index++)
+    {
+        entry = &INI_StagedEntries[entry_index];
+        if (entry->is_applied || entry->is_delete)
         {
-            _unlink((const char *)&INI_WriteBuffer);                     /* Erase the file that's stored in the buffer ...*/
-            rename((const char *)&path, (const char *)&INI_WriteBuffer); /* ... and replace it with the temporary file. */
+            continue;
         }
-        else
+
+        is_ok = fputc('[', write_fp) != EOF && fputs(entry->category, write_fp) >= 0 && fputc(']', write_fp) != EOF
+                && fputs(newline, write_fp) >= 0;
+        for (other_index = entry_index; is_ok && other_index < INI_NumberOfStagedEntries; other_index++)
         {
-            _unlink(path);
+            if (!INI_StagedEntries[other_index].is_applied && !INI_StagedEntries[other_index].is_delete
+                && !stricmp(INI_StagedEntries[other_index].category, entry->category))
+            {
+                INI_StagedEntries[other_index].is_applied = 1;
+                is_ok = INI_WriteStagedItem(write_fp, &INI_StagedEntries[other_index], newline);
+            }
         }
-        retVal = itemWritten;
     }
-    else
+
+    INI_NumberOfStagedEntries = 0;
+
+    if (is_ok)
     {
-        fclose(read_fp);
-        retVal = 0;
+        is_ok = !fflush(write_fp) && !fsync(fileno(write_fp));
     }
-    return retVal;
+    if (fclose(write_fp))
+    {
+        is_ok = 0;
+    }
+    if (!is_ok)
+    {
+        _unlink(temp_path);
+        return 0;
+    }
+
+    /* DOS can not rename onto an existing file. Keep the old file as backup until the new one is in place. */
+    INI_InvalidateModel();
+    _unlink(backup_path);
+    if (rename((const char *)&INI_WriteBuffer, backup_path))
+    {
+        _unlink(temp_path);
+        return 0;
+    }
+    if (rename(temp_path, (const char *)&INI_WriteBuffer))
+    {
+        rename(backup_path, (const char *)&INI_WriteBuffer);
+        _unlink(temp_path);
+        return 0;
+    }
+    _unlink(backup_path);
+
+    return 1;
+}
+
+/* Set an entry in the INI file. Inside a transaction the change is only staged. */
+int INI_WriteEntry(const char *category, const char *item, const char *value)
+{
+    return INI_SetEntry(category, item, value);
 }
 
 void INI_WriteEntry_System(void)
 {
     char buf[200];
+    int staged;
 
     if (FILE_IsFileExisting((const char *)&INI_WriteBuffer))
     {
+        INI_BeginTransaction();
+        staged = 1;
+
         if (DPMI_IsVesaAvailable())
         {
-            INI_WriteEntry("SYSTEM", "VESA", "Y");
+            staged &= INI_WriteEntry("SYSTEM", "VESA", "Y");
         }
         else
         {
-            INI_WriteEntry("SYSTEM", "VESA", "N");
+            staged &= INI_WriteEntry("SYSTEM", "VESA", "N");
         }
 
         if (_bios_equiplist() & 2) /* bit 1: Set to 1 if a math coprocessor is installed */
         {
-            INI_WriteEntry("SYSTEM", "FPU", "Y");
+            staged &= INI_WriteEntry("SYSTEM", "FPU", "Y");
         }
         else
         {
-            INI_WriteEntry("SYSTEM", "FPU", "N");
+            staged &= INI_WriteEntry("SYSTEM", "FPU", "N");
         }
 
         if (SETUP_CdDrive)
         {
             sprintf(buf, "%c", SETUP_CdDrive);
-            INI_WriteEntry("SYSTEM", "CD_ROM_DRIVE", buf);
+            staged &= INI_WriteEntry("SYSTEM", "CD_ROM_DRIVE", buf);
         }
 
         if (SETUP_TargetDrive)
         {
-            sprintf(buf, "%c", SETUP_SourcePath);
-            INI_WriteEntry("SYSTEM", "SOURCE_PATH", buf);
+            sprintf(buf, "%c", SETUP_SourcePath[0]);
+            staged &= INI_WriteEntry("SYSTEM", "SOURCE_PATH", buf);
         }
 
         itoa(SETUP_Language + 1, buf, 10);
 
-        INI_WriteEntry("SYSTEM", "LANGUAGE", buf);
+        staged &= INI_WriteEntry("SYSTEM", "LANGUAGE", buf);
+
+        INI_FinishTransaction("INI_WriteEntry_System: Cannot stage all entries, none written", staged);
     }
 }
 
@@ -361,7 +885,8 @@ int INI_WriteEntry_Vesa(void)
 {
     union REGS inregs;
     struct SREGS segregs;
-    char buf[4];
+    char buf[8];
+    int staged;
 
     if (!DPMI_VbeInfo)
     {
@@ -372,8 +897,8 @@ int INI_WriteEntry_Vesa(void)
     memset(&segregs, 0, sizeof(SREGS));
 
     rmregs.eax = 0x4f00;
-    rmregs.es = (unsigned int)DPMI_VbeInfo >> 4;
-    rmregs.edi = (unsigned int)DPMI_VbeInfo & 0x0F;
+    rmregs.es = (uintptr_t)DPMI_VbeInfo >> 4;
+    rmregs.edi = (uintptr_t)DPMI_VbeInfo & 0x0F;
     inregs.w.ax = 0x300;
     inregs.w.bx = 0x10;
     inregs.w.cx = 0;
@@ -399,133 +924,138 @@ int INI_WriteEntry_Vesa(void)
 
     if (FILE_IsFileExisting((const char *)&INI_WriteBuffer))
     {
+        INI_BeginTransaction();
+        staged = 1;
+
         if (DPMI_IsVideoModeSupported(280, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_1024x768x16.2M", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_1024x768x16.2M", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_1024x768x16.2M", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_1024x768x16.2M", "N");
         }
 
         if (DPMI_IsVideoModeSupported(277, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_800x600x16.2M", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_800x600x16.2M", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_800x600x16.2M", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_800x600x16.2M", "N");
         }
 
         if (DPMI_IsVideoModeSupported(274, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_640x480x16.2M", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_640x480x16.2M", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_640x480x16.2M", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_640x480x16.2M", "N");
         }
 
         if (DPMI_IsVideoModeSupported(279, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_1024x768x64k", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_1024x768x64k", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_1024x768x64k", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_1024x768x64k", "N");
         }
 
         if (DPMI_IsVideoModeSupported(276, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_800x600x64k", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_800x600x64k", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_800x600x64k", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_800x600x64k", "N");
         }
 
         if (DPMI_IsVideoModeSupported(273, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_640x480x64k", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_640x480x64k", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_640x480x64k", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_640x480x64k", "N");
         }
 
         if (DPMI_IsVideoModeSupported(278, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_1024x768x32k", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_1024x768x32k", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_1024x768x32k", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_1024x768x32k", "N");
         }
 
         if (DPMI_IsVideoModeSupported(275, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_800x600x32k", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_800x600x32k", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_800x600x32k", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_800x600x32k", "N");
         }
 
         if (DPMI_IsVideoModeSupported(272, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_640x480x32k", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_640x480x32k", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_640x480x32k", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_640x480x32k", "N");
         }
 
         if (DPMI_IsVideoModeSupported(261, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_1024x768x256", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_1024x768x256", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_1024x768x256", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_1024x768x256", "N");
         }
 
         if (DPMI_IsVideoModeSupported(259, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_800x600x256", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_800x600x256", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_800x600x256", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_800x600x256", "N");
         }
 
         if (DPMI_IsVideoModeSupported(257, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_640x480x256", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_640x480x256", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_640x480x256", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_640x480x256", "N");
         }
 
         if (DPMI_IsVideoModeSupported(256, (short *)DPMI_VbeInfo->VideoModePtr))
         {
-            INI_WriteEntry("VESA", "MODE_640x400x256", "Y");
+            staged &= INI_WriteEntry("VESA", "MODE_640x400x256", "Y");
         }
         else
         {
-            INI_WriteEntry("VESA", "MODE_640x400x256", "N");
+            staged &= INI_WriteEntry("VESA", "MODE_640x400x256", "N");
         }
 
-        sprintf(buf, "%li", DPMI_VbeInfo->TotalMemory);
-        INI_WriteEntry("VESA", "MEMORY", buf);
+        sprintf(buf, "%li", (long int)DPMI_VbeInfo->TotalMemory);
+        staged &= INI_WriteEntry("VESA", "MEMORY", buf);
 
-        sprintf(buf, "%li", DPMI_VbeInfo->VESAVersion & 0xF);
-        INI_WriteEntry("VESA", "VESA_VERSION_SUBNUMBER", buf);
+        sprintf(buf, "%li", (long int)(DPMI_VbeInfo->VESAVersion & 0xF));
+        staged &= INI_WriteEntry("VESA", "VESA_VERSION_SUBNUMBER", buf);
 
-        sprintf(buf, "%li", DPMI_VbeInfo->VESAVersion >> 8);
-        INI_WriteEntry("VESA", "VESA_VERSION_NUMBER", buf);
+        sprintf(buf, "%li", (long int)(DPMI_VbeInfo->VESAVersion >> 8));
+        staged &= INI_WriteEntry("VESA", "VESA_VERSION_NUMBER", buf);
 
-        INI_WriteEntry("VESA", "OEM", (const char *)DPMI_VbeInfo->OEMStringPtr);
+        staged &= INI_WriteEntry("VESA", "OEM", (const char *)DPMI_VbeInfo->OEMStringPtr);
+
+        return INI_FinishTransaction("INI_WriteEntry_Vesa: Cannot stage all entries, none written", staged);
     }
 
     return 1;
@@ -547,7 +1077,7 @@ void INI_WriteEntry_Path(void)
     int err;
     int handle;
     unsigned int totalNrOfDrives;
-    char drive_1;
+    char drive_1[4];
 
     strcpy(pathBuf, "[PATH]\nPATH=");
     if (SETUP_PtrArgvPath)
@@ -557,13 +1087,13 @@ void INI_WriteEntry_Path(void)
         _splitpath(SETUP_PtrArgvPath, (char *)&drive_1, (char *)&dir, (char *)&fname, (char *)&ext);
         if (strlen((char *)&drive_1))
         {
-            driveLetter = toupper(drive_1) - 0x40;
+            driveLetter = toupper(drive_1[0]) - 0x40;
             _dos_setdrive(driveLetter, &totalNrOfDrives);
         }
         lenDir = strlen(dir);
-        if ((signed int)lenDir > 1 && buffer[lenDir + 143] == '\\')
+        if ((signed int)lenDir > 1 && dir[lenDir - 1] == '\\')
         {
-            buffer[lenDir + 143] = 0;
+            dir[lenDir - 1] = 0;
         }
         err = chdir(dir);
         if (!err)
@@ -586,12 +1116,12 @@ void INI_WriteEntry_Path(void)
 
 void INI_MakePath(void)
 {
-    char buf[200];
+    char buf[260];
     char dir[132];
     char fname[12];
     char drive[4];
 
-    if (SETUP_TargetPath)
+    if (SETUP_TargetPath[0])
     {
         sprintf((char *)&buf, "%s\\x.x", (char *)&SETUP_TargetPath);
         _splitpath((char *)&buf, (char *)&drive, (char *)&dir, (char *)&fname, 0);
@@ -603,4 +1133,11 @@ void INI_MakePath(void)
 
     _splitpath(SETUP_PtrArgv, 0, 0, (char *)&fname, 0);
     _makepath((char *)&INI_WriteBuffer, (char *)&drive, (char *)&dir, (char *)&fname, "ini");
+}
+
+static void INI_LocalPrintError(char *buffer, const char *data)
+{
+#define DATA (((INI_ErrorStruct *)data))
+    sprintf(buffer, "ERROR!: %s  %u, %u", DATA->text, DATA->data1, DATA->data2);
+#undef DATA
 }
\ No newline at end of file
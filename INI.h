@@ -31,7 +31,15 @@ extern unsigned char INI_ReadBuffer[100];
 extern unsigned char INI_WriteBuffer[119];
 
 extern unsigned char* INI_ReadEntry(unsigned char* buffer, const char* category, const char* item);
+extern int INI_GetEntry(const char* category, const char* item, char* buffer, unsigned int length);
+extern int INI_FindEntry(const char* category, const char* item, const char** value, unsigned int* length);
+extern void INI_InvalidateModel(void);
 extern int INI_WriteEntry(const char* category, const char *item, const char* value);
+extern int INI_SetEntry(const char* category, const char* item, const char* value);
+extern int INI_DeleteEntry(const char* category, const char* item);
+extern void INI_BeginTransaction(void);
+extern int INI_CommitTransaction(void);
+extern void INI_AbortTransaction(void);
 extern void INI_WriteEntry_System(void);
 extern int INI_WriteEntry_Vesa(void);
 extern void INI_WriteEntry_Path(void);
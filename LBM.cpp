@@ -30,34 +30,296 @@
 #include "ERROR.h"
 #include "DSA.h"
 #include "DOS.h"
+#include "LBM.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #define CHUNK_LENGTH 4
+#define CHUNK_HEADER_LENGTH 8
+#define FORM_HEADER_LENGTH 12
 
-#define BMHD_W_HIBYTE 8
-#define BMHD_W_LOBYTE 9
-#define BMHD_H_HIBYTE 10
-#define BMHD_H_LOBYTE 11
+#define BMHD_LENGTH 20
 
-#define LBM_W_HIBYTE 20
-#define LBM_W_LOBYTE 21
-#define LBM_H_HIBYTE 22
-#define LBM_H_LOBYTE 23
+#define LBM_MASK_HAS_MASK 1
 
-#define LBM_COMPRESSION_BYTE 30
+#define LBM_FLAG_NEW_OPM 1
+#define LBM_FLAG_RESIZE_OPM 2
+#define LBM_FLAG_IN_MEMORY 0x10000
+
+#define LBM_READ_AHEAD_SIZE 0x2000
+#define LBM_WRITE_BUFFER_SIZE 0x4000
+
+/* BODY data of an image, either completely in memory or read from a file through a small read-ahead buffer. */
+typedef struct
+{
+    int file_handle;
+    const unsigned char *ptr;   /* next byte to decode */
+    const unsigned char *end;   /* end of the bytes available */
+    unsigned int remaining;     /* bytes of the BODY that have not been read from the file yet */
+    unsigned char *buffer;
+    unsigned int buffer_size;
+} LBM_StreamStruct;
+
+/* Buffered output of LBM_SaveOPM. */
+typedef struct
+{
+    int file_handle;
+    unsigned char *buffer;
+    unsigned int used;
+    unsigned int offset;        /* file offset of buffer[0] */
+} LBM_WriteStruct;
+
+#define LBM_BACKGROUND_MAGIC "BBBG"
+#define LBM_BACKGROUND_VERSION 1
+
+/* Header of a cached background; the file in the TEMP directory is this header followed by width * height pixels. */
+typedef struct
+{
+    char magic[4];
+    unsigned int version;
+    char path[144];
+    long mtime;
+    long size;
+    unsigned short width;
+    unsigned short height;
+    LBM_LogPalette pal;
+} LBM_BackgroundHeaderStruct;
+
+typedef struct
+{
+    LBM_BackgroundHeaderStruct header;
+    unsigned char *pixels;
+} LBM_BackgroundCacheStruct;
+
+typedef struct
+{
+    const char *text;
+    int data1;
+    int data2;
+} LBM_ErrorStruct;
+
+static unsigned int LBM_GetLong(const unsigned char *data);
+static unsigned short LBM_GetWord(const unsigned char *data);
+static int LBM_IsImageChunk(const unsigned char *chunk_header);
+static unsigned int LBM_AddChunk(LBM_ChunkTableStruct *table, const unsigned char *chunk_header, unsigned int offset);
+static int LBM_InitChunks(const unsigned char *form_header, unsigned int length, LBM_ChunkTableStruct *table);
+static int LBM_ReadChunks(int file_handle, unsigned int length, LBM_ChunkTableStruct *table);
+static int LBM_GetHeader(const unsigned char *bmhd, const LBM_ChunkTableStruct *table, LBM_HeaderStruct *header);
+static void LBM_GetPal(const unsigned char *cmap, unsigned int length, LBM_LogPalette *pal);
+static int LBM_FillStream(LBM_StreamStruct *stream, unsigned int length);
+static const unsigned char *LBM_UnpackRow(const unsigned char *src, const unsigned char *src_end, unsigned char *dst, int row_bytes, int x0, int x1);
+static void LBM_Transpose(unsigned int *x_ptr, unsigned int *y_ptr);
+static void LBM_PlanarToChunky(const unsigned char *planes, int plane_bytes, int number_of_planes, const unsigned char *mask, unsigned char *dst, int x0, int x1);
+static void LBM_ChunkyToPlanar(const unsigned char *src, int width, int plane_bytes, unsigned char *planes);
+static int LBM_GetRunLength(const unsigned char *src, int length);
+static int LBM_GetLiteralLength(const unsigned char *src, int length);
+static int LBM_PackRow(const unsigned char *src, int length, unsigned char *dst);
+static void LBM_PutLong(unsigned char *data, unsigned int value);
+static void LBM_PutWord(unsigned char *data, unsigned short value);
+static int LBM_FlushWrite(LBM_WriteStruct *output);
+static int LBM_Write(LBM_WriteStruct *output, const void *data, unsigned int length);
+static int LBM_GetBackgroundKey(const char *fileName, const OPM_Struct *pixel_map, LBM_BackgroundHeaderStruct *key);
+static int LBM_IsSameBackground(const LBM_BackgroundHeaderStruct *a, const LBM_BackgroundHeaderStruct *b);
+static int LBM_GetBackgroundCachePath(const LBM_BackgroundHeaderStruct *key, char *path);
+static int LBM_ReadBackgroundCache(const LBM_BackgroundHeaderStruct *key, LBM_BackgroundHeaderStruct *header, unsigned char *pixels);
+static void LBM_WriteBackgroundCache(const LBM_BackgroundHeaderStruct *header, const unsigned char *pixels);
+static int LBM_DisplayLBMinOPM(LBM_StreamStruct *stream, const LBM_ChunkTableStruct *table, const LBM_HeaderStruct *header, OPM_Struct *pixel_map);
+static int LBM_IsIndexedOPM(const char *text, const OPM_Struct *pixel_map);
+static void LBM_PrintData(char *buffer, LBM_ErrorStruct *data);
 
 LBM_LogPalette pal;
 
-void LBM_GetPal(unsigned char* data, LBM_LogPalette *pal)
+static LBM_BackgroundCacheStruct LBM_BackgroundCache;
+
+/* IFF stores all numbers in big endian byte order. */
+static unsigned int LBM_GetLong(const unsigned char *data)
+{
+    return ((unsigned int)data[0] << 24) | ((unsigned int)data[1] << 16) | ((unsigned int)data[2] << 8) | data[3];
+}
+
+static unsigned short LBM_GetWord(const unsigned char *data)
+{
+    return (unsigned short)((data[0] << 8) | data[1]);
+}
+
+static void LBM_PutLong(unsigned char *data, unsigned int value)
+{
+    data[0] = (unsigned char)(value >> 24);
+    data[1] = (unsigned char)(value >> 16);
+    data[2] = (unsigned char)(value >> 8);
+    data[3] = (unsigned char)value;
+}
+
+static void LBM_PutWord(unsigned char *data, unsigned short value)
 {
-    unsigned char* val;
+    data[0] = (unsigned char)(value >> 8);
+    data[1] = (unsigned char)value;
+}
+
+/* Whether the chunk is one of those the image is decoded from. */
+static int LBM_IsImageChunk(const unsigned char *chunk_header)
+{
+    return !memcmp(chunk_header, "BMHD", CHUNK_LENGTH) || !memcmp(chunk_header, "CMAP", CHUNK_LENGTH)
+           || !memcmp(chunk_header, "BODY", CHUNK_LENGTH);
+}
+
+/* Record one chunk of the FORM. The last three slots of the table are kept for the first BMHD, CMAP and BODY chunk,
+   so the image can be decoded however many other chunks come before them (e.g. DPaint writes many CRNG chunks);
+   other chunks that do not fit are left out, and a recorded chunk is never replaced. Returns the offset of the next
+   chunk; chunks are padded to an even length. */
+static unsigned int LBM_AddChunk(LBM_ChunkTableStruct *table, const unsigned char *chunk_header, unsigned int offset)
+{
+    unsigned int chunk_length;
+    LBM_ChunkStruct *chunk;
+
+    chunk_length = LBM_GetLong(&chunk_header[CHUNK_LENGTH]);
+    if (chunk_length > table->file_length - offset - CHUNK_HEADER_LENGTH)
+    {
+        chunk_length = table->file_length - offset - CHUNK_HEADER_LENGTH; /* truncated file */
+    }
+
+    if (table->number_of_chunks < LBM_MAX_CHUNKS - 3
+        || (table->number_of_chunks < LBM_MAX_CHUNKS && LBM_IsImageChunk(chunk_header)
+            && !LBM_FindChunk(table, (const char *)chunk_header)))
+    {
+        chunk = &table->chunk[table->number_of_chunks++];
+        memcpy(chunk->id, chunk_header, CHUNK_LENGTH);
+        chunk->offset = offset + CHUNK_HEADER_LENGTH;
+        chunk->length = chunk_length;
+    }
+
+    return offset + CHUNK_HEADER_LENGTH + chunk_length + (chunk_length & 1);
+}
+
+/* Check the 12 byte FORM header and set up an empty chunk table for a file of 'length' bytes. */
+static int LBM_InitChunks(const unsigned char *form_header, unsigned int length, LBM_ChunkTableStruct *table)
+{
+    unsigned int form_length;
+
+    memset(table, 0, sizeof(LBM_ChunkTableStruct));
+
+    if (length < FORM_HEADER_LENGTH || memcmp(form_header, "FORM", CHUNK_LENGTH))
+    {
+        return 0;
+    }
+
+    form_length = LBM_GetLong(&form_header[4]);
+    if (form_length > length - CHUNK_HEADER_LENGTH)
+    {
+        form_length = length - CHUNK_HEADER_LENGTH;
+    }
+    table->file_length = form_length + CHUNK_HEADER_LENGTH;
+    memcpy(table->form_type, &form_header[8], CHUNK_LENGTH);
+
+    return 1;
+}
+
+/* Walk the chunks of the IFF FORM in 'data' once and record their spans in 'table'. 'length' is the number of bytes
+   available; the chunks are bounded by it and by the length stored in the FORM header. */
+int LBM_ParseChunks(const unsigned char *data, unsigned int length, LBM_ChunkTableStruct *table)
+{
+    unsigned int offset;
+
+    if (!LBM_InitChunks(data, length, table))
+    {
+        return 0;
+    }
+
+    offset = FORM_HEADER_LENGTH;
+    while (offset + CHUNK_HEADER_LENGTH <= table->file_length)
+    {
+        offset = LBM_AddChunk(table, &data[offset], offset);
+    }
+
+    return 1;
+}
+
+/* Same as LBM_ParseChunks() for an open file; only the chunk headers are read. */
+static int LBM_ReadChunks(int file_handle, unsigned int length, LBM_ChunkTableStruct *table)
+{
+    unsigned char header[FORM_HEADER_LENGTH];
+    unsigned int offset;
+
+    if (length < FORM_HEADER_LENGTH || DOS_Read(file_handle, header, FORM_HEADER_LENGTH) != FORM_HEADER_LENGTH)
+    {
+        return 0;
+    }
+    if (!LBM_InitChunks(header, length, table))
+    {
+        return 0;
+    }
+
+    offset = FORM_HEADER_LENGTH;
+    while (offset + CHUNK_HEADER_LENGTH <= table->file_length)
+    {
+        if (!DOS_Seek(file_handle, DOS_SEEK_SET, offset) || DOS_Read(file_handle, header, CHUNK_HEADER_LENGTH) != CHUNK_HEADER_LENGTH)
+        {
+            return 0;
+        }
+        offset = LBM_AddChunk(table, header, offset);
+    }
+
+    return 1;
+}
+
+/* Return the first chunk with the given id or 0. */
+const LBM_ChunkStruct *LBM_FindChunk(const LBM_ChunkTableStruct *table, const char *id)
+{
+    unsigned int chunk_index;
+
+    for (chunk_index = 0; chunk_index < table->number_of_chunks; chunk_index++)
+    {
+        if (!memcmp(table->chunk[chunk_index].id, id, CHUNK_LENGTH))
+        {
+            return &table->chunk[chunk_index];
+        }
+    }
+
+    return 0;
+}
+
+/* Decode the contents of a BMHD chunk. */
+static int LBM_GetHeader(const unsigned char *bmhd, const LBM_ChunkTableStruct *table, LBM_HeaderStruct *header)
+{
+    header->width = LBM_GetWord(&bmhd[0]);
+    header->height = LBM_GetWord(&bmhd[2]);
+    header->x = (short)LBM_GetWord(&bmhd[4]);
+    header->y = (short)LBM_GetWord(&bmhd[6]);
+    header->number_of_planes = bmhd[8];
+    header->masking = bmhd[9];
+    header->compression = bmhd[10];
+    header->transparent_color = LBM_GetWord(&bmhd[12]);
+    header->page_width = LBM_GetWord(&bmhd[16]);
+    header->page_height = LBM_GetWord(&bmhd[18]);
+
+    /* Chunky images always have 8 planes, planar ones 1 to 8. */
+    if (header->number_of_planes < 1 || header->number_of_planes > 8
+        || (memcmp(table->form_type, "ILBM", CHUNK_LENGTH) && header->number_of_planes != 8))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Copy the colors of a CMAP chunk of 'length' bytes; entries missing from a short CMAP are set to black. */
+static void LBM_GetPal(const unsigned char *cmap, unsigned int length, LBM_LogPalette *pal)
+{
+    const unsigned char *val;
     unsigned short index;
-    LBM_PaletteEntry* palEntry = pal->pal_entry;
+    unsigned short number_of_colors;
+    LBM_PaletteEntry *palEntry = pal->pal_entry;
 
-    val = &data[48];
+    val = cmap;
+    number_of_colors = length / 3 < 256 ? length / 3 : 256;
 
-    for(index = 0; index < 256; index++)
+    for (index = 0; index < number_of_colors; index++)
     {
         palEntry[index].peRed = *val++;
 
@@ -65,123 +327,439 @@ void LBM_GetPal(unsigned char* data, LBM_LogPalette *pal)
 
         palEntry[index].peBlue = *val++;
     }
+    for (; index < 256; index++)
+    {
+        palEntry[index].peRed = 0;
+        palEntry[index].peGreen = 0;
+        palEntry[index].peBlue = 0;
+    }
     pal->number_of_entries = 256;
 }
 
-char * LBM_FindChunk(const char *data, char *chunk)
+/* Make sure at least 'length' bytes of the BODY (or all that is left of it) are available in the read-ahead buffer.
+   Images in memory are always completely available. */
+static int LBM_FillStream(LBM_StreamStruct *stream, unsigned int length)
 {
-    unsigned char chunk_counter;
-    unsigned short chunk_index;
-    unsigned int  data_counter;
-    char* ptrData;
+    unsigned int available;
+    unsigned int read_length;
 
-    ptrData = (char*)&data[0];
+    available = stream->end - stream->ptr;
+    if (available >= length || !stream->remaining)
+    {
+        return 1;
+    }
 
-    data_counter = 0;
+    if (available)
+    {
+        memmove(stream->buffer, stream->ptr, available);
+    }
 
-    while(data_counter <= *((unsigned int *)data))
+    read_length = stream->buffer_size - available;
+    if (read_length > stream->remaining)
     {
-        chunk_counter = 0;
+        read_length = stream->remaining;
+    }
+    if (DOS_Read(stream->file_handle, &stream->buffer[available], read_length) != (int)read_length)
+    {
+        return 0;
+    }
+
+    stream->remaining -= read_length;
+    stream->ptr = stream->buffer;
+    stream->end = stream->buffer + available + read_length;
+
+    return 1;
+}
+
+/* Decompress one ByteRun1 coded row of 'row_bytes' bytes. Only the bytes from 'x0' up to 'x1' are stored at
+   dst[x0] .. dst[x1 - 1]; 'dst' is not touched at all if 'x0' >= 'x1'. Runs never continue into the next row.
+   Returns the position of the next row in 'src', or 0 if 'src' ends in the middle of a replicate run. */
+static const unsigned char *LBM_UnpackRow(const unsigned char *src, const unsigned char *src_end, unsigned char *dst, int row_bytes, int x0, int x1)
+{
+    int x;
+    int count;
+    int start;
+    int end;
+    unsigned char value;
 
-        for(chunk_index = 0; chunk_index < CHUNK_LENGTH; chunk_index++)
+    if (x1 > row_bytes)
+    {
+        x1 = row_bytes;
+    }
+
+    x = 0;
+    while (x < row_bytes && src < src_end)
+    {
+        count = *src++;
+        if (count < 128)
         {
-            if(ptrData[chunk_index] == chunk[chunk_index])
+            /* literal run: copy the next count + 1 bytes */
+            count++;
+            if (count > src_end - src)
             {
-                chunk_counter++;
+                count = src_end - src;
             }
+            start = x > x0 ? x : x0;
+            end = x + count < x1 ? x + count : x1;
+            if (start < end)
+            {
+                memcpy(&dst[start], &src[start - x], end - start);
+            }
+            src += count;
+            x += count;
+        }
+        else if (count > 128)
+        {
+            /* replicate run: repeat the next byte 257 - count times */
+            count = 257 - count;
+            if (src >= src_end)
+            {
+                return 0;
+            }
+            value = *src++;
+            start = x > x0 ? x : x0;
+            end = x + count < x1 ? x + count : x1;
+            if (start < end)
+            {
+                memset(&dst[start], value, end - start);
+            }
+            x += count;
+        }
+        /* 128 is a no-op */
+    }
+
+    return src;
+}
+
+/* Transpose the 8x8 bit matrix whose rows are the bytes of 'x' and 'y' (most significant byte of 'x' first) in two
+   32 bit registers; see Hacker's Delight, section 7-3. The transpose is its own inverse, so it converts eight bytes of
+   bit planes into eight pixels as well as eight pixels into bit planes. */
+static void LBM_Transpose(unsigned int *x_ptr, unsigned int *y_ptr)
+{
+    unsigned int x;
+    unsigned int y;
+    unsigned int t;
+
+    x = *x_ptr;
+    y = *y_ptr;
+
+    t = (x ^ (x >> 7)) & 0x00AA00AA;
+    x = x ^ t ^ (t << 7);
+    t = (y ^ (y >> 7)) & 0x00AA00AA;
+    y = y ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC;
+    x = x ^ t ^ (t << 14);
+    t = (y ^ (y >> 14)) & 0x0000CCCC;
+    y = y ^ t ^ (t << 14);
+    t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+    y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+
+    *x_ptr = t;
+    *y_ptr = y;
+}
+
+/* Convert the bit planes of one ILBM row into chunky pixels and store the pixels from 'x0' up to 'x1' at dst[x].
+   Eight pixels at a time are converted with an 8x8 bit matrix transpose. Pixels whose bit in
+   the optional 'mask' plane is clear are not stored. */
+static void LBM_PlanarToChunky(const unsigned char *planes, int plane_bytes, int number_of_planes, const unsigned char *mask, unsigned char *dst, int x0, int x1)
+{
+    unsigned char plane_byte[8];
+    unsigned char pixel[8];
+    unsigned char mask_byte;
+    unsigned int x;
+    unsigned int y;
+    int group;
+    int plane_index;
+    int pixel_index;
+    int start;
+    int end;
+
+    memset(plane_byte, 0, sizeof(plane_byte));
+
+    for (group = x0 >> 3; group <= (x1 - 1) >> 3; group++)
+    {
+        for (plane_index = 0; plane_index < number_of_planes; plane_index++)
+        {
+            plane_byte[plane_index] = planes[plane_index * plane_bytes + group];
+        }
+
+        /* Bit i of plane p becomes bit p of pixel i. */
+        x = ((unsigned int)plane_byte[7] << 24) | ((unsigned int)plane_byte[6] << 16) | ((unsigned int)plane_byte[5] << 8) | plane_byte[4];
+        y = ((unsigned int)plane_byte[3] << 24) | ((unsigned int)plane_byte[2] << 16) | ((unsigned int)plane_byte[1] << 8) | plane_byte[0];
+        LBM_Transpose(&x, &y);
+
+        pixel[0] = (unsigned char)(x >> 24);
+        pixel[1] = (unsigned char)(x >> 16);
+        pixel[2] = (unsigned char)(x >> 8);
+        pixel[3] = (unsigned char)x;
+        pixel[4] = (unsigned char)(y >> 24);
+        pixel[5] = (unsigned char)(y >> 16);
+        pixel[6] = (unsigned char)(y >> 8);
+        pixel[7] = (unsigned char)y;
+
+        mask_byte = mask ? mask[group] : 0xFF;
+        start = group << 3;
+        end = start + 8;
+        if (start >= x0 && end <= x1 && mask_byte == 0xFF)
+        {
+            memcpy(&dst[start], pixel, 8);
+            continue;
         }
 
-        if (chunk_counter == CHUNK_LENGTH)
+        for (pixel_index = 0; pixel_index < 8; pixel_index++)
         {
-            return (char*)(data+data_counter);
+            if (start + pixel_index >= x0 && start + pixel_index < x1 && (mask_byte & (0x80 >> pixel_index)))
+            {
+                dst[start + pixel_index] = pixel[pixel_index];
+            }
         }
-        ptrData++;
-        data_counter++;
     }
+}
+
+/* Decode the BODY of a chunky (PBM) or planar (ILBM) image directly into the rows of 'pixel_map'. Clipping is done
+   once per row, runs are expanded with memset and literals with memcpy. The BODY is read from 'stream' row by row, so
+   an image read from a file only needs a small read-ahead buffer. */
+/* Whether 'pixel_map' has one byte per pixel, as the images are read and written; pushes the error 'text' if not. */
+static int LBM_IsIndexedOPM(const char *text, const OPM_Struct *pixel_map)
+{
+    LBM_ErrorStruct data;
+
+    if (pixel_map->bytes_per_pixel == 1)
+    {
+        return 1;
+    }
+
+    data.text = text;
+    data.data1 = pixel_map->bytes_per_pixel;
+    data.data2 = 0;
+    ERROR_PushError((ERROR_PrintErrorPtr)LBM_PrintData, "BBLBM Library", sizeof(data), (const char *) &data);
     return 0;
 }
 
-void LBM_DisplayLBMinOPM(char *file_handle, OPM_Struct *pixel_map)
+static int LBM_DisplayLBMinOPM(LBM_StreamStruct *stream, const LBM_ChunkTableStruct *table, const LBM_HeaderStruct *header, OPM_Struct *pixel_map)
 {
-    unsigned short lbmWidth;
-    unsigned short lbmHeight;
-    unsigned int index_width;
-    unsigned int index_height;
-    char* body;
-    char color;
-    int x,y, rept, idxX, idxY;
+    const unsigned char *planes;
+    unsigned char *row_buffer;
+    unsigned char *dst;
+    int is_planar;
+    int number_of_planes;
+    int plane_bytes;
+    int row_bytes;
+    int max_row_bytes;
+    int plane_index;
+    int x0;
+    int x1;
+    int y;
+    int pixel_map_y;
+    int clip_bottom;
+    int available;
+    int retVal;
 
-    body = LBM_FindChunk(file_handle, "BODY");
-    body += 4;
+    is_planar = !memcmp(table->form_type, "ILBM", CHUNK_LENGTH);
+    if (is_planar)
+    {
+        /* Every row holds one line per bit plane, each padded to 16 pixels, followed by an optional mask line. */
+        number_of_planes = header->number_of_planes + (header->masking == LBM_MASK_HAS_MASK ? 1 : 0);
+        plane_bytes = ((header->width + 15) >> 4) << 1;
+    }
+    else
+    {
+        /* PBM rows are padded to an even number of bytes. */
+        number_of_planes = 1;
+        plane_bytes = (header->width + 1) & ~1;
+    }
+    row_bytes = number_of_planes * plane_bytes;
+
+    /* A ByteRun1 coded line is at most one control byte per 128 bytes longer than the line itself. */
+    max_row_bytes = header->compression ? number_of_planes * (plane_bytes + (plane_bytes + 127) / 128) : row_bytes;
+
+    /* Visible columns of the image. */
+    x0 = pixel_map->clip_x - pixel_map->origin_x;
+    if (x0 < 0)
+    {
+        x0 = 0;
+    }
+    x1 = pixel_map->clip_x + pixel_map->clip_width - pixel_map->origin_x;
+    if (x1 > header->width)
+    {
+        x1 = header->width;
+    }
+    if (x0 >= x1)
+    {
+        return 1;
+    }
+
+    /* One allocation holds the planes of the current row and, for files, the read-ahead buffer. */
+    stream->buffer_size = 0;
+    if (stream->remaining)
+    {
+        stream->buffer_size = max_row_bytes > LBM_READ_AHEAD_SIZE ? max_row_bytes : LBM_READ_AHEAD_SIZE;
+    }
+    row_buffer = 0;
+    if (stream->buffer_size || (is_planar && header->compression))
+    {
+        row_buffer = (unsigned char *)BASEMEM_Alloc(row_bytes + stream->buffer_size, BASEMEM_XMS_MEMORY);
+        if (!row_buffer)
+        {
+            return 0;
+        }
+        stream->buffer = &row_buffer[row_bytes];
+    }
 
-    lbmWidth = abs((file_handle[LBM_W_HIBYTE] << 8) + file_handle[LBM_W_LOBYTE]);
-    lbmHeight = abs((file_handle[LBM_H_HIBYTE] << 8) + file_handle[LBM_H_LOBYTE]);
+    retVal = 1;
+    clip_bottom = pixel_map->clip_y + pixel_map->clip_height;
 
-    if(file_handle[LBM_COMPRESSION_BYTE] != 0)
+    for (y = 0; y < header->height; y++)
     {
-        x = 0;
-        y = 0;
-        do
+        pixel_map_y = y + pixel_map->origin_y;
+        if (pixel_map_y >= clip_bottom)
+        {
+            break;
+        }
+
+        if (!LBM_FillStream(stream, max_row_bytes))
+        {
+            retVal = 0;
+            break;
+        }
+        if (stream->ptr >= stream->end)
+        {
+            break;
+        }
+
+        if (pixel_map_y >= pixel_map->clip_y)
+        {
+            dst = &pixel_map->buffer[pixel_map_y * pixel_map->stride + pixel_map->origin_x];
+            OPM_AddDirtyRect(pixel_map, pixel_map->origin_x + x0, pixel_map_y, x1 - x0, 1);
+        }
+        else
         {
-            rept = *body++;
-            if ( rept >= 128 )
+            dst = 0;
+        }
+
+        if (!is_planar)
+        {
+            if (header->compression)
             {
-                if ( rept > 128 )
+                stream->ptr = LBM_UnpackRow(stream->ptr, stream->end, dst, plane_bytes, x0, dst ? x1 : 0);
+                if (!stream->ptr)
                 {
-                    color = *body++;
-                    for ( idxX = 0; idxX < (257 - rept); ++idxX )
-                    {
-                        OPM_SetPixel(pixel_map, x, y, color);
-                        x++;
-                    }
+                    retVal = 0;
+                    break;
                 }
             }
             else
             {
-                for ( idxY = 0; idxY < (rept + 1); ++idxY )
+                /* uncompressed rows are copied as a whole */
+                available = stream->end - stream->ptr < x1 ? stream->end - stream->ptr : x1;
+                if (dst && x0 < available)
                 {
-                    color = *body++;
-                    OPM_SetPixel(pixel_map, x, y, color);
-                    x++;
+                    memcpy(&dst[x0], &stream->ptr[x0], available - x0);
                 }
+                stream->ptr += stream->end - stream->ptr < plane_bytes ? stream->end - stream->ptr : plane_bytes;
+            }
+            continue;
+        }
+
+        if (header->compression)
+        {
+            for (plane_index = 0; plane_index < number_of_planes && stream->ptr; plane_index++)
+            {
+                stream->ptr = LBM_UnpackRow(stream->ptr, stream->end, &row_buffer[plane_index * plane_bytes], plane_bytes, 0, dst ? plane_bytes : 0);
             }
-            if ( x >= lbmWidth )
+            if (!stream->ptr)
             {
-                x = 0;
-                ++y;
+                retVal = 0;
+                break;
             }
+            planes = row_buffer;
         }
-        while ( y < lbmHeight );
-    }
-    else
-    {
-        for ( index_height = 0; index_height < lbmHeight; ++index_height )
+        else
+        {
+            if (stream->end - stream->ptr < row_bytes)
+            {
+                break;
+            }
+            planes = stream->ptr;
+            stream->ptr += row_bytes;
+        }
+
+        if (dst)
         {
-          for ( index_width = 0; index_width < lbmWidth; ++index_width )
-          {
-            color = *body++;
-            OPM_SetPixel(pixel_map, index_width, index_height, color);
-          }
+            LBM_PlanarToChunky(planes, plane_bytes, header->number_of_planes,
+                               header->masking == LBM_MASK_HAS_MASK ? &planes[header->number_of_planes * plane_bytes] : 0,
+                               dst, x0, x1);
         }
     }
+
+    if (row_buffer)
+    {
+        BASEMEM_Free(row_buffer);
+    }
+
+    return retVal;
 }
 
+/* Load the image 'fileName' (or, with flag 0x10000, the image data at 'fileName') into 'pixel_map'.
+   Flag 1 creates a new pixel map of the image size, flag 2 resizes the existing one; an existing pixel map has to have
+   one byte per pixel.
+   Files are not loaded as a whole: only the chunk headers, BMHD and CMAP are read before the BODY is streamed. */
 unsigned int LBM_DisplayLBM(char *fileName, OPM_Struct *pixel_map, LBM_LogPalette *pal, int flags)
 {
-    const char *file_handle;
+    const unsigned char *file_data;
+    int file_handle;
     int fileLen;
-    char* bmhd;
-    char* body;
-    char* cmap;
-    unsigned short lbmWidth;
-    unsigned short lbmHeight;
+    LBM_ChunkTableStruct table;
+    LBM_HeaderStruct header;
+    LBM_StreamStruct stream;
+    const LBM_ChunkStruct *bmhd;
+    const LBM_ChunkStruct *body;
+    const LBM_ChunkStruct *cmap;
+    unsigned char bmhd_data[BMHD_LENGTH];
+    unsigned char cmap_data[256 * 3];
+    unsigned int cmap_length;
     unsigned int pixel_map_size;
     unsigned int retVal;
 
-    if ( flags & 0x10000 )
+    memset(&stream, 0, sizeof(stream));
+    file_handle = -1;
+    cmap_length = 0;
+    retVal = 0;
+
+    if ( !(flags & LBM_FLAG_NEW_OPM) && !LBM_IsIndexedOPM("LBM_DisplayLBM: pixel map is not 8 bit, bytes per pixel:", pixel_map) )
     {
-        file_handle = fileName;
-        fileLen = 100000000;
+        return 0;
+    }
+
+    if ( flags & LBM_FLAG_IN_MEMORY )
+    {
+        /* The FORM header tells how long the image data is. */
+        file_data = (const unsigned char *)fileName;
+        fileLen = LBM_GetLong(&file_data[4]) + CHUNK_HEADER_LENGTH;
+
+        if ( !LBM_ParseChunks(file_data, fileLen, &table) )
+        {
+            return 0;
+        }
+
+        bmhd = LBM_FindChunk(&table, "BMHD");
+        body = LBM_FindChunk(&table, "BODY");
+        cmap = LBM_FindChunk(&table, "CMAP");
+        if ( !bmhd || bmhd->length < BMHD_LENGTH || !body )
+        {
+            return 0;
+        }
+
+        memcpy(bmhd_data, &file_data[bmhd->offset], BMHD_LENGTH);
+        if ( cmap )
+        {
+            cmap_length = cmap->length < sizeof(cmap_data) ? cmap->length : sizeof(cmap_data);
+            memcpy(cmap_data, &file_data[cmap->offset], cmap_length);
+        }
+
+        stream.file_handle = -1;
+        stream.ptr = &file_data[body->offset];
+        stream.end = stream.ptr + body->length;
     }
     else
     {
@@ -191,66 +769,622 @@ unsigned int LBM_DisplayLBM(char *fileName, OPM_Struct *pixel_map, LBM_LogPalett
             return 0;
         }
 
-        file_handle = (const char*)DOS_ReadFile(fileName, 0, 0);
-        if ( !file_handle )
+        file_handle = DOS_Open(fileName, DOS_OPEN_MODE_READ);
+        if ( file_handle < 0 )
         {
             return 0;
         }
+
+        if ( !LBM_ReadChunks(file_handle, fileLen, &table) )
+        {
+            DOS_Close(file_handle);
+            return 0;
+        }
+
+        bmhd = LBM_FindChunk(&table, "BMHD");
+        body = LBM_FindChunk(&table, "BODY");
+        cmap = LBM_FindChunk(&table, "CMAP");
+        if ( !bmhd || bmhd->length < BMHD_LENGTH || !body
+            || !DOS_Seek(file_handle, DOS_SEEK_SET, bmhd->offset)
+            || DOS_Read(file_handle, bmhd_data, BMHD_LENGTH) != BMHD_LENGTH )
+        {
+            DOS_Close(file_handle);
+            return 0;
+        }
+
+        if ( cmap )
+        {
+            cmap_length = cmap->length < sizeof(cmap_data) ? cmap->length : sizeof(cmap_data);
+            if ( !DOS_Seek(file_handle, DOS_SEEK_SET, cmap->offset)
+                || DOS_Read(file_handle, cmap_data, cmap_length) != (int)cmap_length )
+            {
+                DOS_Close(file_handle);
+                return 0;
+            }
+        }
+
+        if ( !DOS_Seek(file_handle, DOS_SEEK_SET, body->offset) )
+        {
+            DOS_Close(file_handle);
+            return 0;
+        }
+
+        stream.file_handle = file_handle;
+        stream.remaining = body->length;
+    }
+
+    if ( LBM_GetHeader(bmhd_data, &table, &header) )
+    {
+        retVal = 1;
+
+        if ( pal && cmap )
+        {
+            LBM_GetPal(cmap_data, cmap_length, pal);
+        }
+
+        if ( flags & LBM_FLAG_NEW_OPM )
+        {
+            retVal = OPM_New(header.width, header.height, 1u, pixel_map, 0);
+        }
+        else if ( flags & LBM_FLAG_RESIZE_OPM )
+        {
+            pixel_map->width = header.width;
+            pixel_map->height = header.height;
+            pixel_map->stride = pixel_map->width * pixel_map->bytes_per_pixel;
+            pixel_map_size = pixel_map->width * pixel_map->height;
+            pixel_map->clip_x = 0;
+            pixel_map->clip_y = 0;
+            pixel_map->size = pixel_map->bytes_per_pixel * pixel_map_size;
+            pixel_map->clip_width = pixel_map->width;
+            pixel_map->clip_height = pixel_map->height;
+        }
+
+        if ( retVal )
+        {
+            retVal = LBM_DisplayLBMinOPM(&stream, &table, &header, pixel_map);
+        }
+    }
+
+    if ( file_handle >= 0 )
+    {
+        DOS_Close(file_handle);
     }
 
-    bmhd = LBM_FindChunk(file_handle, "BMHD");
-    if (bmhd == NULL)
+    return retVal;
+}
+
+/* Key of a screen-sized background: the source file, its time stamp and size and the target resolution. */
+static int LBM_GetBackgroundKey(const char *fileName, const OPM_Struct *pixel_map, LBM_BackgroundHeaderStruct *key)
+{
+    struct stat file_status;
+
+    if (stat(fileName, &file_status))
+    {
+        return 0;
+    }
+
+    memset(key, 0, sizeof(LBM_BackgroundHeaderStruct));
+    memcpy(key->magic, LBM_BACKGROUND_MAGIC, CHUNK_LENGTH);
+    key->version = LBM_BACKGROUND_VERSION;
+    strncpy(key->path, fileName, sizeof(key->path) - 1);
+    key->mtime = file_status.st_mtime;
+    key->size = file_status.st_size;
+    key->width = pixel_map->width;
+    key->height = pixel_map->height;
+
+    return 1;
+}
+
+static int LBM_IsSameBackground(const LBM_BackgroundHeaderStruct *a, const LBM_BackgroundHeaderStruct *b)
+{
+    return !memcmp(a->magic, b->magic, CHUNK_LENGTH) && a->version == b->version && !stricmp(a->path, b->path)
+           && a->mtime == b->mtime && a->size == b->size && a->width == b->width && a->height == b->height;
+}
+
+/* Name of the disk cache file for 'key' in the directory named by TEMP or TMP; 0 if there is none. */
+static int LBM_GetBackgroundCachePath(const LBM_BackgroundHeaderStruct *key, char *path)
+{
+    const char *temp_dir;
+    const char *ptr;
+    unsigned int hash;
+    unsigned int length;
+
+    temp_dir = getenv("TEMP");
+    if (!temp_dir || !*temp_dir)
+    {
+        temp_dir = getenv("TMP");
+    }
+    if (!temp_dir || !*temp_dir || strlen(temp_dir) > 128)
+    {
+        return 0;
+    }
+
+    hash = 2166136261u;
+    for (ptr = key->path; *ptr; ptr++)
+    {
+        hash = (hash ^ (unsigned char)toupper(*ptr)) * 16777619u;
+    }
+    hash = (hash ^ key->width) * 16777619u;
+    hash = (hash ^ key->height) * 16777619u;
+
+    length = strlen(temp_dir);
+    sprintf(path, "%s%sBG%06X.BGC", temp_dir, temp_dir[length - 1] == '\\' ? "" : "\\", hash & 0xFFFFFF);
+
+    return 1;
+}
+
+/* Read the screen-sized pixels of a background from the disk cache. */
+static int LBM_ReadBackgroundCache(const LBM_BackgroundHeaderStruct *key, LBM_BackgroundHeaderStruct *header, unsigned char *pixels)
+{
+    char path[144];
+    int file_handle;
+    int length;
+    int retVal;
+
+    if (!LBM_GetBackgroundCachePath(key, path))
     {
         return 0;
     }
 
-    body = LBM_FindChunk(file_handle, "BODY");
-    if (body == NULL)
+    file_handle = open(path, O_RDONLY | O_BINARY);
+    if (file_handle == -1)
     {
         return 0;
     }
 
-    cmap = LBM_FindChunk(file_handle, "CMAP");
-    if (cmap == NULL)
+    length = key->width * key->height;
+    retVal = read(file_handle, header, sizeof(LBM_BackgroundHeaderStruct)) == sizeof(LBM_BackgroundHeaderStruct)
+             && LBM_IsSameBackground(header, key)
+             && read(file_handle, pixels, length) == length;
+    close(file_handle);
+
+    return retVal;
+}
+
+/* Store the screen-sized pixels of a background in the disk cache. Failing to do so is not an error. */
+static void LBM_WriteBackgroundCache(const LBM_BackgroundHeaderStruct *header, const unsigned char *pixels)
+{
+    char path[144];
+    int file_handle;
+    int length;
+
+    if (!LBM_GetBackgroundCachePath(header, path))
+    {
+        return;
+    }
+
+    file_handle = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0x1FF);
+    if (file_handle == -1)
+    {
+        return;
+    }
+
+    length = header->width * header->height;
+    if (write(file_handle, header, sizeof(LBM_BackgroundHeaderStruct)) != sizeof(LBM_BackgroundHeaderStruct)
+        || write(file_handle, pixels, length) != length)
+    {
+        close(file_handle);
+        unlink(path);
+        return;
+    }
+    close(file_handle);
+}
+
+/* Load the image 'fileName' stretched to the size of 'pixel_map'. The stretched pixels and the palette are kept in
+   memory for the rest of the run and in a raw file in the TEMP directory, so loading the same background again is
+   one read (or none) and a copy instead of decoding and stretching the image. */
+unsigned int LBM_LoadBackground(char *fileName, OPM_Struct *pixel_map, LBM_LogPalette *pal)
+{
+    LBM_BackgroundHeaderStruct key;
+    OPM_Struct image_pixel_map;
+    OPM_Struct background_pixel_map;
+    unsigned char *pixels;
+    int y;
+
+    if (!LBM_IsIndexedOPM("LBM_LoadBackground: pixel map is not 8 bit, bytes per pixel:", pixel_map)
+        || !LBM_GetBackgroundKey(fileName, pixel_map, &key))
     {
         return 0;
     }
 
-    if ( pal )
+    if (!LBM_BackgroundCache.pixels || !LBM_IsSameBackground(&LBM_BackgroundCache.header, &key))
+    {
+        if (LBM_BackgroundCache.pixels)
+        {
+            BASEMEM_Free(LBM_BackgroundCache.pixels);
+            LBM_BackgroundCache.pixels = 0;
+        }
+
+        pixels = (unsigned char *)BASEMEM_Alloc(key.width * key.height, BASEMEM_XMS_MEMORY);
+        if (!pixels)
+        {
+            return 0;
+        }
+
+        if (!LBM_ReadBackgroundCache(&key, &LBM_BackgroundCache.header, pixels))
+        {
+            if (!LBM_DisplayLBM(fileName, &image_pixel_map, &key.pal, LBM_FLAG_NEW_OPM))
+            {
+                BASEMEM_Free(pixels);
+                return 0;
+            }
+
+            OPM_New(key.width, key.height, 1u, &background_pixel_map, pixels);
+            if (image_pixel_map.width == key.width && image_pixel_map.height == key.height)
+            {
+                memcpy(pixels, image_pixel_map.buffer, key.width * key.height);
+            }
+            else
+            {
+                DSA_StretchOPMToScreen(&image_pixel_map, &background_pixel_map);
+            }
+            OPM_Del(&background_pixel_map);
+            OPM_Del(&image_pixel_map);
+
+            LBM_BackgroundCache.header = key;
+            LBM_WriteBackgroundCache(&key, pixels);
+        }
+
+        LBM_BackgroundCache.pixels = pixels;
+    }
+
+    if (pal)
+    {
+        memcpy(pal, &LBM_BackgroundCache.header.pal, sizeof(LBM_LogPalette));
+    }
+
+    for (y = 0; y < pixel_map->height; y++)
+    {
+        memcpy(&pixel_map->buffer[y * pixel_map->stride], &LBM_BackgroundCache.pixels[y * pixel_map->width], pixel_map->width);
+    }
+    OPM_AddDirtyRect(pixel_map, 0, 0, pixel_map->width, pixel_map->height);
+
+    return 1;
+}
+
+/* Convert 'width' chunky pixels into the 8 bit planes of one ILBM row of 'plane_bytes' bytes per plane. Pixels behind
+   'width' are 0. */
+static void LBM_ChunkyToPlanar(const unsigned char *src, int width, int plane_bytes, unsigned char *planes)
+{
+    unsigned char pixel[8];
+    unsigned int x;
+    unsigned int y;
+    int group;
+    int count;
+
+    for (group = 0; group < plane_bytes; group++)
+    {
+        count = width - (group << 3);
+        if (count >= 8)
+        {
+            memcpy(pixel, &src[group << 3], 8);
+        }
+        else
+        {
+            memset(pixel, 0, 8);
+            if (count > 0)
+            {
+                memcpy(pixel, &src[group << 3], count);
+            }
+        }
+
+        /* Bit p of pixel i becomes bit i of plane p. */
+        x = ((unsigned int)pixel[0] << 24) | ((unsigned int)pixel[1] << 16) | ((unsigned int)pixel[2] << 8) | pixel[3];
+        y = ((unsigned int)pixel[4] << 24) | ((unsigned int)pixel[5] << 16) | ((unsigned int)pixel[6] << 8) | pixel[7];
+        LBM_Transpose(&x, &y);
+
+        planes[7 * plane_bytes + group] = (unsigned char)(x >> 24);
+        planes[6 * plane_bytes + group] = (unsigned char)(x >> 16);
+        planes[5 * plane_bytes + group] = (unsigned char)(x >> 8);
+        planes[4 * plane_bytes + group] = (unsigned char)x;
+        planes[3 * plane_bytes + group] = (unsigned char)(y >> 24);
+        planes[2 * plane_bytes + group] = (unsigned char)(y >> 16);
+        planes[1 * plane_bytes + group] = (unsigned char)(y >> 8);
+        planes[group] = (unsigned char)y;
+    }
+}
+
+/* Number of bytes at the start of 'src' that are equal to src[0], at most 'length'. Four bytes are compared at a
+   time. */
+static int LBM_GetRunLength(const unsigned char *src, int length)
+{
+    unsigned int pattern;
+    unsigned int word;
+    int count;
+
+    pattern = src[0] * 0x01010101u;
+    count = 1;
+    while (count + 4 <= length)
     {
-        LBM_GetPal((unsigned char*)file_handle, pal);
+        memcpy(&word, &src[count], 4);
+        if (word != pattern)
+        {
+            break;
+        }
+        count += 4;
     }
+    while (count < length && src[count] == src[0])
+    {
+        count++;
+    }
+
+    return count;
+}
+
+/* Number of bytes at the start of 'src' up to the next run of three equal bytes, at most 'length'. Four bytes are
+   skipped at a time as long as no two neighbouring bytes are equal, which is tested for with the zero byte test of
+   the difference of two overlapping words. */
+static int LBM_GetLiteralLength(const unsigned char *src, int length)
+{
+    unsigned int word;
+    unsigned int next_word;
+    unsigned int diff;
+    int count;
+
+    for (count = 1; count < length; count++)
+    {
+        while (count + 5 <= length)
+        {
+            memcpy(&word, &src[count], 4);
+            memcpy(&next_word, &src[count + 1], 4);
+            diff = word ^ next_word;
+            if ((diff - 0x01010101u) & ~diff & 0x80808080u)
+            {
+                break;
+            }
+            count += 4;
+        }
+
+        if (count + 2 < length && src[count] == src[count + 1] && src[count] == src[count + 2])
+        {
+            break;
+        }
+    }
+
+    return count;
+}
 
-    lbmWidth = abs((bmhd[BMHD_W_HIBYTE] << 8) + bmhd[BMHD_W_LOBYTE]);
-    lbmHeight = abs((bmhd[BMHD_H_HIBYTE] << 8) + bmhd[BMHD_H_LOBYTE]);
+/* ByteRun1 code the 'length' bytes at 'src' into 'dst', which must hold length + (length + 127) / 128 bytes. Runs of
+   two or more bytes are replicated unless they are part of a literal; literals end before runs of three. Returns the
+   number of bytes stored. */
+static int LBM_PackRow(const unsigned char *src, int length, unsigned char *dst)
+{
+    unsigned char *out;
+    int x;
+    int count;
+    int max_count;
 
-    if ( flags & 1 )
+    out = dst;
+    for (x = 0; x < length; x += count)
     {
-        retVal = OPM_New(lbmWidth, lbmHeight, 1u, pixel_map, 0);
-        if ( !retVal )
+        max_count = length - x < 128 ? length - x : 128;
+        count = LBM_GetRunLength(&src[x], max_count);
+        if (count >= 2)
+        {
+            *out++ = (unsigned char)(257 - count);
+            *out++ = src[x];
+        }
+        else
         {
-            return retVal;
+            count = LBM_GetLiteralLength(&src[x], max_count);
+            *out++ = (unsigned char)(count - 1);
+            memcpy(out, &src[x], count);
+            out += count;
         }
     }
-    else if ( flags & 2 )
+
+    return out - dst;
+}
+
+static int LBM_FlushWrite(LBM_WriteStruct *output)
+{
+    if (output->used && DOS_Write(output->file_handle, output->buffer, output->used) != (int)output->used)
     {
-        pixel_map->width = lbmWidth;
-        pixel_map->height = lbmHeight;
-        pixel_map->stride = pixel_map->width;
-        pixel_map_size = pixel_map->width * pixel_map->height;
-        pixel_map->clip_x = 0;
-        pixel_map->clip_y = 0;
-        pixel_map->size = pixel_map->bytes_per_pixel * pixel_map_size;
-        pixel_map->clip_width = pixel_map->width;
-        pixel_map->clip_height = pixel_map->height;
+        return 0;
     }
 
-    LBM_DisplayLBMinOPM((char *)file_handle, pixel_map);
+    output->offset += output->used;
+    output->used = 0;
 
-    if ( !(flags & 1) )
+    return 1;
+}
+
+static int LBM_Write(LBM_WriteStruct *output, const void *data, unsigned int length)
+{
+    if (output->used + length > LBM_WRITE_BUFFER_SIZE && !LBM_FlushWrite(output))
     {
-        BASEMEM_Free((void *)file_handle);
+        return 0;
     }
 
+    if (length > LBM_WRITE_BUFFER_SIZE)
+    {
+        if (DOS_Write(output->file_handle, data, length) != (int)length)
+        {
+            return 0;
+        }
+        output->offset += length;
+        return 1;
+    }
+
+    memcpy(&output->buffer[output->used], data, length);
+    output->used += length;
+
     return 1;
 }
+
+/* Save 'pixel_map' as the ByteRun1 coded image 'fileName': chunky PBM, or planar ILBM with flag LBM_SAVE_FLAG_ILBM.
+   Flag LBM_SAVE_FLAG_UNCOMPRESSED stores the rows as they are. The CMAP holds 'pal', or the active palette if 'pal' is 0. The file is written through one buffer; only the FORM
+   and BODY lengths are written again at the end. */
+unsigned int LBM_SaveOPM(char *fileName, OPM_Struct *pixel_map, LBM_LogPalette *pal, int flags)
+{
+    LBM_WriteStruct output;
+    unsigned char header_data[FORM_HEADER_LENGTH + CHUNK_HEADER_LENGTH + BMHD_LENGTH];
+    unsigned char chunk_header[CHUNK_HEADER_LENGTH];
+    unsigned char cmap_data[256 * 3 + 1];
+    unsigned char length_data[4];
+    unsigned char *bmhd;
+    unsigned char *row_buffer;
+    unsigned char *pack_buffer;
+    const unsigned char *src;
+    int is_planar;
+    int is_packed;
+    int number_of_planes;
+    int plane_bytes;
+    int plane_index;
+    int packed_length;
+    int y;
+    unsigned int number_of_colors;
+    unsigned int color_index;
+    unsigned int body_offset;
+    unsigned int body_length;
+    int retVal;
+
+    if (!LBM_IsIndexedOPM("LBM_SaveOPM: pixel map is not 8 bit, bytes per pixel:", pixel_map) || !pixel_map->width || !pixel_map->height)
+    {
+        return 0;
+    }
+
+    if (!pal)
+    {
+        pal = DSA_globalParams.global_palette_data;
+    }
+
+    is_planar = (flags & LBM_SAVE_FLAG_ILBM) != 0;
+    is_packed = !(flags & LBM_SAVE_FLAG_UNCOMPRESSED);
+    if (is_planar)
+    {
+        number_of_planes = 8;
+        plane_bytes = ((pixel_map->width + 15) >> 4) << 1;
+    }
+    else
+    {
+        number_of_planes = 1;
+        plane_bytes = (pixel_map->width + 1) & ~1;
+    }
+
+    output.buffer = (unsigned char *)BASEMEM_Alloc(LBM_WRITE_BUFFER_SIZE + number_of_planes * plane_bytes + plane_bytes + (plane_bytes + 127) / 128, BASEMEM_XMS_MEMORY | BASEMEM_ZERO_MEMORY);
+    if (!output.buffer)
+    {
+        return 0;
+    }
+    row_buffer = &output.buffer[LBM_WRITE_BUFFER_SIZE];
+    pack_buffer = &row_buffer[number_of_planes * plane_bytes];
+
+    output.file_handle = DOS_Open(fileName, DOS_OPEN_MODE_CREATE);
+    if (output.file_handle < 0)
+    {
+        BASEMEM_Free(output.buffer);
+        return 0;
+    }
+    output.used = 0;
+    output.offset = 0;
+
+    /* The FORM length is not known yet. */
+    memcpy(&header_data[0], "FORM", CHUNK_LENGTH);
+    LBM_PutLong(&header_data[4], 0);
+    memcpy(&header_data[8], is_planar ? "ILBM" : "PBM ", CHUNK_LENGTH);
+
+    memcpy(&header_data[FORM_HEADER_LENGTH], "BMHD", CHUNK_LENGTH);
+    LBM_PutLong(&header_data[FORM_HEADER_LENGTH + 4], BMHD_LENGTH);
+    bmhd = &header_data[FORM_HEADER_LENGTH + CHUNK_HEADER_LENGTH];
+    memset(bmhd, 0, BMHD_LENGTH);
+    LBM_PutWord(&bmhd[0], pixel_map->width);
+    LBM_PutWord(&bmhd[2], pixel_map->height);
+    bmhd[8] = 8;                    /* number of planes */
+    bmhd[10] = is_packed;           /* ByteRun1 or none */
+    bmhd[14] = 1;                   /* pixel aspect ratio */
+    bmhd[15] = 1;
+    LBM_PutWord(&bmhd[16], pixel_map->width);
+    LBM_PutWord(&bmhd[18], pixel_map->height);
+
+    retVal = LBM_Write(&output, header_data, sizeof(header_data));
+
+    if (retVal && pal && pal->number_of_entries)
+    {
+        number_of_colors = pal->number_of_entries < 256 ? pal->number_of_entries : 256;
+        for (color_index = 0; color_index < number_of_colors; color_index++)
+        {
+            cmap_data[color_index * 3] = pal->pal_entry[color_index].peRed;
+            cmap_data[color_index * 3 + 1] = pal->pal_entry[color_index].peGreen;
+            cmap_data[color_index * 3 + 2] = pal->pal_entry[color_index].peBlue;
+        }
+        cmap_data[number_of_colors * 3] = 0;
+
+        memcpy(chunk_header, "CMAP", CHUNK_LENGTH);
+        LBM_PutLong(&chunk_header[4], number_of_colors * 3);
+        retVal = LBM_Write(&output, chunk_header, CHUNK_HEADER_LENGTH)
+                 && LBM_Write(&output, cmap_data, (number_of_colors * 3 + 1) & ~1);
+    }
+
+    /* The BODY length is not known yet either. */
+    memcpy(chunk_header, "BODY", CHUNK_LENGTH);
+    LBM_PutLong(&chunk_header[4], 0);
+    retVal = retVal && LBM_Write(&output, chunk_header, CHUNK_HEADER_LENGTH);
+    body_offset = output.offset + output.used;
+
+    for (y = 0; retVal && y < pixel_map->height; y++)
+    {
+        src = &pixel_map->buffer[y * pixel_map->stride];
+        if (is_planar)
+        {
+            LBM_ChunkyToPlanar(src, pixel_map->width, plane_bytes, row_buffer);
+            src = row_buffer;
+        }
+        else if (plane_bytes != pixel_map->width)
+        {
+            /* the pad byte of odd rows is 0 */
+            memcpy(row_buffer, src, pixel_map->width);
+            src = row_buffer;
+        }
+
+        for (plane_index = 0; retVal && plane_index < number_of_planes; plane_index++)
+        {
+            if (is_packed)
+            {
+                packed_length = LBM_PackRow(&src[plane_index * plane_bytes], plane_bytes, pack_buffer);
+                retVal = LBM_Write(&output, pack_buffer, packed_length);
+            }
+            else
+            {
+                retVal = LBM_Write(&output, &src[plane_index * plane_bytes], plane_bytes);
+            }
+        }
+    }
+
+    body_length = output.offset + output.used - body_offset;
+    if (retVal && (body_length & 1))
+    {
+        length_data[0] = 0;
+        retVal = LBM_Write(&output, length_data, 1);
+    }
+
+    if (retVal && LBM_FlushWrite(&output))
+    {
+        LBM_PutLong(length_data, output.offset - CHUNK_HEADER_LENGTH);
+        retVal = DOS_Seek(output.file_handle, DOS_SEEK_SET, 4)
+                 && DOS_Write(output.file_handle, length_data, 4) == 4;
+
+        LBM_PutLong(length_data, body_length);
+        retVal = retVal && DOS_Seek(output.file_handle, DOS_SEEK_SET, body_offset - 4)
+                 && DOS_Write(output.file_handle, length_data, 4) == 4;
+    }
+    else
+    {
+        retVal = 0;
+    }
+
+    DOS_Close(output.file_handle);
+    BASEMEM_Free(output.buffer);
+
+    if (!retVal)
+    {
+        unlink(fileName);
+    }
+
+    return retVal;
+}
+
+static void LBM_PrintData(char *buffer, LBM_ErrorStruct *data)
+{
+    sprintf(buffer, "ERROR!: %s  %ld, %ld", data->text, (long int)data->data1, (long int)data->data2);
+}
@@ -26,9 +26,51 @@
 #define LBM_H
 
 #include <stdint.h>
+#include "DSA.h"
+
+#define LBM_MAX_CHUNKS 32
+
+#define LBM_SAVE_FLAG_ILBM 1
+#define LBM_SAVE_FLAG_UNCOMPRESSED 2
+
+/* Span of one IFF chunk; 'offset' points to the chunk data behind the 8 byte chunk header. */
+typedef struct
+{
+    char id[4];
+    unsigned int offset;
+    unsigned int length;
+} LBM_ChunkStruct;
+
+/* Result of a single walk over the chunks of an IFF FORM. */
+typedef struct
+{
+    char form_type[4];          /* "PBM " or "ILBM" */
+    unsigned int file_length;   /* length of the FORM including its header, bounded by the data available */
+    unsigned int number_of_chunks;
+    LBM_ChunkStruct chunk[LBM_MAX_CHUNKS];
+} LBM_ChunkTableStruct;
+
+/* Decoded BMHD chunk. */
+typedef struct
+{
+    unsigned short width;
+    unsigned short height;
+    short x;
+    short y;
+    unsigned char number_of_planes;
+    unsigned char masking;
+    unsigned char compression;
+    unsigned short transparent_color;
+    unsigned short page_width;
+    unsigned short page_height;
+} LBM_HeaderStruct;
 
 extern LBM_LogPalette pal;
 
+extern int LBM_ParseChunks(const unsigned char *data, unsigned int length, LBM_ChunkTableStruct *table);
+extern const LBM_ChunkStruct *LBM_FindChunk(const LBM_ChunkTableStruct *table, const char *id);
 extern unsigned int LBM_DisplayLBM(char *fileName, OPM_Struct *pixel_map, LBM_LogPalette *pal, int flags);
+extern unsigned int LBM_LoadBackground(char *fileName, OPM_Struct *pixel_map, LBM_LogPalette *pal);
+extern unsigned int LBM_SaveOPM(char *fileName, OPM_Struct *pixel_map, LBM_LogPalette *pal, int flags);
 
 #endif /* LBM_H */
\ No newline at end of file
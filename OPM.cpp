@@ -25,6 +25,7 @@
 #include "BASEMEM.h"
 #include "ERROR.h"
 #include "OPM.h"
+#include <string.h>
 
 typedef struct {
     const char *text;
@@ -833,14 +834,56 @@ unsigned int ASM_StringFontWidth;
 unsigned int ASM_StringFontHeight;
 unsigned int ASM_StringFontSize;
 char* ASM_pFontBitmap;
+int ASM_ClipLeft;
+int ASM_ClipTop;
+int ASM_ClipRight;
+int ASM_ClipBottom;
+
+static OPM_FontStruct *ASM_CurrentFont;
+
+/* For every byte of a glyph bitmap, the byte masks of its pixels 0..3 and 4..7 in memory order. */
+static unsigned int ASM_GlyphMasks[256][2];
+static int ASM_GlyphMasksReady;
+
+/* Native value of every palette index on 16 bit (RGB 5:6:5) and 32 bit (XRGB 8:8:8:8) pixel maps. */
+static unsigned short OPM_PaletteLUT16[256];
+static unsigned int OPM_PaletteLUT32[256];
+
+/* The palette as set with OPM_SetPaletteEntry, and for every shade level the palette index nearest to each color at
+   that level. A level is built when it is first used after the palette changed. */
+static unsigned char OPM_Palette[256][3];
+static unsigned char OPM_ShadeTable[OPM_SHADE_LEVELS][256];
+static unsigned char OPM_ShadeTableIsValid[OPM_SHADE_LEVELS];
+
+static int ASM_PixelMapBytesPerPixel = 1;
+
+/* Two dirty rectangles are merged when their bounding box covers at most this many clean pixels more than they do. */
+#define OPM_DIRTY_RECT_SLACK 256
 
 static void OPM_LocalPrintError(char *buffer, const char *data);
+static int OPM_GetRectArea(int x0, int y0, int x1, int y1);
+static void OPM_RemoveDirtyRect(OPM_Struct *pixel_map, int index);
+static int OPM_EncodeGFXRow(const unsigned char *src, int width, int transparent_color, unsigned char *dst);
+static void OPM_FillPixels(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigned char color);
+static void OPM_PutPixels(OPM_Struct *pixel_map, int x, int y, int width, const unsigned char *src, int transparent_color);
+static int OPM_CopyTrueColor(OPM_Struct *src_pixel_map, OPM_Struct *dst_pixel_map, unsigned char *src, unsigned char *dst, int width, int height);
+static int OPM_GetShadedComponent(int component, int level);
+static void OPM_BuildShadeTable(int level);
+template <class PIXEL> static void OPM_FillRectT(unsigned char *dst, PIXEL value, int stride, int width, int height);
+template <class PIXEL> static void OPM_CopyRectT(unsigned char *dst, const unsigned char *src, PIXEL transparent_value, int dst_stride, int src_stride, int width, int height);
+template <class PIXEL> static void OPM_ExpandRectT(unsigned char *dst, const unsigned char *src, const PIXEL *lut, int transparent_color, int dst_stride, int src_stride, int width, int height);
+template <class PIXEL> static void OPM_ShadeRectT(unsigned char *dst, unsigned int red_blue_mask, unsigned int green_mask, int level, int stride, int width, int height);
+template <class PIXEL> static void ASM_DrawGlyphT(PIXEL value, int x, int y, int width, int height, const unsigned char *bitmap);
 
 static void ASM_DrawFilledRectangle(unsigned char *dst, unsigned char color, unsigned int stridediff, int width, int height);
+static void ASM_RemapRectangle(unsigned char *dst, const unsigned char *table, unsigned int stridediff, int width, int height);
 static void ASM_DrawVerticalLine(unsigned char *dst, unsigned char color, int linelength, unsigned int stride);
 static void ASM_DrawHorizontalLine(unsigned char *dst, unsigned char color, int linelength, unsigned int stride);
 static void ASM_CopyRectangle(unsigned char *dst, unsigned char *src, unsigned int srcstridediff, unsigned int dststridediff, int width, int height);
 static void ASM_CopyRectangleWithTransparency(unsigned char *dst, unsigned char *src, unsigned char transparent_color, unsigned int srcstridediff, unsigned int dststridediff, int width, int height);
+static void ASM_CopyRowWithTransparency(unsigned char *dst, const unsigned char *src, unsigned char transparent_color, int width);
+static void ASM_InitGlyphMasks(void);
+static void ASM_DrawGlyph(unsigned char color, int x, int y, int width, int height, const unsigned char *bitmap);
 
 int OPM_New(unsigned int width, unsigned int height, unsigned int bytes_per_pixel, OPM_Struct *pixel_map, unsigned char *buffer)
 {
@@ -886,7 +929,9 @@ int OPM_New(unsigned int width, unsigned int height, unsigned int bytes_per_pixe
     pixel_map->origin_y = 0;
     pixel_map->bytes_per_pixel2 = bytes_per_pixel;
     pixel_map->stride = width * bytes_per_pixel;
-    pixel_map->flags |= BBOPM_UNKNOWN4 | BBOPM_MODIFIED;
+    pixel_map->flags |= BBOPM_UNKNOWN4;
+    OPM_ClearDirtyRects(pixel_map);
+    OPM_AddDirtyRect(pixel_map, 0, 0, width, height);
     return 1;
 }
 
@@ -941,12 +986,13 @@ void OPM_SetVirtualClipStart(OPM_Struct *view_pixel_map, int clip_x, int clip_y)
     view_pixel_map->clip_width = clip_width;
     view_pixel_map->clip_height = clip_height;
 
-    view_pixel_map->buffer = base_pixel_map->buffer + view_pixel_map->stride * clip_y + clip_x;
+    view_pixel_map->buffer = base_pixel_map->buffer + view_pixel_map->stride * clip_y + clip_x * view_pixel_map->bytes_per_pixel;
 }
 
 void OPM_CreateVirtualOPM(OPM_Struct *base_pixel_map, OPM_Struct *view_pixel_map, int view_x, int view_y, int view_width, int view_height)
 {
     view_pixel_map->flags = BBOPM_VIEW | BBOPM_UNKNOWN4 | BBOPM_MODIFIED;
+    view_pixel_map->number_of_dirty_rects = 0;
     view_pixel_map->view_x = view_x;
     view_pixel_map->view_y = view_y;
     view_pixel_map->width = view_width;
@@ -1004,7 +1050,114 @@ void OPM_CreateVirtualOPM(OPM_Struct *base_pixel_map, OPM_Struct *view_pixel_map
     view_pixel_map->clip_height = view_height;
     view_pixel_map->bytes_per_pixel2 = base_pixel_map->bytes_per_pixel;
     view_pixel_map->stride = base_pixel_map->stride;
-    view_pixel_map->buffer = base_pixel_map->buffer + view_pixel_map->stride * view_y + view_x;
+    view_pixel_map->buffer = base_pixel_map->buffer + view_pixel_map->stride * view_y + view_x * view_pixel_map->bytes_per_pixel;
+}
+
+/* Record that the pixels from (x, y) to (x + width, y + height) of the buffer have been drawn; the origin is not
+   applied. Views pass the rectangle on to the pixel map they look into. A rectangle that fits into the bounding box
+   of an existing one with little waste is merged into it, and when the list is full the new rectangle is merged into
+   the one that grows the least, so the list always covers every modified pixel. */
+void OPM_AddDirtyRect(OPM_Struct *pixel_map, int x, int y, int width, int height)
+{
+    OPM_RectStruct *rect;
+    int x0, y0, x1, y1;
+    int ux0, uy0, ux1, uy1;
+    int area, growth, best_growth, best_index;
+    int offset;
+    int i;
+
+    if (pixel_map->flags & BBOPM_VIEW)
+    {
+        x0 = pixel_map->clip_x;
+        y0 = pixel_map->clip_y;
+        x1 = x0 + pixel_map->clip_width;
+        y1 = y0 + pixel_map->clip_height;
+    }
+    else
+    {
+        x0 = 0;
+        y0 = 0;
+        x1 = pixel_map->width;
+        y1 = pixel_map->height;
+    }
+
+    if (x > x0) x0 = x;
+    if (y > y0) y0 = y;
+    if (x + width < x1) x1 = x + width;
+    if (y + height < y1) y1 = y + height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    pixel_map->flags |= BBOPM_MODIFIED;
+
+    if (pixel_map->flags & BBOPM_VIEW)
+    {
+        offset = pixel_map->buffer - pixel_map->base_pixel_map->buffer;
+        OPM_AddDirtyRect(pixel_map->base_pixel_map, x0 + offset % pixel_map->stride / pixel_map->bytes_per_pixel, y0 + offset / pixel_map->stride, x1 - x0, y1 - y0);
+        return;
+    }
+
+    area = OPM_GetRectArea(x0, y0, x1, y1);
+    i = 0;
+    while (i < pixel_map->number_of_dirty_rects)
+    {
+        rect = &pixel_map->dirty_rects[i];
+        ux0 = rect->x0 < x0 ? rect->x0 : x0;
+        uy0 = rect->y0 < y0 ? rect->y0 : y0;
+        ux1 = rect->x1 > x1 ? rect->x1 : x1;
+        uy1 = rect->y1 > y1 ? rect->y1 : y1;
+
+        if (OPM_GetRectArea(ux0, uy0, ux1, uy1) <= area + OPM_GetRectArea(rect->x0, rect->y0, rect->x1, rect->y1) + OPM_DIRTY_RECT_SLACK)
+        {
+            /* the grown rectangle may now reach others, so start over */
+            x0 = ux0;
+            y0 = uy0;
+            x1 = ux1;
+            y1 = uy1;
+            area = OPM_GetRectArea(x0, y0, x1, y1);
+            OPM_RemoveDirtyRect(pixel_map, i);
+            i = 0;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if (pixel_map->number_of_dirty_rects == OPM_MAX_DIRTY_RECTS)
+    {
+        best_index = 0;
+        best_growth = 0x7FFFFFFF;
+        for (i = 0; i < pixel_map->number_of_dirty_rects; i++)
+        {
+            rect = &pixel_map->dirty_rects[i];
+            growth = OPM_GetRectArea(rect->x0 < x0 ? rect->x0 : x0, rect->y0 < y0 ? rect->y0 : y0,
+                                     rect->x1 > x1 ? rect->x1 : x1, rect->y1 > y1 ? rect->y1 : y1)
+                   - OPM_GetRectArea(rect->x0, rect->y0, rect->x1, rect->y1);
+            if (growth < best_growth)
+            {
+                best_growth = growth;
+                best_index = i;
+            }
+        }
+
+        rect = &pixel_map->dirty_rects[best_index];
+        if (rect->x0 < x0) x0 = rect->x0;
+        if (rect->y0 < y0) y0 = rect->y0;
+        if (rect->x1 > x1) x1 = rect->x1;
+        if (rect->y1 > y1) y1 = rect->y1;
+        OPM_RemoveDirtyRect(pixel_map, best_index);
+    }
+
+    rect = &pixel_map->dirty_rects[pixel_map->number_of_dirty_rects++];
+    rect->x0 = x0;
+    rect->y0 = y0;
+    rect->x1 = x1;
+    rect->y1 = y1;
+}
+
+void OPM_ClearDirtyRects(OPM_Struct *pixel_map)
+{
+    pixel_map->number_of_dirty_rects = 0;
 }
 
 void OPM_SetPixel(OPM_Struct *pixel_map, int x, int y, unsigned char color)
@@ -1018,8 +1171,15 @@ void OPM_SetPixel(OPM_Struct *pixel_map, int x, int y, unsigned char color)
         (y < pixel_map->clip_y + pixel_map->clip_height)
        )
     {
-        pixel_map->flags |= BBOPM_MODIFIED;
-        pixel_map->buffer[y * pixel_map->stride + x] = color;
+        OPM_AddDirtyRect(pixel_map, x, y, 1, 1);
+        if (pixel_map->bytes_per_pixel == 1)
+        {
+            pixel_map->buffer[y * pixel_map->stride + x] = color;
+        }
+        else
+        {
+            OPM_FillPixels(pixel_map, x, y, 1, 1, color);
+        }
     }
 }
 
@@ -1034,7 +1194,8 @@ unsigned char OPM_GetPixel(OPM_Struct *pixel_map, int x, int y)
         (y < pixel_map->clip_y + pixel_map->clip_height)
        )
     {
-        return pixel_map->buffer[y * pixel_map->stride + x];
+        /* true color pixels cannot be turned back into a palette index */
+        return pixel_map->bytes_per_pixel == 1 ? pixel_map->buffer[y * pixel_map->stride + x] : 0;
     }
     else
     {
@@ -1063,8 +1224,15 @@ void OPM_HorLine(OPM_Struct *pixel_map, int x, int y, int length, unsigned char
         if (length <= 0) return;
     }
 
-    ASM_DrawHorizontalLine(pixel_map->buffer + y * pixel_map->stride + x, color, length, pixel_map->stride);
-    pixel_map->flags |= BBOPM_MODIFIED;
+    if (pixel_map->bytes_per_pixel == 1)
+    {
+        ASM_DrawHorizontalLine(pixel_map->buffer + y * pixel_map->stride + x, color, length, pixel_map->stride);
+    }
+    else
+    {
+        OPM_FillPixels(pixel_map, x, y, length, 1, color);
+    }
+    OPM_AddDirtyRect(pixel_map, x, y, length, 1);
 }
 
 void OPM_VerLine(OPM_Struct *pixel_map, int x, int y, int length, unsigned char color)
@@ -1088,8 +1256,15 @@ void OPM_VerLine(OPM_Struct *pixel_map, int x, int y, int length, unsigned char
         if (length <= 0) return;
     }
 
-    ASM_DrawVerticalLine(pixel_map->buffer + y * pixel_map->stride + x, color, length, pixel_map->stride);
-    pixel_map->flags |= BBOPM_MODIFIED;
+    if (pixel_map->bytes_per_pixel == 1)
+    {
+        ASM_DrawVerticalLine(pixel_map->buffer + y * pixel_map->stride + x, color, length, pixel_map->stride);
+    }
+    else
+    {
+        OPM_FillPixels(pixel_map, x, y, 1, length, color);
+    }
+    OPM_AddDirtyRect(pixel_map, x, y, 1, length);
 }
 
 void OPM_Box(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigned char color)
@@ -1133,21 +1308,52 @@ void OPM_Box(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigne
 
     if (draw_left_line)
     {
-        ASM_DrawVerticalLine(pixel_map->buffer + y * pixel_map->stride + x, color, height, pixel_map->stride);
+        if (pixel_map->bytes_per_pixel == 1)
+        {
+            ASM_DrawVerticalLine(pixel_map->buffer + y * pixel_map->stride + x, color, height, pixel_map->stride);
+        }
+        else
+        {
+            OPM_FillPixels(pixel_map, x, y, 1, height, color);
+        }
+        OPM_AddDirtyRect(pixel_map, x, y, 1, height);
     }
     if (draw_right_line)
     {
-        ASM_DrawVerticalLine(pixel_map->buffer + y * pixel_map->stride + x + width - 1, color, height, pixel_map->stride);
+        if (pixel_map->bytes_per_pixel == 1)
+        {
+            ASM_DrawVerticalLine(pixel_map->buffer + y * pixel_map->stride + x + width - 1, color, height, pixel_map->stride);
+        }
+        else
+        {
+            OPM_FillPixels(pixel_map, x + width - 1, y, 1, height, color);
+        }
+        OPM_AddDirtyRect(pixel_map, x + width - 1, y, 1, height);
     }
     if (draw_top_line)
     {
-        ASM_DrawHorizontalLine(pixel_map->buffer + y * pixel_map->stride + x, color, width, pixel_map->stride);
+        if (pixel_map->bytes_per_pixel == 1)
+        {
+            ASM_DrawHorizontalLine(pixel_map->buffer + y * pixel_map->stride + x, color, width, pixel_map->stride);
+        }
+        else
+        {
+            OPM_FillPixels(pixel_map, x, y, width, 1, color);
+        }
+        OPM_AddDirtyRect(pixel_map, x, y, width, 1);
     }
     if (draw_bottom_line)
     {
-        ASM_DrawHorizontalLine(pixel_map->buffer + (y + height - 1) * pixel_map->stride + x, color, width, pixel_map->stride);
+        if (pixel_map->bytes_per_pixel == 1)
+        {
+            ASM_DrawHorizontalLine(pixel_map->buffer + (y + height - 1) * pixel_map->stride + x, color, width, pixel_map->stride);
+        }
+        else
+        {
+            OPM_FillPixels(pixel_map, x, y + height - 1, width, 1, color);
+        }
+        OPM_AddDirtyRect(pixel_map, x, y + height - 1, width, 1);
     }
-    pixel_map->flags |= BBOPM_MODIFIED;
 }
 
 void OPM_FillBox(OPM_Struct *pixel_map, int x, int y, int width, int height, uint8_t color)
@@ -1181,13 +1387,275 @@ void OPM_FillBox(OPM_Struct *pixel_map, int x, int y, int width, int height, uin
         if (height <= 0) return;
     }
 
-    ASM_DrawFilledRectangle(pixel_map->buffer + y * pixel_map->stride + x, color, pixel_map->stride - width, width, height);
-    pixel_map->flags |= BBOPM_MODIFIED;
+    if (pixel_map->bytes_per_pixel == 1)
+    {
+        ASM_DrawFilledRectangle(pixel_map->buffer + y * pixel_map->stride + x, color, pixel_map->stride - width, width, height);
+    }
+    else
+    {
+        OPM_FillPixels(pixel_map, x, y, width, height, color);
+    }
+    OPM_AddDirtyRect(pixel_map, x, y, width, height);
+}
+
+/* Darken or lighten a rectangle by shade 'level' (see OPM_SHADE_LEVELS). On 8 bit pixel maps every pixel is looked up
+   in the shade table of the palette, on 16 and 32 bit pixel maps the color components are scaled directly. */
+void OPM_RemapBox(OPM_Struct *pixel_map, int x, int y, int width, int height, int level)
+{
+    if (level < 0 || level >= OPM_SHADE_LEVELS || level == OPM_SHADE_NORMAL || width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    x += pixel_map->origin_x;
+    y += pixel_map->origin_y;
+
+    if (x < pixel_map->clip_x)
+    {
+        width -= pixel_map->clip_x - x;
+        x = pixel_map->clip_x;
+        if (width <= 0) return;
+    }
+
+    if (x + width > pixel_map->clip_x + pixel_map->clip_width)
+    {
+        width -= (x + width) - (pixel_map->clip_x + pixel_map->clip_width);
+        if (width <= 0) return;
+    }
+
+    if (y < pixel_map->clip_y)
+    {
+        height -= pixel_map->clip_y - y;
+        y = pixel_map->clip_y;
+        if (height <= 0) return;
+    }
+
+    if (y + height > pixel_map->clip_y + pixel_map->clip_height)
+    {
+        height -= (y + height) - (pixel_map->clip_y + pixel_map->clip_height);
+        if (height <= 0) return;
+    }
+
+    switch (pixel_map->bytes_per_pixel)
+    {
+        case 1:
+        {
+            if (!OPM_ShadeTableIsValid[level])
+            {
+                OPM_BuildShadeTable(level);
+            }
+            ASM_RemapRectangle(pixel_map->buffer + y * pixel_map->stride + x, OPM_ShadeTable[level], pixel_map->stride - width, width, height);
+            break;
+        }
+        case 2:
+        {
+            OPM_ShadeRectT<unsigned short>(pixel_map->buffer + y * pixel_map->stride + x * 2, 0xF81F, 0x07E0, level, pixel_map->stride, width, height);
+            break;
+        }
+        case 4:
+        {
+            OPM_ShadeRectT<unsigned int>(pixel_map->buffer + y * pixel_map->stride + x * 4, 0xFF00FF, 0x00FF00, level, pixel_map->stride, width, height);
+            break;
+        }
+        default:
+        {
+            return;
+        }
+    }
+    OPM_AddDirtyRect(pixel_map, x, y, width, height);
+}
+
+/* Fill the horizontal runs of 'spans'; x0 and x1 are both inclusive. The clip rectangle is moved into the coordinates
+   of the spans once for the whole batch, so each span only needs to be cut to it before it is filled. */
+void OPM_FillSpans(OPM_Struct *pixel_map, const OPM_SpanStruct *spans, int number_of_spans)
+{
+    int clip_x0, clip_y0, clip_x1, clip_y1;
+    int x0, x1;
+
+    clip_x0 = pixel_map->clip_x - pixel_map->origin_x;
+    clip_y0 = pixel_map->clip_y - pixel_map->origin_y;
+    clip_x1 = clip_x0 + pixel_map->clip_width - 1;
+    clip_y1 = clip_y0 + pixel_map->clip_height - 1;
+
+    for (; number_of_spans > 0; number_of_spans--, spans++)
+    {
+        if (spans->y < clip_y0 || spans->y > clip_y1) continue;
+
+        x0 = spans->x0 > clip_x0 ? spans->x0 : clip_x0;
+        x1 = spans->x1 < clip_x1 ? spans->x1 : clip_x1;
+        if (x0 > x1) continue;
+
+        if (pixel_map->bytes_per_pixel == 1)
+        {
+            memset(pixel_map->buffer + (spans->y + pixel_map->origin_y) * pixel_map->stride + x0 + pixel_map->origin_x, spans->color, x1 - x0 + 1);
+        }
+        else
+        {
+            OPM_FillPixels(pixel_map, x0 + pixel_map->origin_x, spans->y + pixel_map->origin_y, x1 - x0 + 1, 1, spans->color);
+        }
+        OPM_AddDirtyRect(pixel_map, x0 + pixel_map->origin_x, spans->y + pixel_map->origin_y, x1 - x0 + 1, 1);
+    }
+}
+
+/* Like OPM_FillSpans, but each span is copied from 'pixels', which holds the x1 - x0 + 1 pixels of every span one
+   after the other. The color of the spans is not used. */
+void OPM_PutSpans(OPM_Struct *pixel_map, const OPM_SpanStruct *spans, const unsigned char *pixels, int number_of_spans)
+{
+    const unsigned char *src;
+    int clip_x0, clip_y0, clip_x1, clip_y1;
+    int x0, x1;
+
+    clip_x0 = pixel_map->clip_x - pixel_map->origin_x;
+    clip_y0 = pixel_map->clip_y - pixel_map->origin_y;
+    clip_x1 = clip_x0 + pixel_map->clip_width - 1;
+    clip_y1 = clip_y0 + pixel_map->clip_height - 1;
+
+    for (; number_of_spans > 0; number_of_spans--, spans++)
+    {
+        if (spans->x1 < spans->x0) continue;
+
+        src = pixels;
+        pixels += spans->x1 - spans->x0 + 1;
+
+        if (spans->y < clip_y0 || spans->y > clip_y1) continue;
+
+        x0 = spans->x0 > clip_x0 ? spans->x0 : clip_x0;
+        x1 = spans->x1 < clip_x1 ? spans->x1 : clip_x1;
+        if (x0 > x1) continue;
+
+        if (pixel_map->bytes_per_pixel == 1)
+        {
+            memcpy(pixel_map->buffer + (spans->y + pixel_map->origin_y) * pixel_map->stride + x0 + pixel_map->origin_x, src + (x0 - spans->x0), x1 - x0 + 1);
+        }
+        else
+        {
+            OPM_PutPixels(pixel_map, x0 + pixel_map->origin_x, spans->y + pixel_map->origin_y, x1 - x0 + 1, src + (x0 - spans->x0), -1);
+        }
+        OPM_AddDirtyRect(pixel_map, x0 + pixel_map->origin_x, spans->y + pixel_map->origin_y, x1 - x0 + 1, 1);
+    }
+}
+
+/* Compile 'pixel_map' into runs of opaque pixels. Without BBOPM_TRANSPARENCY every pixel is opaque. */
+int OPM_CreateGFX(OPM_Struct *pixel_map, OPM_GfxStruct *gfx)
+{
+    unsigned char *src;
+    unsigned int data_size;
+    int transparent_color;
+    int y;
+    OPM_ErrorStruct data;
+
+    if (pixel_map->bytes_per_pixel != 1)
+    {
+        data.text = "OPM_CreateGFX: Only 8 bit PixelMaps can be compiled - bytes per pixel";
+        data.data1 = pixel_map->bytes_per_pixel;
+        data.data2 = 0;
+        ERROR_PushError(OPM_LocalPrintError, "BBOPM Library", sizeof(data), (const char *) &data);
+
+        return 0;
+    }
+
+    transparent_color = (pixel_map->flags & BBOPM_TRANSPARENCY) ? (pixel_map->transparent_color & 0xFF) : -1;
+
+    data_size = 0;
+    src = pixel_map->buffer;
+    for (y = 0; y < pixel_map->height; y++)
+    {
+        data_size += OPM_EncodeGFXRow(src, pixel_map->width, transparent_color, 0);
+        src += pixel_map->stride;
+    }
+
+    gfx->row_offsets = (unsigned int *)BASEMEM_Alloc(pixel_map->height * sizeof(unsigned int) + data_size, BASEMEM_XMS_MEMORY);
+    if (gfx->row_offsets == NULL)
+    {
+        data.text = "OPM_CreateGFX: Cannot Allocate Mem for GFX width,height";
+        data.data1 = pixel_map->width;
+        data.data2 = pixel_map->height;
+        ERROR_PushError(OPM_LocalPrintError, "BBOPM Library", sizeof(data), (const char *) &data);
+
+        return 0;
+    }
+
+    gfx->width = pixel_map->width;
+    gfx->height = pixel_map->height;
+    gfx->data = (unsigned char *)&gfx->row_offsets[pixel_map->height];
+
+    data_size = 0;
+    src = pixel_map->buffer;
+    for (y = 0; y < pixel_map->height; y++)
+    {
+        gfx->row_offsets[y] = data_size;
+        data_size += OPM_EncodeGFXRow(src, pixel_map->width, transparent_color, &gfx->data[data_size]);
+        src += pixel_map->stride;
+    }
+
+    return 1;
+}
+
+void OPM_DelGFX(OPM_GfxStruct *gfx)
+{
+    if (gfx->row_offsets != NULL)
+    {
+        BASEMEM_Free(gfx->row_offsets);
+    }
+
+    gfx->row_offsets = 0;
+    gfx->data = 0;
+    gfx->width = 0;
+    gfx->height = 0;
 }
 
-void  OPM_CopyGFXOPM(OPM_Struct *a1, OPM_Struct *a2, int a3, int a4, int a5)
+/* Draw 'gfx' with its upper left corner at (dst_x, dst_y). Transparent pixels are never looked at: the skips are
+   stepped over and the opaque runs are cut to the clip rectangle and copied as a whole. */
+void OPM_CopyGFXOPM(OPM_GfxStruct *gfx, OPM_Struct *dst_pixel_map, int dst_x, int dst_y)
 {
-    /* TODO: Implement function */
+    const unsigned char *run;
+    unsigned char *dst;
+    int clip_x0, clip_y0, clip_x1, clip_y1;
+    int x, y, count, start, end;
+
+    dst_x += dst_pixel_map->origin_x;
+    dst_y += dst_pixel_map->origin_y;
+
+    clip_x0 = dst_x > dst_pixel_map->clip_x ? dst_x : dst_pixel_map->clip_x;
+    clip_y0 = dst_y > dst_pixel_map->clip_y ? dst_y : dst_pixel_map->clip_y;
+    clip_x1 = dst_pixel_map->clip_x + dst_pixel_map->clip_width;
+    clip_y1 = dst_pixel_map->clip_y + dst_pixel_map->clip_height;
+    if (dst_x + gfx->width < clip_x1) clip_x1 = dst_x + gfx->width;
+    if (dst_y + gfx->height < clip_y1) clip_y1 = dst_y + gfx->height;
+    if (clip_x0 >= clip_x1 || clip_y0 >= clip_y1) return;
+
+    for (y = clip_y0; y < clip_y1; y++)
+    {
+        run = &gfx->data[gfx->row_offsets[y - dst_y]];
+        dst = dst_pixel_map->buffer + y * dst_pixel_map->stride;
+        x = dst_x;
+
+        while (run[0] != 0 || run[1] != 0)
+        {
+            x += run[0];
+            count = run[1];
+            run += 2;
+            if (x >= clip_x1) break;
+
+            start = x > clip_x0 ? x : clip_x0;
+            end = x + count < clip_x1 ? x + count : clip_x1;
+            if (start < end)
+            {
+                if (dst_pixel_map->bytes_per_pixel == 1)
+                {
+                    memcpy(dst + start, run + (start - x), end - start);
+                }
+                else
+                {
+                    OPM_PutPixels(dst_pixel_map, start, y, end - start, run + (start - x), -1);
+                }
+            }
+            run += count;
+            x += count;
+        }
+    }
+
+    OPM_AddDirtyRect(dst_pixel_map, clip_x0, clip_y0, clip_x1 - clip_x0, clip_y1 - clip_y0);
 }
 
 void OPM_CopyOPMOPM(OPM_Struct *src_pixel_map, OPM_Struct *dst_pixel_map, int src_x, int src_y, int src_width, int src_height, int dst_x, int dst_y)
@@ -1286,10 +1754,17 @@ void OPM_CopyOPMOPM(OPM_Struct *src_pixel_map, OPM_Struct *dst_pixel_map, int sr
     src_x += add_x;
     src_y += add_y;
 
-    src = src_pixel_map->buffer + src_pixel_map->stride * src_y + src_x;
-    dst = dst_pixel_map->buffer + dst_pixel_map->stride * dst_y + dst_x;
+    src = src_pixel_map->buffer + src_pixel_map->stride * src_y + src_x * src_pixel_map->bytes_per_pixel;
+    dst = dst_pixel_map->buffer + dst_pixel_map->stride * dst_y + dst_x * dst_pixel_map->bytes_per_pixel;
 
-    if (src_pixel_map->flags & BBOPM_TRANSPARENCY)
+    if (src_pixel_map->bytes_per_pixel != 1 || dst_pixel_map->bytes_per_pixel != 1)
+    {
+        if (!OPM_CopyTrueColor(src_pixel_map, dst_pixel_map, src, dst, src_width, src_height))
+        {
+            return;
+        }
+    }
+    else if (src_pixel_map->flags & BBOPM_TRANSPARENCY)
     {
         ASM_CopyRectangleWithTransparency(dst, src, src_pixel_map->transparent_color, src_pixel_map->stride - src_width, dst_pixel_map->stride - src_width, src_width, src_height);
     }
@@ -1297,13 +1772,135 @@ void OPM_CopyOPMOPM(OPM_Struct *src_pixel_map, OPM_Struct *dst_pixel_map, int sr
     {
         ASM_CopyRectangle(dst, src, src_pixel_map->stride - src_width, dst_pixel_map->stride - src_width, src_width, src_height);
     }
-    dst_pixel_map->flags |= BBOPM_MODIFIED;
+    OPM_AddDirtyRect(dst_pixel_map, dst_x, dst_y, src_width, src_height);
 }
 
 void OPM_DrawString(OPM_Struct *pixel_map, char *string, int x, int y, unsigned char color)
 {
-    ASM_SetFontOptions(0, 0, pixel_map->width, pixel_map->height, (char*)pixel_map->buffer, pixel_map->stride);
-    ASM_DrawString(x, y, color, 8, (char*)&string[0]);
+    ASM_SetFontOptions(pixel_map->clip_x, pixel_map->clip_y, pixel_map->clip_width, pixel_map->clip_height, (char*)pixel_map->buffer, pixel_map->stride);
+    ASM_PixelMapBytesPerPixel = pixel_map->bytes_per_pixel;
+    ASM_DrawString(x + pixel_map->origin_x, y + pixel_map->origin_y, color, 8, (char*)&string[0]);
+    OPM_AddDirtyRect(pixel_map, x + pixel_map->origin_x, y + pixel_map->origin_y, strlen(string) * ASM_StringFontWidth, ASM_StringFontHeight);
+}
+
+/* Set the color that palette index 'index' is drawn with on 16 and 32 bit pixel maps. Pixels that are already drawn
+   keep their color. */
+void OPM_SetPaletteEntry(int index, unsigned char red, unsigned char green, unsigned char blue)
+{
+    index &= 0xFF;
+    OPM_PaletteLUT16[index] = ((red & 0xF8) << 8) | ((green & 0xFC) << 3) | (blue >> 3);
+    OPM_PaletteLUT32[index] = ((unsigned int)red << 16) | ((unsigned int)green << 8) | blue;
+
+    if (OPM_Palette[index][0] != red || OPM_Palette[index][1] != green || OPM_Palette[index][2] != blue)
+    {
+        OPM_Palette[index][0] = red;
+        OPM_Palette[index][1] = green;
+        OPM_Palette[index][2] = blue;
+        memset(OPM_ShadeTableIsValid, 0, sizeof(OPM_ShadeTableIsValid));
+    }
+}
+
+/* A color component of 0..255 at shade 'level'. */
+static int OPM_GetShadedComponent(int component, int level)
+{
+    if (level <= OPM_SHADE_NORMAL)
+    {
+        return component * level / OPM_SHADE_NORMAL;
+    }
+    return component + (255 - component) * (level - OPM_SHADE_NORMAL) / OPM_SHADE_NORMAL;
+}
+
+/* For every palette index, find the index whose color is nearest to its color at shade 'level'. The palette is sorted
+   by green, the heaviest weighted component, and searched from the wanted green outwards; a direction is given up as
+   soon as the difference in green alone is as large as the best distance found so far. */
+static void OPM_BuildShadeTable(int level)
+{
+    unsigned char order[256];
+    unsigned short first[257];
+    int red;
+    int green;
+    int blue;
+    int best_distance;
+    int distance;
+    int up;
+    int down;
+    int i;
+
+    /* Counting sort by green; first[g] is the position of the first color with a green of at least g */
+    memset(first, 0, sizeof(first));
+    for (i = 0; i < 256; i++)
+    {
+        first[OPM_Palette[i][1] + 1]++;
+    }
+    for (i = 1; i <= 256; i++)
+    {
+        first[i] += first[i - 1];
+    }
+    for (i = 0; i < 256; i++)
+    {
+        order[first[OPM_Palette[i][1]]++] = i;
+    }
+    for (i = 256; i > 0; i--)
+    {
+        first[i] = first[i - 1];
+    }
+    first[0] = 0;
+
+    for (i = 0; i < 256; i++)
+    {
+        if (level == OPM_SHADE_NORMAL)
+        {
+            OPM_ShadeTable[level][i] = i;
+            continue;
+        }
+
+        red = OPM_GetShadedComponent(OPM_Palette[i][0], level);
+        green = OPM_GetShadedComponent(OPM_Palette[i][1], level);
+        blue = OPM_GetShadedComponent(OPM_Palette[i][2], level);
+        best_distance = 0x7FFFFFFF;
+        up = first[green];
+        down = up - 1;
+        while (up < 256 || down >= 0)
+        {
+            if (up < 256)
+            {
+                distance = 4 * (OPM_Palette[order[up]][1] - green) * (OPM_Palette[order[up]][1] - green);
+                if (distance >= best_distance)
+                {
+                    up = 256;
+                }
+                else
+                {
+                    distance += 3 * (OPM_Palette[order[up]][0] - red) * (OPM_Palette[order[up]][0] - red) + 2 * (OPM_Palette[order[up]][2] - blue) * (OPM_Palette[order[up]][2] - blue);
+                    if (distance < best_distance)
+                    {
+                        best_distance = distance;
+                        OPM_ShadeTable[level][i] = order[up];
+                    }
+                    up++;
+                }
+            }
+            if (down >= 0)
+            {
+                distance = 4 * (OPM_Palette[order[down]][1] - green) * (OPM_Palette[order[down]][1] - green);
+                if (distance >= best_distance)
+                {
+                    down = -1;
+                }
+                else
+                {
+                    distance += 3 * (OPM_Palette[order[down]][0] - red) * (OPM_Palette[order[down]][0] - red) + 2 * (OPM_Palette[order[down]][2] - blue) * (OPM_Palette[order[down]][2] - blue);
+                    if (distance < best_distance)
+                    {
+                        best_distance = distance;
+                        OPM_ShadeTable[level][i] = order[down];
+                    }
+                    down--;
+                }
+            }
+        }
+    }
+    OPM_ShadeTableIsValid[level] = 1;
 }
 
 void OPM_drawStringWithFormat(OPM_Struct *pixel_map, __int16 x, __int16 y, unsigned __int8 letter, const char *format, ...)
@@ -1328,10 +1925,331 @@ static void OPM_LocalPrintError(char *buffer, const char *data)
 #undef DATA
 }
 
+static int OPM_GetRectArea(int x0, int y0, int x1, int y1)
+{
+    return (x1 - x0) * (y1 - y0);
+}
+
+static void OPM_RemoveDirtyRect(OPM_Struct *pixel_map, int index)
+{
+    pixel_map->number_of_dirty_rects--;
+    pixel_map->dirty_rects[index] = pixel_map->dirty_rects[pixel_map->number_of_dirty_rects];
+}
+
+/* Encode one row of 'width' pixels into 'dst' and return its length in bytes; with 'dst' 0 the length is only
+   measured. Skips and runs longer than 255 pixels are split, so (0, 0) never shows up before the end of a row. */
+static int OPM_EncodeGFXRow(const unsigned char *src, int width, int transparent_color, unsigned char *dst)
+{
+    int length;
+    int x, skip, count, run;
+
+    length = 0;
+    x = 0;
+    while (1)
+    {
+        skip = 0;
+        while (x < width && src[x] == transparent_color)
+        {
+            skip++;
+            x++;
+        }
+        if (x == width) break;
+
+        count = 0;
+        while (x + count < width && src[x + count] != transparent_color)
+        {
+            count++;
+        }
+
+        for (; skip > 255; skip -= 255)
+        {
+            if (dst)
+            {
+                dst[length] = 255;
+                dst[length + 1] = 0;
+            }
+            length += 2;
+        }
+
+        while (count > 0)
+        {
+            run = count > 255 ? 255 : count;
+            if (dst)
+            {
+                dst[length] = skip;
+                dst[length + 1] = run;
+                memcpy(&dst[length + 2], &src[x], run);
+            }
+            length += 2 + run;
+            x += run;
+            count -= run;
+            skip = 0;
+        }
+    }
+
+    if (dst)
+    {
+        dst[length] = 0;
+        dst[length + 1] = 0;
+    }
+
+    return length + 2;
+}
+
+/* Fill a rectangle of a 16 or 32 bit pixel map with the native value of 'color'. */
+static void OPM_FillPixels(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigned char color)
+{
+    unsigned char *dst;
+
+    dst = pixel_map->buffer + y * pixel_map->stride + x * pixel_map->bytes_per_pixel;
+    switch (pixel_map->bytes_per_pixel)
+    {
+        case 2:
+        {
+            OPM_FillRectT(dst, OPM_PaletteLUT16[color], pixel_map->stride, width, height);
+            break;
+        }
+        case 4:
+        {
+            OPM_FillRectT(dst, OPM_PaletteLUT32[color], pixel_map->stride, width, height);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+/* Expand 'width' palette indices from 'src' into one row of a 16 or 32 bit pixel map; indices equal to
+   'transparent_color' are skipped, -1 draws all of them. */
+static void OPM_PutPixels(OPM_Struct *pixel_map, int x, int y, int width, const unsigned char *src, int transparent_color)
+{
+    unsigned char *dst;
+
+    dst = pixel_map->buffer + y * pixel_map->stride + x * pixel_map->bytes_per_pixel;
+    switch (pixel_map->bytes_per_pixel)
+    {
+        case 2:
+        {
+            OPM_ExpandRectT(dst, src, OPM_PaletteLUT16, transparent_color, 0, 0, width, 1);
+            break;
+        }
+        case 4:
+        {
+            OPM_ExpandRectT(dst, src, OPM_PaletteLUT32, transparent_color, 0, 0, width, 1);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+/* The part of OPM_CopyOPMOPM for pixel maps that are not both 8 bit. Pixel maps of the same depth are copied as they
+   are; 8 bit pixel maps are expanded into 16 and 32 bit ones through the palette. Transparency always means the
+   transparent palette index, so on true color pixel maps its native value is compared. Other pairs are not copied
+   and return 0. */
+static int OPM_CopyTrueColor(OPM_Struct *src_pixel_map, OPM_Struct *dst_pixel_map, unsigned char *src, unsigned char *dst, int width, int height)
+{
+    int transparent_color;
+    OPM_ErrorStruct data;
+
+    transparent_color = (src_pixel_map->flags & BBOPM_TRANSPARENCY) ? (src_pixel_map->transparent_color & 0xFF) : -1;
+
+    if (src_pixel_map->bytes_per_pixel == 1)
+    {
+        switch (dst_pixel_map->bytes_per_pixel)
+        {
+            case 2:
+            {
+                OPM_ExpandRectT(dst, src, OPM_PaletteLUT16, transparent_color, dst_pixel_map->stride, src_pixel_map->stride, width, height);
+                return 1;
+            }
+            case 4:
+            {
+                OPM_ExpandRectT(dst, src, OPM_PaletteLUT32, transparent_color, dst_pixel_map->stride, src_pixel_map->stride, width, height);
+                return 1;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    if (src_pixel_map->bytes_per_pixel != dst_pixel_map->bytes_per_pixel || (src_pixel_map->bytes_per_pixel != 2 && src_pixel_map->bytes_per_pixel != 4))
+    {
+        data.text = "OPM_CopyOPMOPM: Cannot copy between these bytes per pixel - source,destination";
+        data.data1 = src_pixel_map->bytes_per_pixel;
+        data.data2 = dst_pixel_map->bytes_per_pixel;
+        ERROR_PushError(OPM_LocalPrintError, "BBOPM Library", sizeof(data), (const char *) &data);
+
+        return 0;
+    }
+
+    if (transparent_color < 0)
+    {
+        if (width * src_pixel_map->bytes_per_pixel == src_pixel_map->stride && src_pixel_map->stride == dst_pixel_map->stride)
+        {
+            memcpy(dst, src, src_pixel_map->stride * height);
+            return 1;
+        }
+        for (; height > 0; height--)
+        {
+            memcpy(dst, src, width * src_pixel_map->bytes_per_pixel);
+            src += src_pixel_map->stride;
+            dst += dst_pixel_map->stride;
+        }
+        return 1;
+    }
+
+    switch (src_pixel_map->bytes_per_pixel)
+    {
+        case 2:
+        {
+            OPM_CopyRectT(dst, src, OPM_PaletteLUT16[transparent_color], dst_pixel_map->stride, src_pixel_map->stride, width, height);
+            break;
+        }
+        default:
+        {
+            OPM_CopyRectT(dst, src, OPM_PaletteLUT32[transparent_color], dst_pixel_map->stride, src_pixel_map->stride, width, height);
+            break;
+        }
+    }
+    return 1;
+}
+
+template <class PIXEL>
+static void OPM_FillRectT(unsigned char *dst, PIXEL value, int stride, int width, int height)
+{
+    PIXEL *pixel;
+    int count;
+
+    for (; height > 0; height--, dst += stride)
+    {
+        pixel = (PIXEL *)dst;
+        for (count = width; count > 0; count--)
+        {
+            *pixel++ = value;
+        }
+    }
+}
+
+template <class PIXEL>
+static void OPM_CopyRectT(unsigned char *dst, const unsigned char *src, PIXEL transparent_value, int dst_stride, int src_stride, int width, int height)
+{
+    const PIXEL *src_pixel;
+    PIXEL *dst_pixel;
+    int count;
+
+    for (; height > 0; height--, src += src_stride, dst += dst_stride)
+    {
+        src_pixel = (const PIXEL *)src;
+        dst_pixel = (PIXEL *)dst;
+        for (count = width; count > 0; count--, src_pixel++, dst_pixel++)
+        {
+            if (*src_pixel != transparent_value)
+            {
+                *dst_pixel = *src_pixel;
+            }
+        }
+    }
+}
+
+/* Look up every index of the rectangle in 'lut'. Opaque rows are done four pixels per step, with the four indices
+   read as one 32 bit word; with a transparent index a whole group is skipped when all four of its pixels are. */
+template <class PIXEL>
+static void OPM_ExpandRectT(unsigned char *dst, const unsigned char *src, const PIXEL *lut, int transparent_color, int dst_stride, int src_stride, int width, int height)
+{
+    const unsigned char *index;
+    PIXEL *pixel;
+    unsigned int indices;
+    unsigned int pattern;
+    int count;
+
+    pattern = transparent_color < 0 ? 0 : transparent_color * 0x01010101u;
+
+    for (; height > 0; height--, src += src_stride, dst += dst_stride)
+    {
+        index = src;
+        pixel = (PIXEL *)dst;
+
+        if (transparent_color < 0)
+        {
+            for (count = width; count >= 4; count -= 4, index += 4, pixel += 4)
+            {
+                memcpy(&indices, index, 4);
+                pixel[0] = lut[indices & 0xFF];
+                pixel[1] = lut[(indices >> 8) & 0xFF];
+                pixel[2] = lut[(indices >> 16) & 0xFF];
+                pixel[3] = lut[indices >> 24];
+            }
+            for (; count > 0; count--)
+            {
+                *pixel++ = lut[*index++];
+            }
+            continue;
+        }
+
+        for (count = width; count >= 4; count -= 4, index += 4, pixel += 4)
+        {
+            memcpy(&indices, index, 4);
+            if (indices == pattern)
+            {
+                continue;
+            }
+            if (index[0] != transparent_color) pixel[0] = lut[index[0]];
+            if (index[1] != transparent_color) pixel[1] = lut[index[1]];
+            if (index[2] != transparent_color) pixel[2] = lut[index[2]];
+            if (index[3] != transparent_color) pixel[3] = lut[index[3]];
+        }
+        for (; count > 0; count--, index++, pixel++)
+        {
+            if (*index != transparent_color)
+            {
+                *pixel = lut[*index];
+            }
+        }
+    }
+}
+
+/* Scale the components of every pixel by 'level'. The red and blue components are scaled together, in one multiply,
+   since the gap between them leaves room for the carry; green is scaled on its own. */
+template <class PIXEL>
+static void OPM_ShadeRectT(unsigned char *dst, unsigned int red_blue_mask, unsigned int green_mask, int level, int stride, int width, int height)
+{
+    PIXEL *pixel;
+    unsigned int value;
+    unsigned int factor;
+    int count;
+
+    factor = level <= OPM_SHADE_NORMAL ? level : level - OPM_SHADE_NORMAL;
+    for (; height > 0; height--, dst += stride)
+    {
+        pixel = (PIXEL *)dst;
+        for (count = width; count > 0; count--, pixel++)
+        {
+            /* lightening scales the distance to white instead */
+            value = level <= OPM_SHADE_NORMAL ? *pixel : ~*pixel & (red_blue_mask | green_mask);
+            value = (((value & red_blue_mask) * factor / OPM_SHADE_NORMAL) & red_blue_mask) | (((value & green_mask) * factor / OPM_SHADE_NORMAL) & green_mask);
+            *pixel = level <= OPM_SHADE_NORMAL ? (*pixel & ~(red_blue_mask | green_mask)) | value : *pixel + value;
+        }
+    }
+}
+
 static void ASM_DrawFilledRectangle(unsigned char *dst, unsigned char color, unsigned int stridediff, int width, int height)
 {
     int count;
 
+    if (stridediff == 0)
+    {
+        /* the rows follow each other, so the whole rectangle is one block */
+        memset(dst, color, width * height);
+        return;
+    }
+
     if (width >= 8)
     {
         do
@@ -1358,6 +2276,31 @@ static void ASM_DrawFilledRectangle(unsigned char *dst, unsigned char color, uns
     }
 }
 
+/* Replace every pixel of a rectangle by its entry in 'table'. Four pixels are read and written as one 32 bit word. */
+static void ASM_RemapRectangle(unsigned char *dst, const unsigned char *table, unsigned int stridediff, int width, int height)
+{
+    unsigned int pixels;
+    int count;
+
+    do
+    {
+        for (count = width; count >= 4; count -= 4)
+        {
+            memcpy(&pixels, dst, 4);
+            pixels = table[pixels & 0xFF] | (table[(pixels >> 8) & 0xFF] << 8) | (table[(pixels >> 16) & 0xFF] << 16) | ((unsigned int)table[pixels >> 24] << 24);
+            memcpy(dst, &pixels, 4);
+            dst += 4;
+        }
+        for (; count != 0; count--)
+        {
+            *dst = table[*dst];
+            dst++;
+        }
+        dst += stridediff;
+        height--;
+    } while (height > 0);
+}
+
 static void ASM_DrawVerticalLine(unsigned char *dst, unsigned char color, int linelength, unsigned int stride)
 {
     for (; linelength != 0; linelength--)
@@ -1386,6 +2329,14 @@ static void ASM_DrawHorizontalLine(unsigned char *dst, unsigned char color, int
 static void ASM_CopyRectangle(unsigned char *dst, unsigned char *src, unsigned int srcstridediff, unsigned int dststridediff, int width, int height)
 {
     int count;
+
+    if (srcstridediff == 0 && dststridediff == 0)
+    {
+        /* full width rows in both buffers, e.g. a backup of the whole screen, are one block */
+        memcpy(dst, src, width * height);
+        return;
+    }
+
     if (width >= 8)
     {
         do
@@ -1415,133 +2366,270 @@ static void ASM_CopyRectangle(unsigned char *dst, unsigned char *src, unsigned i
     }
 }
 
-static void ASM_CopyRectangleWithTransparency(unsigned char *dst, unsigned char *src, unsigned char transparent_color, unsigned int srcstridediff, unsigned int dststridediff, int width, int height)
+/* Copy 'width' pixels, skipping those that have the transparent color. Four pixels are tested at a time: the high bit
+   of a byte of 'opaque' is set if that byte of 'value' differs from the transparent color. Words without transparent
+   pixels are stored as a whole, words with some are merged with the destination through a byte mask. */
+static void ASM_CopyRowWithTransparency(unsigned char *dst, const unsigned char *src, unsigned char transparent_color, int width)
 {
-    unsigned char value;
+    unsigned int pattern;
+    unsigned int value;
+    unsigned int diff;
+    unsigned int opaque;
+    unsigned int old_value;
     int count;
 
-    do
+    pattern = transparent_color * 0x01010101u;
+    for (count = 0; count + 4 <= width; count += 4)
     {
-        for (count = width; count != 0; count--)
+        memcpy(&value, &src[count], 4);
+        diff = value ^ pattern;
+        opaque = (((diff & 0x7F7F7F7F) + 0x7F7F7F7F) | diff) & 0x80808080;
+        if (opaque == 0x80808080)
+        {
+            memcpy(&dst[count], &value, 4);
+        }
+        else if (opaque)
         {
+            opaque = (opaque >> 7) * 0xFF;
+            memcpy(&old_value, &dst[count], 4);
+            old_value = (old_value & ~opaque) | (value & opaque);
+            memcpy(&dst[count], &old_value, 4);
+        }
+    }
 
-            value = *src;
-            if (value != transparent_color)
-            {
-                *dst = value;
-            }
-            src++;
-            dst++;
+    for (; count < width; count++)
+    {
+        if (src[count] != transparent_color)
+        {
+            dst[count] = src[count];
         }
-        src += srcstridediff;
-        dst += dststridediff;
-        height--;
-    } while (height > 0);
+    }
 }
 
-void ASM_CopyCursorWithTransparency(unsigned char* old_buffer, unsigned char* new_buffer, unsigned char* mouse_cursor, unsigned char transparent_color, unsigned int length)
+static void ASM_CopyRectangleWithTransparency(unsigned char *dst, unsigned char *src, unsigned char transparent_color, unsigned int srcstridediff, unsigned int dststridediff, int width, int height)
 {
-    unsigned char value;
-
     do
     {
-        value = *new_buffer;
-        if (*mouse_cursor != transparent_color)
+        /* rows without a transparent pixel are plain copies */
+        if (!memchr(src, transparent_color, width))
         {
-            *new_buffer = *mouse_cursor;
+            memcpy(dst, src, width);
         }
-        *old_buffer = value;
-        ++new_buffer;
-        ++old_buffer;
-        ++mouse_cursor;
-        length--;
-    }
-    while (length > 0);
+        else
+        {
+            ASM_CopyRowWithTransparency(dst, src, transparent_color, width);
+        }
+        src += width + srcstridediff;
+        dst += width + dststridediff;
+        height--;
+    } while (height > 0);
+}
+
+/* Save the 'length' pixels of 'new_buffer' to 'old_buffer', then draw the mouse cursor over them. */
+void ASM_CopyCursorWithTransparency(unsigned char* old_buffer, unsigned char* new_buffer, unsigned char* mouse_cursor, unsigned char transparent_color, unsigned int length)
+{
+    memcpy(old_buffer, new_buffer, length);
+    ASM_CopyRowWithTransparency(new_buffer, mouse_cursor, transparent_color, length);
 }
 
-void ASM_SetFontOptions(int unk1, int unk2, int width, int height, char *buffer, int stride)
+/* Set the buffer that text is drawn to and the rectangle text is clipped to. */
+void ASM_SetFontOptions(int clip_x, int clip_y, int width, int height, char *buffer, int stride)
 {
     ASM_PixelMapBuffer = buffer;
-    ASM_StringFontWidth = width;
-    ASM_StringFontHeight = height;
     ASM_PixelMapStride = stride;
+    ASM_PixelMapBytesPerPixel = 1;
+    ASM_ClipLeft = clip_x;
+    ASM_ClipTop = clip_y;
+    ASM_ClipRight = clip_x + width;
+    ASM_ClipBottom = clip_y + height;
 }
 
 void ASM_DrawString(int x, int y, int color, int font, char *string)
 {
     OPM_FontStruct *pFont;
     int ascii_index;
-    
+
     pFont = (OPM_FontStruct *)&OPM_MediumFont; /* TODO: Implement font selection */
-    ASM_StringFontWidth = pFont->width;
-    ASM_StringFontHeight = pFont->height;
-    ASM_StringFontSize = ASM_StringFontHeight * ((ASM_StringFontWidth + 7) >> 3);
-    ASM_pFontBitmap = (char *)pFont->bitmap;
-    
-    while ( 1 )
+    if (pFont != ASM_CurrentFont)
     {
-        ascii_index = *string;
-        if ( !ascii_index )
-        {
-            break;
-        }
-        
-        ASM_DrawCharFromBitmap(color, x, y, ASM_StringFontWidth, ASM_StringFontHeight, (char*)&ASM_pFontBitmap[ASM_StringFontSize * ascii_index]);
-        *string++;
+        ASM_CurrentFont = pFont;
+        ASM_StringFontWidth = pFont->width;
+        ASM_StringFontHeight = pFont->height;
+        ASM_StringFontSize = ASM_StringFontHeight * ((ASM_StringFontWidth + 7) >> 3);
+        ASM_pFontBitmap = (char *)pFont->bitmap;
+    }
+
+    /* characters right of the clip rectangle are not drawn at all */
+    while (*string && x < ASM_ClipRight)
+    {
+        ascii_index = (unsigned char)*string;
+        ASM_DrawGlyph(color, x, y, ASM_StringFontWidth, ASM_StringFontHeight, (unsigned char *)&ASM_pFontBitmap[ASM_StringFontSize * ascii_index]);
+        string++;
         x += ASM_StringFontWidth;
     }
 }
 
 void ASM_DrawCharFromBitmap(char color, int x, int y, int font_height, int font_width, char *bitmap_offset)
 {
-    char* pixel_location = &ASM_PixelMapBuffer[x + ASM_PixelMapStride * y];
-    ASM_StringFontWidth = font_width;
-    ASM_StringFontHeight = font_height;
+    /* one byte per row */
+    ASM_DrawGlyph(color, x, y, 8, font_height, (unsigned char *)bitmap_offset);
+}
+
+static void ASM_InitGlyphMasks(void)
+{
+    unsigned char mask[8];
+    int bits;
+    int pixel_index;
 
-    for (int i = ASM_StringFontHeight; i > 0; i--)
+    for (bits = 0; bits < 256; bits++)
     {
-        if (*bitmap_offset & 0x80)
+        for (pixel_index = 0; pixel_index < 8; pixel_index++)
         {
-            pixel_location[0] = color;
+            mask[pixel_index] = (bits & (0x80 >> pixel_index)) ? 0xFF : 0;
         }
+        memcpy(&ASM_GlyphMasks[bits][0], &mask[0], 4);
+        memcpy(&ASM_GlyphMasks[bits][1], &mask[4], 4);
+    }
 
-        if (*bitmap_offset & 0x40)
-        {
-            pixel_location[1] = color;
-        }
+    ASM_GlyphMasksReady = 1;
+}
 
-        if (*bitmap_offset & 0x20)
-        {
-            pixel_location[2] = color;
-        }
+/* Draw the set bits of a glyph bitmap with (width + 7) / 8 bytes per row, clipped to the rectangle given to
+   ASM_SetFontOptions. Eight pixels lying completely inside the clip rectangle are drawn as two masked 32 bit stores
+   with the byte masks of their bitmap byte; pixels at the edges of the clip rectangle are drawn one by one. */
+static void ASM_DrawGlyph(unsigned char color, int x, int y, int width, int height, const unsigned char *bitmap)
+{
+    const unsigned char *src;
+    unsigned char *dst;
+    unsigned int pattern;
+    unsigned int value;
+    unsigned char keep;
+    unsigned char bits;
+    int bytes_per_row;
+    int first_row;
+    int end_row;
+    int right;
+    int group;
+    int group_x;
+    int is_inside;
+    int row;
+    int pixel_index;
+
+    if (ASM_PixelMapBytesPerPixel == 2)
+    {
+        ASM_DrawGlyphT(OPM_PaletteLUT16[color], x, y, width, height, bitmap);
+        return;
+    }
+    if (ASM_PixelMapBytesPerPixel == 4)
+    {
+        ASM_DrawGlyphT(OPM_PaletteLUT32[color], x, y, width, height, bitmap);
+        return;
+    }
+
+    if (!ASM_GlyphMasksReady)
+    {
+        ASM_InitGlyphMasks();
+    }
+
+    first_row = ASM_ClipTop > y ? ASM_ClipTop - y : 0;
+    end_row = ASM_ClipBottom - y < height ? ASM_ClipBottom - y : height;
+    right = ASM_ClipRight < x + width ? ASM_ClipRight : x + width;
+    if (first_row >= end_row || x >= right || x + width <= ASM_ClipLeft)
+    {
+        return;
+    }
+
+    pattern = color * 0x01010101u;
+    bytes_per_row = (width + 7) >> 3;
 
-        if (*bitmap_offset & 0x10)
+    for (group = 0; group < bytes_per_row; group++)
+    {
+        /* pixels of this byte that are inside the glyph and the clip rectangle */
+        group_x = x + (group << 3);
+        keep = 0xFF;
+        if (group_x < ASM_ClipLeft)
         {
-            pixel_location[3] = color;
+            keep = ASM_ClipLeft - group_x >= 8 ? 0 : (unsigned char)(0xFF >> (ASM_ClipLeft - group_x));
         }
-
-        if (*bitmap_offset & 0x08)
+        if (group_x + 8 > right)
         {
-            pixel_location[4] = color;
+            keep &= group_x + 8 - right >= 8 ? 0 : (unsigned char)(0xFF << (group_x + 8 - right));
         }
-
-        if (*bitmap_offset & 0x04)
+        if (!keep)
         {
-            pixel_location[5] = color;
+            continue;
         }
+        is_inside = group_x >= ASM_ClipLeft && group_x + 8 <= ASM_ClipRight;
 
-        if (*bitmap_offset & 0x02)
+        src = &bitmap[first_row * bytes_per_row + group];
+        dst = (unsigned char *)&ASM_PixelMapBuffer[(y + first_row) * (int)ASM_PixelMapStride + group_x];
+        for (row = first_row; row < end_row; row++, src += bytes_per_row, dst += ASM_PixelMapStride)
         {
-            pixel_location[6] = color;
+            bits = *src & keep;
+            if (!bits)
+            {
+                continue;
+            }
+
+            if (!is_inside)
+            {
+                for (pixel_index = 0; pixel_index < 8; pixel_index++)
+                {
+                    if (bits & (0x80 >> pixel_index))
+                    {
+                        dst[pixel_index] = color;
+                    }
+                }
+            }
+            else if (bits == 0xFF)
+            {
+                memcpy(&dst[0], &pattern, 4);
+                memcpy(&dst[4], &pattern, 4);
+            }
+            else
+            {
+                memcpy(&value, &dst[0], 4);
+                value = (value & ~ASM_GlyphMasks[bits][0]) | (pattern & ASM_GlyphMasks[bits][0]);
+                memcpy(&dst[0], &value, 4);
+                memcpy(&value, &dst[4], 4);
+                value = (value & ~ASM_GlyphMasks[bits][1]) | (pattern & ASM_GlyphMasks[bits][1]);
+                memcpy(&dst[4], &value, 4);
+            }
         }
+    }
+}
 
-        if (*bitmap_offset & 0x01)
+/* ASM_DrawGlyph for 16 and 32 bit pixel maps, one bit at a time. */
+template <class PIXEL>
+static void ASM_DrawGlyphT(PIXEL value, int x, int y, int width, int height, const unsigned char *bitmap)
+{
+    const unsigned char *src;
+    PIXEL *dst;
+    int bytes_per_row;
+    int first_row, end_row;
+    int left, right;
+    int row, column;
+
+    first_row = ASM_ClipTop > y ? ASM_ClipTop - y : 0;
+    end_row = ASM_ClipBottom - y < height ? ASM_ClipBottom - y : height;
+    left = ASM_ClipLeft > x ? ASM_ClipLeft - x : 0;
+    right = ASM_ClipRight - x < width ? ASM_ClipRight - x : width;
+    if (first_row >= end_row || left >= right)
+    {
+        return;
+    }
+
+    bytes_per_row = (width + 7) >> 3;
+    for (row = first_row; row < end_row; row++)
+    {
+        src = &bitmap[row * bytes_per_row];
+        dst = (PIXEL *)&ASM_PixelMapBuffer[(y + row) * (int)ASM_PixelMapStride] + x;
+        for (column = left; column < right; column++)
         {
-            pixel_location[7] = color;
+            if (src[column >> 3] & (0x80 >> (column & 7)))
+            {
+                dst[column] = value;
+            }
         }
-
-        *bitmap_offset++;
-        pixel_location += ASM_PixelMapStride;
     }
-    pixel_location += 8;
 }
\ No newline at end of file
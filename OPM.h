@@ -33,6 +33,21 @@
 #define BBOPM_VIEW 8
 #define BBOPM_TRANSPARENCY 0x10
 
+#define OPM_MAX_DIRTY_RECTS 16
+
+/* Levels of OPM_RemapBox: 0 turns everything black, OPM_SHADE_NORMAL leaves the colors alone and every level above
+   it moves them another eighth of the way to white. */
+#define OPM_SHADE_LEVELS 16
+#define OPM_SHADE_NORMAL 8
+
+/* Rectangle from (x0, y0) up to, but not including, (x1, y1). */
+typedef struct {
+    short x0;
+    short y0;
+    short x1;
+    short y1;
+} OPM_RectStruct;
+
 typedef struct OPM_Struct_{
     unsigned int flags;
     short width;
@@ -52,8 +67,27 @@ typedef struct OPM_Struct_{
     short view_x;
     short view_y;
     struct OPM_Struct_ *base_pixel_map;
+    short number_of_dirty_rects;
+    OPM_RectStruct dirty_rects[OPM_MAX_DIRTY_RECTS];
 } OPM_Struct;
 
+/* Horizontal run of pixels from x0 to x1 (both inclusive) in row y. */
+typedef struct {
+    short y;
+    short x0;
+    short x1;
+    unsigned char color;
+} OPM_SpanStruct;
+
+/* Transparent image compiled into runs. Every row is a list of (skip, count) byte pairs, each followed by its count
+   opaque pixels, and ends with a (0, 0) pair; row_offsets holds the start of every row in data. */
+typedef struct {
+    short width;
+    short height;
+    unsigned int *row_offsets;
+    unsigned char *data;
+} OPM_GfxStruct;
+
 typedef struct {
     unsigned char height;
     unsigned char width;
@@ -69,16 +103,25 @@ extern int OPM_New(unsigned int width, unsigned int height, unsigned int bytes_p
 extern void OPM_Del(OPM_Struct *pixel_map);
 extern void OPM_SetVirtualClipStart(OPM_Struct *view_pixel_map, int clip_x, int clip_y);
 extern void OPM_CreateVirtualOPM(OPM_Struct *base_pixel_map, OPM_Struct *view_pixel_map, int view_x, int view_y, int view_width, int view_height);
+extern void OPM_AddDirtyRect(OPM_Struct *pixel_map, int x, int y, int width, int height);
+extern void OPM_ClearDirtyRects(OPM_Struct *pixel_map);
 extern void OPM_SetPixel(OPM_Struct *pixel_map, int x, int y, unsigned char color);
 extern unsigned char OPM_GetPixel(OPM_Struct *pixel_map, int x, int y);
 extern void OPM_HorLine(OPM_Struct *pixel_map, int x, int y, int length, unsigned char color);
 extern void OPM_VerLine(OPM_Struct *pixel_map, int x, int y, int length, unsigned char color);
 extern void OPM_Box(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigned char color);
 extern void OPM_FillBox(OPM_Struct *pixel_map, int x, int y, int width, int height, unsigned char color);
+extern void OPM_RemapBox(OPM_Struct *pixel_map, int x, int y, int width, int height, int level);
+extern void OPM_FillSpans(OPM_Struct *pixel_map, const OPM_SpanStruct *spans, int number_of_spans);
+extern void OPM_PutSpans(OPM_Struct *pixel_map, const OPM_SpanStruct *spans, const unsigned char *pixels, int number_of_spans);
+extern int OPM_CreateGFX(OPM_Struct *pixel_map, OPM_GfxStruct *gfx);
+extern void OPM_DelGFX(OPM_GfxStruct *gfx);
+extern void OPM_CopyGFXOPM(OPM_GfxStruct *gfx, OPM_Struct *dst_pixel_map, int dst_x, int dst_y);
 extern void OPM_CopyOPMOPM(OPM_Struct *src_pixel_map, OPM_Struct *dst_pixel_map, int src_x, int src_y, int src_width, int src_height, int dst_x, int dst_y);
 extern void OPM_DrawString(OPM_Struct *pixel_map, char *string, int x, int y, unsigned char color);
+extern void OPM_SetPaletteEntry(int index, unsigned char red, unsigned char green, unsigned char blue);
 extern void ASM_CopyCursorWithTransparency(unsigned char* old_buffer, unsigned char* new_buffer, unsigned char* mouse_cursor, unsigned char transparent_color, unsigned int length);
-extern void ASM_SetFontOptions(int unk1, int unk2, int width, int height, char *buffer, int stride);
+extern void ASM_SetFontOptions(int clip_x, int clip_y, int width, int height, char *buffer, int stride);
 extern void ASM_DrawString(int x, int y, int color, int font, char *string);
 extern void ASM_DrawCharFromBitmap(char color, int x, int y, int font_height, int font_width, char *bitmap_offset);
 
@@ -164,19 +164,17 @@ int __far SETUP_CriticalErrorHandler(unsigned int deverr, unsigned int errcode,
 /* Get the configured language and the CD drive number from the already existing INI file. */
 void SETUP_GetCdDriveAndLanguage(void)
 {
-    unsigned char* ptrLanguage;
-    unsigned char* ptrCdDrive;
+    char language[8];
+    char cd_drive[4];
 
-    ptrLanguage = INI_ReadEntry((unsigned char *)&INI_WriteBuffer, "SYSTEM", "LANGUAGE");
-    if(ptrLanguage)
+    if(INI_GetEntry("SYSTEM", "LANGUAGE", language, sizeof(language)))
     {
-        SETUP_Language = atoi((const char *)&ptrLanguage[0]) - 1;
+        SETUP_Language = atoi(language) - 1;
     }
 
-    ptrCdDrive = INI_ReadEntry((unsigned char *)&INI_WriteBuffer, "SYSTEM", "CD_ROM_DRIVE");
-    if(ptrCdDrive)
+    if(INI_GetEntry("SYSTEM", "CD_ROM_DRIVE", cd_drive, sizeof(cd_drive)))
     {
-        SETUP_CdDrive = *ptrCdDrive;
+        SETUP_CdDrive = cd_drive[0];
     }
 }
 
@@ -220,15 +218,15 @@ void SETUP_ParseScript(SETUP_ScriptDataStruct *script_data, const char *script_p
         ++script_data->NumberOfLines;
     }
 
-    script_data->PtrScriptLine = (unsigned int*)malloc(4 * (script_data->NumberOfLines + 1));
+    script_data->PtrScriptLine = (uintptr_t*)malloc(sizeof(uintptr_t) * (script_data->NumberOfLines + 1));
     script_data->NumberOfLines = 0;
-    script_data->PtrScriptLine[script_data->NumberOfLines++] = (unsigned int)script_data->PtrScriptBuffer; /* First entry points to complete ini buffer */
+    script_data->PtrScriptLine[script_data->NumberOfLines++] = (uintptr_t)script_data->PtrScriptBuffer; /* First entry points to complete ini buffer */
 
     for (int j = 0; j < script_length; ++j ) /* Save byte index for each new line */
     {
         if ( script_data->PtrScriptBuffer[j] == '\r' )
         {
-            script_data->PtrScriptLine[script_data->NumberOfLines++] = (unsigned int)&script_data->PtrScriptBuffer[j + 1];
+            script_data->PtrScriptLine[script_data->NumberOfLines++] = (uintptr_t)&script_data->PtrScriptBuffer[j + 1];
             script_data->PtrScriptBuffer[j] = 0; /* Replace new line with 0 */
         }
     }
@@ -713,8 +711,6 @@ unsigned int SETUP_ScriptHandler(SETUP_ScriptDataStruct *script_data, unsigned i
     int targetdrive_ret;
     char* targetpath_ret;
 
-    OPM_Struct pixel_map_loc;
-
     if ( line_number >= script_data->NumberOfLines || line_number < 0 ) /* report error if line number passed as parameter is higher than the number of lines altogether */
     {
         return -1;
@@ -783,12 +779,14 @@ unsigned int SETUP_ScriptHandler(SETUP_ScriptDataStruct *script_data, unsigned i
                 GUI_ErrorHandler(1012, line_number + 1, (char*)&script_data->PtrScriptLine[line_number]);
             }
             INI_MakePath();
+            INI_BeginTransaction();
             INI_WriteEntry_System();
             INI_WriteEntry_Path();
             if ( DPMI_IsVesaAvailable() )
             {
                 INI_WriteEntry_Vesa();
             }
+            INI_CommitTransaction();
             SETUP_IniUpdated = 1;
 
             return line_number + 1;
@@ -1283,16 +1281,15 @@ unsigned int SETUP_ScriptHandler(SETUP_ScriptDataStruct *script_data, unsigned i
             {
                 GUI_ErrorHandler(1012, line_number + 1, (char*)&script_data->PtrScriptLine[line_number]);
             }
-            if ( !LBM_DisplayLBM((char *)keyword_buffer[1], (OPM_Struct*)&GUI_ScreenOpm, (LBM_LogPalette*)&pal, 1) )
+            /* Decoded and stretched to the screen size once, then served from the background cache. */
+            if ( !LBM_LoadBackground((char *)keyword_buffer[1], (OPM_Struct*)&GUI_ScreenOpm, (LBM_LogPalette*)&pal) )
             {
                 GUI_ErrorHandler(1009, (char *)keyword_buffer[1]);
             }
-            /* DSA_StretchOPMToScreen(&pixel_map_loc, &GUI_ScreenOpm); */ /* FIXME: Function not verified yet */
             DSA_LoadPal((LBM_LogPalette*)&pal, 0, 256u, 0);
             DSA_ActivatePal();
             GUI_SetPal();
-            DSA_CopyMainOPMToScreen(1);
-            OPM_Del(&pixel_map_loc);
+            DSA_CopyMainOPMToScreen(0);
 
             return line_number + 1;
             break;
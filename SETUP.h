@@ -48,7 +48,7 @@ typedef struct
 {
     unsigned char* PtrScriptBuffer;
     unsigned int NumberOfLines;
-    unsigned int* PtrScriptLine;
+    uintptr_t* PtrScriptLine;
 } SETUP_ScriptDataStruct;
 
 extern unsigned int  SETUP_Language;